@@ -0,0 +1,590 @@
+// Microbenchmarks of the simulation hot components
+//
+// Usage: ph_bench [filter] [nof_events] [nof_threads]
+//
+//  filter      - run only benchmarks which name contains it, "all" by default,
+//                "navigation" compares phantom navigation strategies
+//  nof_events  - number of events for end-to-end benchmark, 0 to skip it
+//  nof_threads - number of worker threads for end-to-end benchmark
+//
+// Every benchmark is warmed up and repeated, median and minimum time
+// per operation are reported, random engine is seeded with fixed seeds,
+// so numbers are comparable between commits on the same machine.
+// Expects phantom.hed, Angles.in and Source.in in the working directory.
+//
+// Navigation benchmark runs every Detector::navigation in its own ph_bench
+// process, as Geant4 allows only one run manager per process, and reports
+// initialization time including voxelization and physics tables, memory
+// and steps per second.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "G4MTRunManager.hh"
+#include "G4UImanager.hh"
+#include "G4UIsession.hh"
+#include "G4UserSteppingAction.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4GenericPhysicsList.hh"
+#include "G4THitsMap.hh"
+#include "G4Event.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4Geantino.hh"
+#include "Randomize.hh"
+
+#include "PhantomSetup.hh"
+#include "DoseGrid.hh"
+#include "Detector.hh"
+#include "Denoise.hh"
+#include "ForcedCollision.hh"
+#include "Initialization.hh"
+#include "Source.hh"
+#include "SteppingAction.hh"
+#include "Spectrum.hh"
+
+using bclock = std::chrono::steady_clock;
+
+static const int nof_reps = 9;
+
+static std::string filter = "all";
+
+// prevents compiler from throwing benchmarked code away
+static volatile double sink = 0.0;
+
+// time nof_ops operations done by single call to f
+template <typename F> static void bench(const std::string& name, int64_t nof_ops, F&& f)
+{
+    if (filter != "all" && name.find(filter) == std::string::npos)
+        return;
+
+    f(); // warm up caches and allocations
+
+    std::vector<double> ns_per_op;
+    ns_per_op.reserve(nof_reps);
+    for(int r = 0; r != nof_reps; ++r)
+    {
+        auto t0 = bclock::now();
+        f();
+        std::chrono::duration<double, std::nano> dt = bclock::now() - t0;
+
+        ns_per_op.push_back(dt.count() / double(nof_ops));
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+
+    std::printf("%-32s %12lld ops %14.3f ns/op (median) %14.3f ns/op (min)\n",
+                name.c_str(), (long long)nof_ops, ns_per_op[nof_reps/2], ns_per_op[0]);
+    std::fflush(stdout);
+}
+
+// swallows G4cout while benchmarked code is chatty
+class QuietSession : public G4UIsession
+{
+    public: virtual G4int ReceiveG4cout(const G4String&) override
+    {
+        return 0;
+    }
+};
+
+// usual stepping action of its worker, which also counts steps, summed up between runs
+class StepCounter : public SteppingAction
+{
+    public: static std::mutex               mutex;
+    public: static std::vector<StepCounter*> counters;
+
+    public: std::atomic<int64_t> steps;
+
+    public: StepCounter(const Source* source):
+        SteppingAction(source),
+        steps{0}
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.push_back(this);
+    }
+
+    public: virtual void UserSteppingAction(const G4Step* aStep) override
+    {
+        steps.store(steps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        SteppingAction::UserSteppingAction(aStep);
+    }
+
+    public: static int64_t total()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        int64_t n = 0;
+        for(auto* c: counters)
+            n += c->steps.load();
+        return n;
+    }
+};
+
+std::mutex                StepCounter::mutex;
+std::vector<StepCounter*> StepCounter::counters;
+
+// usual actions with the counting stepping action, so variance reduction,
+// range rejection and phase-space capture run as in ph
+class StepCountingInitialization : public Initialization
+{
+    protected: virtual G4UserSteppingAction* make_stepping_action(const Source* source) const override
+    {
+        return new StepCounter(source);
+    }
+};
+
+// resident and peak resident memory of this process in MB
+static void memory_mb(double& rss, double& peak)
+{
+    rss  = 0.0;
+    peak = 0.0;
+
+    std::ifstream is("/proc/self/status");
+    for(std::string line; std::getline(is, line); )
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            rss = std::atof(line.c_str() + 6) / 1024.0;
+        else if (line.compare(0, 6, "VmHWM:") == 0)
+            peak = std::atof(line.c_str() + 6) / 1024.0;
+    }
+}
+
+static void reseed()
+{
+    long seeds[2] = { 534524575674523, 526345623452457 };
+    CLHEP::HepRandom::setTheSeeds(seeds);
+}
+
+// synthetic event hits: a cluster of voxels around the phantom centre
+static std::vector<std::pair<int, double>> make_event_hits(const PhantomSetup& phs, int nof_hits)
+{
+    std::vector<std::pair<int, double>> hits;
+    hits.reserve(nof_hits);
+
+    int cx = phs.nofv_x()/2;
+    int cy = phs.nofv_y()/2;
+    int cz = phs.nofv_z()/2;
+    for(int k = 0; k != nof_hits; ++k)
+    {
+        int ix = std::min(phs.nofv_x() - 1, std::max(0, cx + int(8.0*(G4UniformRand() - 0.5))));
+        int iy = std::min(phs.nofv_y() - 1, std::max(0, cy + int(8.0*(G4UniformRand() - 0.5))));
+        int iz = std::min(phs.nofv_z() - 1, std::max(0, cz + int(8.0*(G4UniformRand() - 0.5))));
+
+        hits.emplace_back(phs.idx(ix, iy, iz), 1.0e-12 * G4UniformRand() * gray);
+    }
+    return hits;
+}
+
+static void bench_phantom_header()
+{
+    QuietSession quiet;
+    G4UImanager::GetUIpointer()->SetCoutDestination(&quiet);
+
+    bench("phantom_header_parse", 1000, []()
+    {
+        for(int k = 0; k != 1000; ++k)
+        {
+            PhantomSetup phs{"phantom.hed"};
+            sink = sink + phs.voxel_volume();
+        }
+    });
+
+    G4UImanager::GetUIpointer()->SetCoutDestination(nullptr);
+}
+
+static void bench_voxel_index(const PhantomSetup& phs)
+{
+    const int n = 1 << 20;
+
+    std::vector<int> ixyz(3*n);
+    for(int k = 0; k != n; ++k)
+    {
+        ixyz[3*k + 0] = int(G4UniformRand() * phs.nofv_x());
+        ixyz[3*k + 1] = int(G4UniformRand() * phs.nofv_y());
+        ixyz[3*k + 2] = int(G4UniformRand() * phs.nofv_z());
+    }
+
+    bench("voxel_index", n, [&]()
+    {
+        long long s = 0;
+        for(int k = 0; k != n; ++k)
+            s += phs.idx(ixyz[3*k + 0], ixyz[3*k + 1], ixyz[3*k + 2]);
+        sink = sink + double(s);
+    });
+}
+
+static void bench_source()
+{
+    // source constructor needs particle definitions
+    G4Gamma::GammaDefinition();
+    G4Electron::ElectronDefinition();
+    G4Positron::PositronDefinition();
+    G4Geantino::GeantinoDefinition();
+
+    Source source;
+    source.set_iso_radius(380.0*mm);
+    source.set_src_angle(2.0*degree);
+    source.set_rot_start(0.0*degree);
+    source.set_rot_stop(360.0*degree);
+    source.set_shift_x(0.0);
+    source.set_shift_y(0.0);
+    source.set_shift_z(0.0);
+    source.set_sources("Angles.in");
+
+    const int n = 100000;
+
+    reseed();
+    std::vector<Source::particle> particles;
+    bench("source_sample_assembly", n, [&]()
+    {
+        for(int k = 0; k != n; ++k)
+        {
+            source.sample_assembly(particles);
+            sink = sink + particles[0].wx;
+        }
+    });
+
+    reseed();
+    bench("source_generate_primaries", n/10, [&]()
+    {
+        for(int k = 0; k != n/10; ++k)
+        {
+            G4Event event;
+            source.GeneratePrimaries(&event);
+            sink = sink + event.GetNumberOfPrimaryVertex();
+        }
+    });
+}
+
+// alias table sampling time should not depend on number of bins
+static void bench_spectrum()
+{
+    const int n = 1 << 20;
+
+    std::vector<double> us(n);
+    for(auto& u: us)
+        u = G4UniformRand();
+
+    for(int nof_bins: {2, 4096})
+    {
+        std::vector<Spectrum::bin> bins;
+        for(int k = 0; k != nof_bins; ++k)
+            bins.push_back(Spectrum::bin{0.01*MeV*k, 0.01*MeV*(k + 1), 1.0 + G4UniformRand()});
+
+        Spectrum spectrum;
+        spectrum.set_bins(bins);
+
+        bench("spectrum_sample_" + std::to_string(nof_bins), n, [&]()
+        {
+            double s = 0.0;
+            for(int k = 0; k != n; ++k)
+                s += spectrum.sample(us[k]);
+            sink = sink + s;
+        });
+    }
+}
+
+static void bench_accumulation(const PhantomSetup& phs)
+{
+    const int nof_events = 2000;
+    const int nof_hits   = 400;
+    const int key_offset = phs.nofv_z(); // the same as DoseDeposit keys in Run
+
+    reseed();
+    std::vector<std::vector<std::pair<int, double>>> events;
+    for(int k = 0; k != nof_events; ++k)
+        events.push_back(make_event_hits(phs, nof_hits));
+
+    // event map fill and sum into run map, as G4THitsMap path in Run::RecordEvent
+    bench("hitsmap_record_event", int64_t(nof_events) * nof_hits, [&]()
+    {
+        G4THitsMap<double> run_map{"phantomSD", "DoseDeposit"};
+        for(const auto& ev: events)
+        {
+            G4THitsMap<double> evt_map{"phantomSD", "DoseDeposit"};
+            for(const auto& h: ev)
+            {
+                double d = h.second;
+                evt_map.add(h.first + key_offset, d);
+            }
+            run_map += evt_map;
+        }
+        sink = sink + double(run_map.entries());
+    });
+
+    // per-history scoring into dense grid, as Run::score_event
+    bench("densegrid_record_event", int64_t(nof_events) * nof_hits, [&]()
+    {
+        DoseGrid grid{phs};
+        for(const auto& ev: events)
+        {
+            for(const auto& h: ev)
+                grid.score(h.first, h.second);
+            grid.add_events(1);
+        }
+        sink = sink + grid.dose(0);
+    });
+
+    // merge of worker runs into master, as Run::Merge
+    G4THitsMap<double> worker_map{"phantomSD", "DoseDeposit"};
+    DoseGrid           worker_grid{phs};
+    for(const auto& ev: events)
+    {
+        for(const auto& h: ev)
+        {
+            double d = h.second;
+            worker_map.add(h.first + key_offset, d);
+            worker_grid.score(h.first, h.second);
+        }
+    }
+
+    const int nof_merges = 50;
+    bench("hitsmap_merge", nof_merges, [&]()
+    {
+        G4THitsMap<double> master_map{"phantomSD", "DoseDeposit"};
+        for(int k = 0; k != nof_merges; ++k)
+            master_map += worker_map;
+        sink = sink + double(master_map.entries());
+    });
+
+    bench("densegrid_merge", nof_merges, [&]()
+    {
+        DoseGrid master_grid{phs};
+        for(int k = 0; k != nof_merges; ++k)
+            master_grid.merge(worker_grid);
+        sink = sink + master_grid.dose(0);
+    });
+
+    // dose.out writing, as RunAction::EndOfRunAction, over fully filled grid
+    DoseGrid full{phs};
+    for(int k = 0; k != full.nof_voxels(); ++k)
+        full.score(k, 1.0e-12 * (1.0 + G4UniformRand()) * gray);
+
+    std::string fname = "bench_dose.out";
+    bench("dose_out_write", full.nof_voxels(), [&]()
+    {
+        std::ofstream fileout(fname);
+        full.write_dose_out(fileout, key_offset);
+    });
+    std::remove(fname.c_str());
+}
+
+// synthetic dose step, 1 for x below the middle and 3 above, every history deposits
+// into a voxel with probability p; RMS error of raw and filtered mean dose away from
+// the step and on its two planes, where the filter must not blur
+static void bench_denoise()
+{
+    if (filter != "all" && std::string{"denoise"}.find(filter) == std::string::npos)
+        return;
+
+    const int    n           = 40;
+    const int    nof_history = 400;
+    const double p           = 0.2;
+
+    reseed();
+    DoseGrid grid{n, n, n};
+    for(int h = 0; h != nof_history; ++h)
+    {
+        for(int k = 0; k != grid.nof_voxels(); ++k)
+        {
+            double m = (k % n < n/2) ? 1.0 : 3.0;
+            if (G4UniformRand() < p)
+                grid.score(k, m/p);
+        }
+    }
+    grid.add_events(nof_history);
+
+    std::vector<double> density(size_t(grid.nof_voxels()), 1.0);
+
+    Denoise denoise;
+    std::vector<double> filtered;
+    bench("denoise_filter", grid.nof_voxels(), [&]()
+    {
+        filtered = denoise.filter(grid, density, 1.0*mm, 1.0*mm, 1.0*mm);
+    });
+
+    auto rms = [&](bool raw, bool edge)
+    {
+        double e = 0.0;
+        int    c = 0;
+        for(int k = 0; k != grid.nof_voxels(); ++k)
+        {
+            int ix = k % n;
+            if ((ix == n/2 - 1 || ix == n/2) != edge)
+                continue;
+
+            double d = (raw ? grid.mean(k) : filtered[size_t(k)]) - ((ix < n/2) ? 1.0 : 3.0);
+            e += d*d;
+            ++c;
+        }
+        return std::sqrt(e/double(c));
+    };
+
+    std::printf("%-32s %10.4f rms raw %10.4f rms filtered %10.4f edge raw %10.4f edge filtered\n",
+                "denoise_step", rms(true, false), rms(false, false), rms(true, true), rms(false, true));
+    std::fflush(stdout);
+}
+
+// full simulation, events per second on the reference phantom
+static void bench_end_to_end(int nof_events, int nof_threads)
+{
+    if (nof_events <= 0 || (filter != "all" && std::string("end_to_end").find(filter) == std::string::npos))
+        return;
+
+    G4Random::setTheEngine(new CLHEP::RanecuEngine);
+    reseed();
+
+    auto* runManager = new G4MTRunManager;
+    runManager->SetNumberOfThreads(nof_threads);
+
+    PhantomSetup phs{"phantom.hed"};
+    runManager->SetUserInitialization(new Detector{phs});
+
+    auto* phs_vec = new std::vector<G4String>;
+    phs_vec->push_back("G4EmStandardPhysics");
+    auto* phys = new G4GenericPhysicsList(phs_vec);
+    phys->RegisterPhysics(new ForcedCollisionPhysics);
+    runManager->SetUserInitialization(phys);
+
+    runManager->SetUserInitialization(new Initialization());
+
+    auto t0 = bclock::now();
+    runManager->Initialize();
+    std::chrono::duration<double> init = bclock::now() - t0;
+
+    G4UImanager* UImanager = G4UImanager::GetUIpointer();
+    UImanager->ApplyCommand("/control/verbose 0");
+    UImanager->ApplyCommand("/run/verbose 0");
+    UImanager->ApplyCommand("/control/execute Source.in");
+
+    // first run starts the workers and builds physics tables
+    runManager->BeamOn(std::max(1, nof_events/100));
+
+    t0 = bclock::now();
+    runManager->BeamOn(nof_events);
+    std::chrono::duration<double> run = bclock::now() - t0;
+
+    std::printf("%-32s %12.3f s\n", "end_to_end_initialize", init.count());
+    std::printf("%-32s %12d events %14.3f events/s %6d threads\n",
+                "end_to_end_events", nof_events, double(nof_events) / run.count(), nof_threads);
+
+    delete runManager;
+}
+
+// one navigation strategy, runs in its own process
+static void bench_navigation_mode(const std::string& name, int nof_events, int nof_threads)
+{
+    Detector::navigation nav;
+    if (!Detector::navigation_from_name(name, nav))
+    {
+        std::printf("unknown navigation %s\n", name.c_str());
+        return;
+    }
+
+    G4Random::setTheEngine(new CLHEP::RanecuEngine);
+    reseed();
+
+    double rss0, peak0;
+    memory_mb(rss0, peak0);
+
+    auto* runManager = new G4MTRunManager;
+    runManager->SetNumberOfThreads(nof_threads);
+
+    PhantomSetup phs{"phantom.hed"};
+    auto* detector = new Detector{phs};
+    detector->set_navigation(nav);
+    runManager->SetUserInitialization(detector);
+
+    auto* phs_vec = new std::vector<G4String>;
+    phs_vec->push_back("G4EmStandardPhysics");
+    auto* phys = new G4GenericPhysicsList(phs_vec);
+    phys->RegisterPhysics(new ForcedCollisionPhysics);
+    runManager->SetUserInitialization(phys);
+
+    runManager->SetUserInitialization(new StepCountingInitialization());
+
+    // geometry, smart voxels and physics tables are all built here
+    auto t0 = bclock::now();
+    runManager->Initialize();
+    std::chrono::duration<double> init = bclock::now() - t0;
+
+    G4UImanager* UImanager = G4UImanager::GetUIpointer();
+    UImanager->ApplyCommand("/control/verbose 0");
+    UImanager->ApplyCommand("/run/verbose 0");
+    UImanager->ApplyCommand("/control/execute Source.in");
+
+    runManager->BeamOn(std::max(1, nof_events/100));
+
+    double rss1, peak1;
+    memory_mb(rss1, peak1);
+
+    int64_t steps0 = StepCounter::total();
+    t0 = bclock::now();
+    runManager->BeamOn(nof_events);
+    std::chrono::duration<double> run = bclock::now() - t0;
+    int64_t steps = StepCounter::total() - steps0;
+
+    std::printf("%-32s %10.3f s construct %10.3f s initialize %10.1f MB %10.1f MB peak %14.0f steps/s %12.1f events/s\n",
+                ("navigation_" + name).c_str(), detector->construct_seconds(), init.count(),
+                rss1 - rss0, peak1, double(steps) / run.count(), double(nof_events) / run.count());
+    std::fflush(stdout);
+
+    delete runManager;
+}
+
+static void bench_navigation(const char* self, int nof_events, int nof_threads)
+{
+    if (nof_events <= 0 || filter != "navigation")
+        return;
+
+    for(auto nav: { Detector::navigation::regular, Detector::navigation::smart,
+                    Detector::navigation::xaxis,   Detector::navigation::nested })
+    {
+        std::string command = std::string{"\""} + self + "\" navigation:" + Detector::navigation_name(nav) +
+                              " " + std::to_string(nof_events) + " " + std::to_string(nof_threads);
+        if (std::system(command.c_str()) != 0)
+            std::printf("%-32s failed\n", (std::string{"navigation_"} + Detector::navigation_name(nav)).c_str());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        filter = argv[1];
+
+    int nof_events  = (argc > 2) ? std::stoi(argv[2]) : 10000;
+    int nof_threads = (argc > 3) ? std::stoi(argv[3]) : 4;
+
+    // child process of the navigation benchmark
+    if (filter.compare(0, 11, "navigation:") == 0)
+    {
+        bench_navigation_mode(filter.substr(11), nof_events, nof_threads);
+        return 0;
+    }
+
+    G4Random::setTheEngine(new CLHEP::RanecuEngine);
+    reseed();
+
+    PhantomSetup phs{"phantom.hed"};
+
+    bench_phantom_header();
+    bench_voxel_index(phs);
+    bench_source();
+    bench_spectrum();
+    bench_accumulation(phs);
+    bench_denoise();
+    bench_end_to_end(nof_events, nof_threads);
+    bench_navigation(argv[0], nof_events, nof_threads);
+
+    return 0;
+}
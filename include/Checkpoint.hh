@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "globals.hh"
+
+#include "DoseGrid.hh"
+
+class CheckpointMessenger;
+
+//---------------------------------------------------------------------
+/// Checkpoint class
+///
+/// Shared by master and worker threads. Workers periodically publish
+/// snapshot of their local dose grid, and the publishing worker writes
+/// merged dose, dose squared, number of events and master RNG state
+/// into binary checkpoint file, while other workers keep on running.
+/// Fine box dose of multi-resolution phantom is stored next to the grid.
+/// Checkpoint could be resumed, so the next run adds its histories
+/// to the stored result instead of starting from zero.
+//---------------------------------------------------------------------
+
+class Checkpoint
+{
+#pragma region Typedefs
+    public: using clock = std::chrono::steady_clock;
+#pragma endregion
+
+#pragma region Singleton
+    private: static Checkpoint* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: CheckpointMessenger*         _messenger;
+
+    private: std::string                  _fname;
+    private: int64_t                      _every_events;  // 0 means no event based checkpoints
+    private: double                       _every_minutes; // 0 means no time based checkpoints
+
+    private: std::mutex                   _mutex;
+    private: std::atomic<bool>            _writing;
+    private: clock::time_point            _last_write;
+
+    // resumed result, added to whatever this run produces
+    private: DoseGrid                     _base;
+    private: DoseGrid                     _fine_base;
+
+    // latest snapshot of every worker, keyed by thread id
+    private: std::map<int, DoseGrid>      _snapshots;
+    private: std::map<int, DoseGrid>      _fine_snapshots;
+
+    // events recorded by every worker at its snapshot, grids count histories
+    private: std::map<int, int64_t>       _snapshot_events;
+
+    // master engine state and number of flat() draws to skip after restoring it
+    private: std::string                  _rng_name;
+    private: std::vector<unsigned long>   _rng_state;
+    private: uint64_t                     _rng_skip;
+
+    private: int64_t                      _events_per_publish; // per worker share of _every_events
+    private: int64_t                      _events_written;     // snapshot events at last write
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Checkpoint();
+    public: Checkpoint(const Checkpoint&)            = delete;
+    public: Checkpoint& operator=(const Checkpoint&) = delete;
+    public: ~Checkpoint();
+#pragma endregion
+
+#pragma region Singleton
+    public: static Checkpoint* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _every_events > 0 || _every_minutes > 0.0;
+    }
+
+    public: const std::string& fname() const
+    {
+        return _fname;
+    }
+
+    public: const DoseGrid& base() const
+    {
+        return _base;
+    }
+
+    // true if worker with given local events count and last publish time
+    // should publish its snapshot now
+    public: bool publish_due(int64_t local_events, clock::time_point last_publish) const;
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+
+    public: void set_every_events(int64_t n)
+    {
+        _every_events = n;
+    }
+
+    public: void set_every_minutes(double minutes)
+    {
+        _every_minutes = minutes;
+    }
+
+    // master, start of run: remember RNG state from which the run seeds are drawn
+    public: void begin_run(int64_t nof_events_to_process);
+
+    // worker: store snapshot and write checkpoint file if it is due, local_events
+    // is the number of events recorded by the worker, local_fine is empty unless
+    // phantom has FINEBOX
+    public: void publish(int thread_id, int64_t local_events, const DoseGrid& local, const DoseGrid& local_fine);
+
+    // master, end of run: merge resumed base into the run result and write final checkpoint,
+    // fine is the run fine box grid on input and includes the resumed one on output
+    public: DoseGrid end_run(const DoseGrid& merged, DoseGrid& fine);
+
+    // master, idle state: load checkpoint and restore RNG so next run continues it
+    public: void resume(const std::string& fname);
+#pragma endregion
+
+    // checkpoint file of the grid and fine box, if not empty, also used for result cache entries
+    public: void write(const std::string& fname, const DoseGrid& grid, const DoseGrid& fine,
+                       const std::string& rng_name, const std::vector<unsigned long>& rng_state, uint64_t rng_skip) const;
+};
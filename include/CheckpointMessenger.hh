@@ -0,0 +1,34 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class Checkpoint;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+class G4UIcmdWithADouble;
+
+class CheckpointMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: Checkpoint*           _checkpoint;
+
+    private: G4UIdirectory*        _chk_directory;
+
+    private: G4UIcmdWithAString*   _fname_cmd;
+    private: G4UIcmdWithAnInteger* _every_events_cmd;
+    private: G4UIcmdWithADouble*   _every_minutes_cmd;
+    private: G4UIcmdWithAString*   _resume_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: CheckpointMessenger(Checkpoint* checkpoint);
+    public: ~CheckpointMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
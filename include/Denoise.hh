@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "globals.hh"
+
+class DenoiseMessenger;
+class DoseGrid;
+class Detector;
+
+//---------------------------------------------------------------------
+/// Denoise class
+///
+/// Optional end of run stage, writes the merged dose filtered with the
+/// 3D joint bilateral filter next to the raw dose.out. Neighbour weight
+/// is the product of the Gaussian of the distance, of the dose difference
+/// in units of the combined standard error of both voxels and of the
+/// density difference, so dose is averaged where it differs by noise
+/// only and edges of the dose and tissue interfaces are kept. Slices
+/// of the grid are filtered by all threads.
+//---------------------------------------------------------------------
+
+class Denoise
+{
+#pragma region Singleton
+    private: static Denoise* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: DenoiseMessenger* _messenger;
+
+    private: bool              _enabled;
+    private: std::string       _fname;
+
+    private: double            _sigma_space;   // spatial kernel width
+    private: double            _range;         // dose kernel width, standard errors
+    private: double            _sigma_density; // density kernel width, 0 turns it off
+    private: int               _nof_threads;   // 0 for hardware concurrency
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Denoise();
+    public: Denoise(const Denoise&)            = delete;
+    public: Denoise& operator=(const Denoise&) = delete;
+    public: ~Denoise();
+#pragma endregion
+
+#pragma region Singleton
+    public: static Denoise* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _enabled;
+    }
+
+    public: const std::string& fname() const
+    {
+        return _fname;
+    }
+
+    public: double sigma_space() const
+    {
+        return _sigma_space;
+    }
+
+    public: double range() const
+    {
+        return _range;
+    }
+
+    public: double sigma_density() const
+    {
+        return _sigma_density;
+    }
+
+    public: int nof_threads() const
+    {
+        return _nof_threads;
+    }
+
+    // filtered mean dose per history of every voxel, density of every
+    // voxel or empty, voxel sides are along x, y and z
+    public: std::vector<double> filter(const DoseGrid& grid, const std::vector<double>& density,
+                                       double side_x, double side_y, double side_z) const;
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_enabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+
+    public: void set_sigma_space(double sigma)
+    {
+        _sigma_space = sigma;
+    }
+
+    public: void set_range(double range)
+    {
+        _range = range;
+    }
+
+    public: void set_sigma_density(double sigma)
+    {
+        _sigma_density = sigma;
+    }
+
+    public: void set_nof_threads(int n)
+    {
+        _nof_threads = n;
+    }
+#pragma endregion
+
+    // master: write filtered dose of the run in dose.out format
+    public: void write(const DoseGrid& total, const Detector* detector, int key_offset) const;
+};
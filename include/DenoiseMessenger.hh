@@ -0,0 +1,38 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class Denoise;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+class G4UIcmdWithADouble;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWithAnInteger;
+
+class DenoiseMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: Denoise*                   _denoise;
+
+    private: G4UIdirectory*             _denoise_directory;
+
+    private: G4UIcmdWithABool*          _enable_cmd;
+    private: G4UIcmdWithAString*        _fname_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _sigma_space_cmd;
+    private: G4UIcmdWithADouble*        _range_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _sigma_density_cmd;
+    private: G4UIcmdWithAnInteger*      _threads_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DenoiseMessenger(Denoise* denoise);
+    public: ~DenoiseMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
@@ -2,22 +2,50 @@
 
 #include <cstdint>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "globals.hh"
 #include "G4VUserDetectorConstruction.hh"
+#include "G4ThreeVector.hh"
 
 #include "PhantomSetup.hh"
+#include "DoseScorer.hh"
 
 class G4Material;
 class G4Box;
 class G4LogicalVolume;
+class G4Region;
+class G4ProductionCuts;
+class DetectorMessenger;
 
 class Detector : public G4VUserDetectorConstruction
 {
+#pragma region Typedefs
+    // how the phantom is built, and therefore which navigator tracks in it
+    //  regular - G4PhantomParameterisation with regular structure, G4RegularNavigation
+    //  smart   - the same parameterisation with kUndefined axis, 3D smart voxels
+    //  xaxis   - the same parameterisation with kXAxis, 1D smart voxels along X
+    //  nested  - Y and X replicas with nested Z parameterisation inside
+    public: enum class navigation
+    {
+        regular,
+        smart,
+        xaxis,
+        nested
+    };
+
+    // collimator exit disc is behind an air gap, so particles enter it from the world; mm
+    private: static constexpr double exit_gap       = 0.1;
+    private: static constexpr double exit_thickness = 0.1;
+#pragma endregion
+
 #pragma region Data
+    private: DetectorMessenger* _messenger;
+
     private: G4Material* _Air;
     private: G4Material* _Water;
+    private: G4Material* _Tungsten;
 
     // World
     private: G4Box*             _world_solid;
@@ -39,6 +67,46 @@ class Detector : public G4VUserDetectorConstruction
 
     private: bool                       _constructed;
     private: bool                       _checkOverlaps;
+
+    private: navigation                 _navigation;
+    private: double                     _construct_seconds; // wall time of the last Construct()
+
+    // built part of the grid, the non-air box with autocrop, whole grid otherwise;
+    // voxels outside are left to the world air and scored nowhere
+    private: bool                       _autocrop;
+    private: int                        _crop_x0;
+    private: int                        _crop_y0;
+    private: int                        _crop_z0;
+    private: int                        _crop_nx;
+    private: int                        _crop_ny;
+    private: int                        _crop_nz;
+    private: std::vector<size_t>        _mat_index; // storage of _mat_IDs over the built part
+
+    // multi-resolution phantom: fine box and grid slabs around it
+    private: std::vector<DoseScorer::block>  _blocks;
+    private: std::vector<std::vector<size_t>> _block_mat_index;
+
+    // production cuts from voxel size: phantom container region gets
+    // cut_fraction of the smallest voxel side, world air gets world_cut;
+    // range rejection deposits electrons which cannot leave their voxel
+    private: bool                       _auto_cuts;
+    private: double                     _cut_fraction;
+    private: double                     _world_cut;
+    private: double                     _default_cut; // world cut before auto cuts, NaN until saved
+    private: bool                       _range_rejection;
+    private: G4Region*                  _phantom_region;
+    private: G4ProductionCuts*          _phantom_cuts;
+
+    // collimator stage: one channel of the unit on -X axis, pointing at the
+    // isocentre at the origin, and thin exit disc in place of the phantom,
+    // particles entering the disc make the phase space of the channel
+    private: bool                       _collimator;
+    private: double                     _col_length;
+    private: double                     _col_exit_distance;   // isocentre to collimator exit
+    private: double                     _col_entrance_radius; // channel radius, source side
+    private: double                     _col_exit_radius;
+    private: double                     _col_outer_radius;
+    private: G4LogicalVolume*           _exit_logic;
 #pragma endregion
 
 #pragma region Ctor/Dtor/ops
@@ -47,6 +115,11 @@ class Detector : public G4VUserDetectorConstruction
 #pragma endregion
 
 #pragma region Observers
+    public: const PhantomSetup& phs() const
+    {
+        return _phs;
+    }
+
     public: float voxel_x() const
     {
         return _phs.voxel_x();
@@ -101,6 +174,123 @@ class Detector : public G4VUserDetectorConstruction
     {
         return _phs.nof_voxels();
     }
+
+    public: navigation get_navigation() const
+    {
+        return _navigation;
+    }
+
+    public: double construct_seconds() const
+    {
+        return _construct_seconds;
+    }
+
+    public: bool autocrop() const
+    {
+        return _autocrop;
+    }
+
+    public: bool auto_cuts() const
+    {
+        return _auto_cuts;
+    }
+
+    public: bool range_rejection() const
+    {
+        return _range_rejection;
+    }
+
+    // the smallest voxel side, fine voxels included
+    public: double min_voxel() const;
+
+    public: double phantom_cut() const
+    {
+        return _cut_fraction * min_voxel();
+    }
+
+    public: bool is_voxel(const G4LogicalVolume* logic) const
+    {
+        return _scorers.count(const_cast<G4LogicalVolume*>(logic)) != 0;
+    }
+
+    // distance from the point in the phantom to the nearest voxel face,
+    // on the lattice of the finest voxels
+    public: double voxel_safety(double x, double y, double z) const;
+
+    // volume of the phase-space capture, collimator exit disc in collimator stage
+    public: const G4LogicalVolume* container_logic() const
+    {
+        return _collimator ? _exit_logic : _container_logic;
+    }
+
+    // corners of the phantom container, the built part of the grid,
+    // or of the box around the collimator exit disc
+    public: G4ThreeVector container_lo() const
+    {
+        if (_collimator)
+            return G4ThreeVector{-_col_exit_distance + exit_gap, -_col_outer_radius, -_col_outer_radius};
+        return G4ThreeVector{_crop_x0*voxel_x() - 0.5*cube_x(), _crop_y0*voxel_y() - 0.5*cube_y(), _crop_z0*voxel_z() - 0.5*cube_z()};
+    }
+
+    public: G4ThreeVector container_hi() const
+    {
+        if (_collimator)
+            return G4ThreeVector{-_col_exit_distance + exit_gap + exit_thickness, _col_outer_radius, _col_outer_radius};
+        return container_lo() + G4ThreeVector{_crop_nx*voxel_x(), _crop_ny*voxel_y(), _crop_nz*voxel_z()};
+    }
+
+    public: bool collimator() const
+    {
+        return _collimator;
+    }
+
+    public: const std::vector<G4Material*>& materials() const
+    {
+        return _materials;
+    }
+
+    // material density of every voxel of the whole grid, in PhantomSetup::idx() order
+    public: std::vector<double> densities() const;
+
+    // optical depth from the point on or in the phantom container along the
+    // direction to its exit, mu is attenuation of every material of materials(),
+    // length gets the path to the exit
+    public: double optical_depth(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double* length = nullptr) const;
+
+    // path from the same point to where the optical depth reaches depth,
+    // or to the exit if it never does
+    public: double optical_distance(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double depth) const;
+
+    public: static const char* navigation_name(navigation nav);
+
+    // false if there is no such navigation
+    public: static bool navigation_from_name(const std::string& name, navigation& nav);
+#pragma endregion
+
+#pragma region Mutators
+    // before initialization, or in idle state which rebuilds the geometry
+    public: void set_navigation(navigation nav);
+
+    // build only the box of non-air voxels, the same states as above
+    public: void set_autocrop(bool autocrop);
+
+    // cuts are applied at once, so physics cache and tables see them
+    public: void set_auto_cuts(bool auto_cuts);
+    public: void set_cut_fraction(double fraction);
+    public: void set_world_cut(double cut);
+
+    // collimator stage settings, geometry is rebuilt before the next run
+    public: void set_collimator(bool collimator);
+    public: void set_col_length(double length);
+    public: void set_col_exit_distance(double distance);
+    public: void set_col_entrance_radius(double radius);
+    public: void set_col_exit_radius(double radius);
+    public: void set_col_outer_radius(double radius);
+
+    public: void set_range_rejection(bool range_rejection)
+    {
+        _range_rejection = range_rejection;
+    }
 #pragma endregion
 
     public: virtual G4VPhysicalVolume* Construct() override;
@@ -109,9 +299,29 @@ class Detector : public G4VUserDetectorConstruction
 
     protected: void init_materials();
 
+    protected: void init_crop();
+
+    protected: void rebuild();
+
     protected: void make_phantom_container();
 
+    // collimator channel and its exit disc, instead of the phantom
+    protected: void make_collimator();
+
+    protected: void make_phantom_region();
+
+    protected: void apply_cuts();
+
+    // voxel walk of the two above, stops where the optical depth reaches depth
+    protected: double walk(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double depth, double& length) const;
+
     protected: void make_phantom();
 
+    protected: void make_nested_phantom();
+
+    protected: void make_multires_phantom();
+
+    protected: void make_block(int copy_no, const DoseScorer::block& b);
+
     public: void set_scorer(G4LogicalVolume* voxel_logic);
 };
@@ -0,0 +1,49 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class Detector;
+class G4UIcmdWithAString;
+class G4UIcmdWithABool;
+class G4UIcmdWithADouble;
+class G4UIcmdWithADoubleAndUnit;
+
+class DetectorMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: Detector*                  _detector;
+
+    private: G4UIdirectory*             _geometry_directory;
+
+    private: G4UIcmdWithAString*        _navigation_cmd;
+    private: G4UIcmdWithABool*          _autocrop_cmd;
+
+    private: G4UIcmdWithABool*          _auto_cuts_cmd;
+    private: G4UIcmdWithADouble*        _cut_fraction_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _world_cut_cmd;
+    private: G4UIcmdWithABool*          _range_rejection_cmd;
+
+    private: G4UIdirectory*             _collimator_directory;
+
+    private: G4UIcmdWithABool*          _collimator_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _col_length_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _col_exit_distance_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _col_entrance_radius_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _col_exit_radius_cmd;
+    private: G4UIcmdWithADoubleAndUnit* _col_outer_radius_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DetectorMessenger(Detector* detector);
+    public: ~DetectorMessenger();
+#pragma endregion
+
+    private: G4UIcmdWithADoubleAndUnit* make_length_cmd(const char* name, const char* guidance, const char* parameter);
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
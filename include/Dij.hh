@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "globals.hh"
+
+class DijMessenger;
+class DoseMatrix;
+
+//---------------------------------------------------------------------
+/// Dij class
+///
+/// Settings of per-source dose influence matrix scoring. When enabled,
+/// every worker run scores dose of each primary into the row of its
+/// source, rows are merged on master and written at the end of run,
+/// so source weights could be optimized without re-simulation.
+//---------------------------------------------------------------------
+
+class Dij
+{
+#pragma region Singleton
+    private: static Dij* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: DijMessenger* _messenger;
+
+    private: bool          _enabled;
+    private: std::string   _fname;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Dij();
+    public: Dij(const Dij&)            = delete;
+    public: Dij& operator=(const Dij&) = delete;
+    public: ~Dij();
+#pragma endregion
+
+#pragma region Singleton
+    public: static Dij* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _enabled;
+    }
+
+    public: const std::string& fname() const
+    {
+        return _fname;
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_enabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+#pragma endregion
+
+    // master: write merged matrix of the run
+    public: void write(const DoseMatrix& dm, int64_t nof_histories) const;
+};
@@ -0,0 +1,31 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class Dij;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+
+class DijMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: Dij*                _dij;
+
+    private: G4UIdirectory*      _dij_directory;
+
+    private: G4UIcmdWithABool*   _enable_cmd;
+    private: G4UIcmdWithAString* _fname_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DijMessenger(Dij* dij);
+    public: ~DijMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
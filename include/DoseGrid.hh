@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "PhantomSetup.hh"
+
+//---------------------------------------------------------------------
+/// Dense dose accumulator over the phantom voxel grid
+///
+/// Keeps per voxel sum of per-history dose and sum of its squares,
+/// together with number of histories, so both mean dose and its
+/// statistical uncertainty could be computed at any moment.
+/// Voxel index is the same linear index as PhantomSetup::idx()
+//---------------------------------------------------------------------
+
+class DoseGrid
+{
+#pragma region Data
+    private: int                 _nofv_x;
+    private: int                 _nofv_y;
+    private: int                 _nofv_z;
+
+    private: std::vector<double> _dose;  // sum of per-history dose, internal units
+    private: std::vector<double> _dose2; // sum of squared per-history dose
+
+    private: int64_t             _nof_events;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DoseGrid();
+    public: DoseGrid(int nofv_x, int nofv_y, int nofv_z);
+    public: DoseGrid(const PhantomSetup& phs);
+
+    public: DoseGrid(const DoseGrid& grid)            = default;
+    public: DoseGrid(DoseGrid&& grid)                 = default;
+    public: DoseGrid& operator=(const DoseGrid& grid) = default;
+    public: DoseGrid& operator=(DoseGrid&& grid)      = default;
+
+    public: ~DoseGrid()
+    {
+    }
+#pragma endregion
+
+#pragma region Observers
+    public: int nofv_x() const
+    {
+        return _nofv_x;
+    }
+
+    public: int nofv_y() const
+    {
+        return _nofv_y;
+    }
+
+    public: int nofv_z() const
+    {
+        return _nofv_z;
+    }
+
+    public: int nof_voxels() const
+    {
+        return int(_dose.size());
+    }
+
+    public: int64_t nof_events() const
+    {
+        return _nof_events;
+    }
+
+    public: double dose(int idx) const
+    {
+        return _dose[idx];
+    }
+
+    public: double dose2(int idx) const
+    {
+        return _dose2[idx];
+    }
+
+    public: const std::vector<double>& dose() const
+    {
+        return _dose;
+    }
+
+    public: const std::vector<double>& dose2() const
+    {
+        return _dose2;
+    }
+
+    // true if grid has the same dimensions as the other one
+    public: bool same_shape(const DoseGrid& grid) const
+    {
+        return _nofv_x == grid._nofv_x && _nofv_y == grid._nofv_y && _nofv_z == grid._nofv_z;
+    }
+
+    // mean dose per history in the voxel
+    public: double mean(int idx) const
+    {
+        return (_nof_events > 0) ? _dose[idx] / double(_nof_events) : 0.0;
+    }
+
+    // standard error of the mean dose per history in the voxel
+    public: double sigma(int idx) const;
+
+    public: double total_dose() const;
+#pragma endregion
+
+#pragma region Mutators
+    // score per-history dose into the voxel
+    public: void score(int idx, double d)
+    {
+        _dose[idx]  += d;
+        _dose2[idx] += d*d;
+    }
+
+    public: void add_events(int64_t n)
+    {
+        _nof_events += n;
+    }
+
+    public: void merge(const DoseGrid& grid);
+
+    public: void clear();
+#pragma endregion
+
+#pragma region I/O
+    // raw binary dump of dimensions, events, dose and dose squared
+    public: void write(std::ostream& os) const;
+    public: bool read(std::istream& is);
+
+    // text output in dose.out format, voxel key is offset by key_offset
+    // to be compatible with DoseDeposit hits map keys
+    public: void write_dose_out(std::ostream& os, int key_offset) const;
+#pragma endregion
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+//---------------------------------------------------------------------
+/// Sparse dose influence matrix, source by voxel
+///
+/// Scored entries are appended to a pending buffer, which is sorted and
+/// folded into compressed storage once it grows large enough. Compressed
+/// storage is the list of nonzero entries sorted by source, then voxel,
+/// so merging matrices of several threads is a single linear pass.
+/// Voxel index is the same linear index as PhantomSetup::idx()
+//---------------------------------------------------------------------
+
+class DoseMatrix
+{
+#pragma region Typedefs
+    private: struct entry
+    {
+        int64_t key; // source * nof_voxels + voxel
+        double  dose;
+    };
+#pragma endregion
+
+#pragma region Data
+    private: int                  _nof_srcs;
+    private: int                  _nofv_x;
+    private: int                  _nofv_y;
+    private: int                  _nofv_z;
+
+    // compressed nonzero entries, sorted and unique by key
+    private: std::vector<int64_t> _keys;
+    private: std::vector<double>  _dose;
+
+    private: std::vector<entry>   _pending;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DoseMatrix();
+    public: DoseMatrix(int nof_srcs, int nofv_x, int nofv_y, int nofv_z);
+
+    public: DoseMatrix(const DoseMatrix& dm)            = default;
+    public: DoseMatrix(DoseMatrix&& dm)                 = default;
+    public: DoseMatrix& operator=(const DoseMatrix& dm) = default;
+    public: DoseMatrix& operator=(DoseMatrix&& dm)      = default;
+
+    public: ~DoseMatrix()
+    {
+    }
+#pragma endregion
+
+#pragma region Observers
+    public: int nof_srcs() const
+    {
+        return _nof_srcs;
+    }
+
+    public: int nof_voxels() const
+    {
+        return _nofv_x * _nofv_y * _nofv_z;
+    }
+
+    public: bool empty() const
+    {
+        return _nof_srcs == 0;
+    }
+
+    // number of nonzero entries, valid after compact()
+    public: size_t nof_nonzeros() const
+    {
+        return _keys.size();
+    }
+#pragma endregion
+
+#pragma region Mutators
+    // score dose given by the source to the voxel
+    public: void score(int src, int idx, double d)
+    {
+        _pending.push_back(entry{int64_t(src) * int64_t(nof_voxels()) + idx, d});
+        if (_pending.size() >= max_pending())
+            compact();
+    }
+
+    // fold pending entries into compressed storage
+    public: void compact();
+
+    public: void merge(const DoseMatrix& dm);
+
+    public: void clear();
+#pragma endregion
+
+#pragma region I/O
+    // compressed sparse rows, one row per source, mean dose per history in Gy:
+    //   char[8] "PHDIJ001"
+    //   int32 nof_srcs, nofv_x, nofv_y, nofv_z
+    //   int64 nof_histories, nof_nonzeros
+    //   int64 row_start[nof_srcs + 1]
+    //   int32 voxel[nof_nonzeros]
+    //   float dose[nof_nonzeros]
+    public: void write(std::ostream& os, int64_t nof_histories) const;
+#pragma endregion
+
+    // pending buffer grows with the matrix, so compaction cost stays amortized
+    private: size_t max_pending() const
+    {
+        return (_keys.size() > (size_t(1) << 20)) ? _keys.size() : (size_t(1) << 20);
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+#include "G4PSDoseDeposit3D.hh"
+#include "G4THitsMap.hh"
+
+class G4Step;
+class G4TouchableHistory;
+class G4HCofThisEvent;
+
+//---------------------------------------------------------------------
+/// Voxel dose scorer
+///
+/// G4PSDoseDeposit3D over the phantom grid, kept as a separate class
+/// so the phantom scoring hot spot is visible to the profiler.
+/// With Dij scoring on, dose of every step also goes to the run
+/// dose influence matrix
+//---------------------------------------------------------------------
+
+class DoseScorer : public G4PSDoseDeposit3D
+{
+#pragma region Typedefs
+    // regular voxel block of multi-resolution phantom, its container copy number is
+    // its index; origin is in grid voxels, size in its own voxels, which are
+    // factor times smaller than grid ones
+    public: struct block
+    {
+        int x0, y0, z0;
+        int nx, ny, nz;
+        int factor;
+    };
+#pragma endregion
+
+#pragma region Data
+    // hits map key of the voxel is its linear index plus this offset
+    private: int  _key_offset;
+
+    private: int  _nofv_x;
+    private: int  _nofv_y;
+    private: int  _nofv_z;
+
+    // voxel is Z copy inside X and Y replicas, see Detector::navigation
+    private: bool _nested;
+
+    // built part of the grid, copy numbers are relative to it
+    private: bool _cropped;
+    private: int  _crop_x0;
+    private: int  _crop_y0;
+    private: int  _crop_z0;
+    private: int  _crop_nx;
+    private: int  _crop_ny;
+
+    // multi-resolution phantom, empty otherwise; fine voxels are keyed
+    // after the grid, from _fine_base, and also scored into their grid voxel
+    private: std::vector<block> _blocks;
+    private: int                _fine_base;
+
+    // hits map of the current event
+    private: G4THitsMap<double>* _evt_map;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: DoseScorer(const G4String& name, int nofv_x, int nofv_y, int nofv_z);
+    public: virtual ~DoseScorer();
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_nested(bool nested)
+    {
+        _nested = nested;
+    }
+
+    public: void set_crop(int x0, int y0, int z0, int nx, int ny, int nz);
+
+    public: void set_blocks(const std::vector<block>& blocks)
+    {
+        _blocks = blocks;
+    }
+
+    // energy deposited outside of the regular hits processing, in the voxel
+    // of the step, as range rejection puts residual energy of the electron
+    public: void deposit(const G4Step* aStep, double edep);
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void Initialize(G4HCofThisEvent* HCE) override;
+
+    protected: virtual G4bool ProcessHits(G4Step* aStep, G4TouchableHistory* aTH) override;
+
+    // the same key, in the full grid, for every phantom geometry
+    protected: virtual G4int GetIndex(G4Step* aStep) override;
+#pragma endregion
+
+    // dose of the step into the event map, its grid voxel and Dij
+    private: void score(G4Step* aStep, double edep);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "G4VDiscreteProcess.hh"
+#include "G4VPhysicsConstructor.hh"
+#include "G4ParticleChange.hh"
+#include "globals.hh"
+
+class G4Track;
+class G4Step;
+class G4VEmProcess;
+
+//---------------------------------------------------------------------
+/// ForcedCollision process
+///
+/// Photon marked by mark() interacts on its first step, where it was
+/// put by forced interaction, see SteppingAction. The interaction is one
+/// of the gamma processes, picked by its share of the cross section at
+/// the point, and its own PostStepDoIt does the work. Unmarked photons
+/// never see the process
+//---------------------------------------------------------------------
+
+class ForcedCollision : public G4VDiscreteProcess
+{
+#pragma region Data
+    // the other gamma processes, found on the first forced photon
+    private: std::vector<G4VEmProcess*> _processes;
+    private: std::vector<double>        _sigma;
+
+    // particle change of a photon that found nothing to interact with
+    private: G4ParticleChange           _change;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public:          ForcedCollision();
+    public: virtual ~ForcedCollision();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual G4bool IsApplicable(const G4ParticleDefinition& particle) override;
+
+    public: virtual G4double PostStepGetPhysicalInteractionLength(const G4Track& track, G4double previousStepSize, G4ForceCondition* condition) override;
+
+    public: virtual G4VParticleChange* PostStepDoIt(const G4Track& track, const G4Step& step) override;
+
+    protected: virtual G4double GetMeanFreePath(const G4Track& track, G4double previousStepSize, G4ForceCondition* condition) override;
+#pragma endregion
+
+    // photon not tracked yet interacts on its first step
+    public: static void mark(G4Track* track);
+};
+
+//---------------------------------------------------------------------
+/// ForcedCollisionPhysics
+///
+/// Adds ForcedCollision to the gamma of the physics list it is
+/// registered with
+//---------------------------------------------------------------------
+
+class ForcedCollisionPhysics : public G4VPhysicsConstructor
+{
+#pragma region Ctor/Dtor/ops
+    public:          ForcedCollisionPhysics();
+    public: virtual ~ForcedCollisionPhysics();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void ConstructParticle() override;
+    public: virtual void ConstructProcess() override;
+#pragma endregion
+};
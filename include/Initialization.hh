@@ -2,6 +2,9 @@
 
 #include "G4VUserActionInitialization.hh"
 
+class G4UserSteppingAction;
+class Source;
+
 class Initialization : public G4VUserActionInitialization
 {
 #pragma region Ctor/Dtor/ops
@@ -13,4 +16,7 @@ class Initialization : public G4VUserActionInitialization
     public: virtual void BuildForMaster() const override;
     public: virtual void Build() const override;
 #pragma endregion
+
+    // stepping action of the worker, ph_bench supplies a step counting one
+    protected: virtual G4UserSteppingAction* make_stepping_action(const Source* source) const;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+
+#include "globals.hh"
+
+class ListModeMessenger;
+
+//---------------------------------------------------------------------
+/// ListMode class
+///
+/// Settings of list-mode energy deposition output. When enabled, every
+/// worker writes each scoring step in the phantom into its own file
+/// <fname>.<run>.<thread>, see ListModeStream, and ph_rebin makes dose
+/// on any grid from these files without re-running the transport.
+//---------------------------------------------------------------------
+
+class ListMode
+{
+#pragma region Singleton
+    private: static ListMode* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: ListModeMessenger* _messenger;
+
+    private: bool               _enabled;
+    private: std::string        _fname;
+    private: int                _buffer_size; // records per thread buffer
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: ListMode();
+    public: ListMode(const ListMode&)            = delete;
+    public: ListMode& operator=(const ListMode&) = delete;
+    public: ~ListMode();
+#pragma endregion
+
+#pragma region Singleton
+    public: static ListMode* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _enabled;
+    }
+
+    public: const std::string& fname() const
+    {
+        return _fname;
+    }
+
+    public: int buffer_size() const
+    {
+        return _buffer_size;
+    }
+
+    // file of the worker thread for the run
+    public: std::string stream_name(int run_id, int thread_id) const
+    {
+        return _fname + "." + std::to_string(run_id) + "." + std::to_string(thread_id);
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_enabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+
+    public: void set_buffer_size(int buffer_size)
+    {
+        _buffer_size = buffer_size;
+    }
+#pragma endregion
+};
@@ -0,0 +1,33 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class ListMode;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+
+class ListModeMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: ListMode*             _list_mode;
+
+    private: G4UIdirectory*        _list_mode_directory;
+
+    private: G4UIcmdWithABool*     _enable_cmd;
+    private: G4UIcmdWithAString*   _fname_cmd;
+    private: G4UIcmdWithAnInteger* _buffer_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: ListModeMessenger(ListMode* list_mode);
+    public: ~ListModeMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//---------------------------------------------------------------------
+/// List-mode energy deposition stream of one worker thread
+///
+/// One record per scoring step in the phantom, appended to a buffer
+/// owned by the thread and written to its own file when the buffer is
+/// full, so workers never share anything and never lock. File is the
+/// header followed by records up to the end of file, see ph_rebin.
+//---------------------------------------------------------------------
+
+class ListModeStream
+{
+#pragma region Typedefs
+    public: struct header
+    {
+        char    magic[8];    // "PHLM0002"
+        int32_t record_size; // sizeof(record), checked by readers
+        int32_t run_id;
+        int32_t thread_id;
+        int32_t reserved;
+    };
+
+    // position is the middle of the step in phantom coordinates, grid centred at the origin
+    public: struct record
+    {
+        float   x, y, z;  // mm
+        float   edep;     // MeV, times the track weight
+        float   density;  // g/cm3, material of the step
+        int32_t event;
+        int32_t source;
+        int32_t history;  // history in the event
+    };
+
+    static_assert(sizeof(header) == 24, "list-mode header is written as is");
+    static_assert(sizeof(record) == 32, "list-mode record is written as is");
+#pragma endregion
+
+#pragma region Data
+    private: std::string         _fname;
+    private: std::ofstream       _os;
+
+    private: std::vector<record> _buffer;
+    private: size_t              _size;
+
+    private: int64_t             _nof_records;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: ListModeStream();
+    public: ListModeStream(const ListModeStream&)            = delete;
+    public: ListModeStream& operator=(const ListModeStream&) = delete;
+    public: ~ListModeStream();
+#pragma endregion
+
+#pragma region Observers
+    public: bool is_open() const
+    {
+        return _os.is_open();
+    }
+
+    public: int64_t nof_records() const
+    {
+        return _nof_records;
+    }
+#pragma endregion
+
+#pragma region Mutators
+    // truncates the file and writes its header, false if it cannot be opened
+    public: bool open(const std::string& fname, int run_id, int thread_id, size_t buffer_size);
+
+    public: void push(const record& r)
+    {
+        _buffer[_size++] = r;
+        if (_size == _buffer.size())
+            flush();
+    }
+
+    // writes what is buffered and closes the file
+    public: void close();
+#pragma endregion
+
+    private: void flush();
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "globals.hh"
+
+#include "DoseGrid.hh"
+
+class MonitorMessenger;
+class Detector;
+
+//---------------------------------------------------------------------
+/// Monitor class
+///
+/// Live run telemetry. Workers update their event counters every event
+/// and periodically publish snapshot of their dose grid. Monitor thread
+/// on master wakes up every few seconds and emits JSON Lines record with
+/// events done, per thread rates, ETA, peak dose and its uncertainty,
+/// and writes low resolution dose preview slices through isocentre.
+//---------------------------------------------------------------------
+
+class Monitor
+{
+#pragma region Typedefs
+    public: using clock = std::chrono::steady_clock;
+
+    // per worker counter, padded so workers do not share cache lines
+    private: struct alignas(64) counter
+    {
+        std::atomic<int64_t> events;
+        int64_t              last_events; // monitor thread only
+    };
+#pragma endregion
+
+#pragma region Singleton
+    private: static Monitor* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: MonitorMessenger*       _messenger;
+
+    private: std::string             _fname;          // "stdout" or file name
+    private: double                  _every_seconds;  // 0 means monitor is off
+    private: int                     _preview_factor; // voxels binned per preview pixel, 0 means no preview
+
+    private: std::vector<counter>    _counters;
+
+    private: std::mutex              _mutex;
+    private: std::map<int, DoseGrid> _snapshots;
+    private: float                   _iso_x;
+    private: float                   _iso_y;
+    private: float                   _iso_z;
+
+    private: std::thread             _thread;
+    private: std::mutex              _wait_mutex;
+    private: std::condition_variable _wakeup;
+    private: bool                    _stop;
+
+    private: const Detector*         _detector;
+    private: std::ofstream           _out;
+    private: int                     _run_id;
+    private: int64_t                 _events_to_process;
+    private: clock::time_point       _run_start;
+    private: clock::time_point       _last_emit;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Monitor();
+    public: Monitor(const Monitor&)            = delete;
+    public: Monitor& operator=(const Monitor&) = delete;
+    public: ~Monitor();
+#pragma endregion
+
+#pragma region Singleton
+    public: static Monitor* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _every_seconds > 0.0;
+    }
+
+    public: bool publish_due(clock::time_point last_publish) const
+    {
+        std::chrono::duration<double> elapsed = clock::now() - last_publish;
+        return elapsed.count() >= _every_seconds;
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+
+    public: void set_every_seconds(double seconds)
+    {
+        _every_seconds = seconds;
+    }
+
+    public: void set_preview_factor(int factor)
+    {
+        _preview_factor = factor;
+    }
+
+    // worker: isocentre in phantom coordinates, from its source shifts
+    public: void set_isocentre(float x, float y, float z);
+
+    // worker: number of events done so far, called every event
+    public: void count(int thread_id, int64_t nof_events)
+    {
+        if (thread_id >= 0 && thread_id < int(_counters.size()))
+            _counters[thread_id].events.store(nof_events, std::memory_order_relaxed);
+    }
+
+    // worker: latest snapshot of its dose grid
+    public: void publish(int thread_id, const DoseGrid& local);
+
+    // master: start monitor thread
+    public: void begin_run(int run_id, int64_t nof_events_to_process);
+
+    // master: stop monitor thread and emit the final record
+    public: void end_run();
+#pragma endregion
+
+    private: void loop();
+    private: void emit(bool done);
+    private: void write_preview(const DoseGrid& grid, int ix, int iy, int iz, const std::string& fname) const;
+};
@@ -0,0 +1,33 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class Monitor;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+class G4UIcmdWithADouble;
+
+class MonitorMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: Monitor*              _monitor;
+
+    private: G4UIdirectory*        _mon_directory;
+
+    private: G4UIcmdWithAString*   _fname_cmd;
+    private: G4UIcmdWithADouble*   _every_seconds_cmd;
+    private: G4UIcmdWithAnInteger* _preview_factor_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: MonitorMessenger(Monitor* monitor);
+    public: ~MonitorMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "G4VNestedParameterisation.hh"
+
+class G4VTouchable;
+class G4VPhysicalVolume;
+class G4Material;
+
+//---------------------------------------------------------------------
+/// Nested voxel parameterisation
+///
+/// Phantom as Y replica slices, X replica columns and parameterised Z
+/// voxels inside. Material of the voxel is picked by its Z copy number
+/// together with X and Y replica numbers of the parents.
+//---------------------------------------------------------------------
+
+class NestedPhantom : public G4VNestedParameterisation
+{
+#pragma region Data
+    private: std::vector<G4Material*> _materials;
+    private: const size_t*            _mat_IDs; // index of material of each voxel, nullptr means all are the first one
+
+    private: int                      _nofv_x;
+    private: int                      _nofv_y;
+    private: int                      _nofv_z;
+
+    private: double                   _voxel_z;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: NestedPhantom(const std::vector<G4Material*>& materials, const size_t* mat_IDs,
+                          int nofv_x, int nofv_y, int nofv_z, double voxel_z);
+    public: virtual ~NestedPhantom() override;
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual G4Material* ComputeMaterial(G4VPhysicalVolume* curVol, const int rep_no,
+                                                const G4VTouchable* parentTouch = nullptr) override;
+
+    public: virtual int GetNumberOfMaterials() const override;
+
+    public: virtual G4Material* GetMaterial(int idx) const override;
+
+    public: virtual void ComputeTransformation(const int rep_no, G4VPhysicalVolume* curVol) const override;
+
+    public: virtual void ComputeDimensions(G4Box&, const int, const G4VPhysicalVolume*) const override
+    {
+        // all voxels are of the same size as the voxel solid
+    }
+#pragma endregion
+};
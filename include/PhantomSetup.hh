@@ -1,7 +1,23 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "globals.hh"
 
+//---------------------------------------------------------------------
+/// Phantom header cards, "KEYWORD | values", up to END-INPUT:
+///
+///   VOXELSIZE | x y z      voxel size in mm
+///   DIMENSION | nx ny nz   number of voxels
+///   MATERIALS | fname      optional, one byte material index per voxel,
+///                          x fastest, 0 is air
+///   FINEBOX   | x0 y0 z0 nx ny nz factor
+///                          optional, box of nx*ny*nz voxels from voxel
+///                          (x0, y0, z0), each split into factor^3 fine voxels
+//---------------------------------------------------------------------
+
 class PhantomSetup
 {
 #pragma region Data
@@ -16,6 +32,26 @@ class PhantomSetup
     private: float _cube_x;
     private: float _cube_y;
     private: float _cube_z;
+
+    // material index of every voxel, 0 is air, empty if header has no MATERIALS card
+    private: std::vector<uint8_t> _materials;
+
+    // tight box of non-air voxels, whole grid if there is nothing to crop
+    private: int   _box_x0;
+    private: int   _box_y0;
+    private: int   _box_z0;
+    private: int   _box_nx;
+    private: int   _box_ny;
+    private: int   _box_nz;
+
+    // high resolution box in voxels of the grid, factor 0 if there is none
+    private: int   _fine_x0;
+    private: int   _fine_y0;
+    private: int   _fine_z0;
+    private: int   _fine_nx;
+    private: int   _fine_ny;
+    private: int   _fine_nz;
+    private: int   _fine_factor;
 #pragma endregion
 
 #pragma region Ctor/Dtor/ops
@@ -32,7 +68,24 @@ class PhantomSetup
 
         _cube_x{phs._cube_x},
         _cube_y{phs._cube_y},
-        _cube_z{phs._cube_z}
+        _cube_z{phs._cube_z},
+
+        _materials{phs._materials},
+
+        _box_x0{phs._box_x0},
+        _box_y0{phs._box_y0},
+        _box_z0{phs._box_z0},
+        _box_nx{phs._box_nx},
+        _box_ny{phs._box_ny},
+        _box_nz{phs._box_nz},
+
+        _fine_x0{phs._fine_x0},
+        _fine_y0{phs._fine_y0},
+        _fine_z0{phs._fine_z0},
+        _fine_nx{phs._fine_nx},
+        _fine_ny{phs._fine_ny},
+        _fine_nz{phs._fine_nz},
+        _fine_factor{phs._fine_factor}
     {
     }
 
@@ -47,7 +100,24 @@ class PhantomSetup
 
         _cube_x{phs._cube_x},
         _cube_y{phs._cube_y},
-        _cube_z{phs._cube_z}
+        _cube_z{phs._cube_z},
+
+        _materials{std::move(phs._materials)},
+
+        _box_x0{phs._box_x0},
+        _box_y0{phs._box_y0},
+        _box_z0{phs._box_z0},
+        _box_nx{phs._box_nx},
+        _box_ny{phs._box_ny},
+        _box_nz{phs._box_nz},
+
+        _fine_x0{phs._fine_x0},
+        _fine_y0{phs._fine_y0},
+        _fine_z0{phs._fine_z0},
+        _fine_nx{phs._fine_nx},
+        _fine_ny{phs._fine_ny},
+        _fine_nz{phs._fine_nz},
+        _fine_factor{phs._fine_factor}
     {
     }
 
@@ -65,6 +135,23 @@ class PhantomSetup
         _cube_y = phs._cube_y;
         _cube_z = phs._cube_z;
 
+        _materials = phs._materials;
+
+        _box_x0 = phs._box_x0;
+        _box_y0 = phs._box_y0;
+        _box_z0 = phs._box_z0;
+        _box_nx = phs._box_nx;
+        _box_ny = phs._box_ny;
+        _box_nz = phs._box_nz;
+
+        _fine_x0     = phs._fine_x0;
+        _fine_y0     = phs._fine_y0;
+        _fine_z0     = phs._fine_z0;
+        _fine_nx     = phs._fine_nx;
+        _fine_ny     = phs._fine_ny;
+        _fine_nz     = phs._fine_nz;
+        _fine_factor = phs._fine_factor;
+
         return *this;
     }
 
@@ -82,6 +169,23 @@ class PhantomSetup
         _cube_y = phs._cube_y;
         _cube_z = phs._cube_z;
 
+        _materials = std::move(phs._materials);
+
+        _box_x0 = phs._box_x0;
+        _box_y0 = phs._box_y0;
+        _box_z0 = phs._box_z0;
+        _box_nx = phs._box_nx;
+        _box_ny = phs._box_ny;
+        _box_nz = phs._box_nz;
+
+        _fine_x0     = phs._fine_x0;
+        _fine_y0     = phs._fine_y0;
+        _fine_z0     = phs._fine_z0;
+        _fine_nx     = phs._fine_nx;
+        _fine_ny     = phs._fine_ny;
+        _fine_nz     = phs._fine_nz;
+        _fine_factor = phs._fine_factor;
+
         return *this;
     }
 
@@ -151,5 +255,112 @@ class PhantomSetup
     {
         return ix + _nofv_x*(iy + iz*_nofv_y);
     }
+
+    public: bool has_materials() const
+    {
+        return !_materials.empty();
+    }
+
+    // material index of the voxel, air if there is no material data
+    public: int material(int idx) const
+    {
+        return _materials.empty() ? 0 : int(_materials[idx]);
+    }
+
+    public: int box_x0() const
+    {
+        return _box_x0;
+    }
+
+    public: int box_y0() const
+    {
+        return _box_y0;
+    }
+
+    public: int box_z0() const
+    {
+        return _box_z0;
+    }
+
+    public: int box_nx() const
+    {
+        return _box_nx;
+    }
+
+    public: int box_ny() const
+    {
+        return _box_ny;
+    }
+
+    public: int box_nz() const
+    {
+        return _box_nz;
+    }
+
+    public: bool has_fine() const
+    {
+        return _fine_factor > 1;
+    }
+
+    public: int fine_x0() const
+    {
+        return _fine_x0;
+    }
+
+    public: int fine_y0() const
+    {
+        return _fine_y0;
+    }
+
+    public: int fine_z0() const
+    {
+        return _fine_z0;
+    }
+
+    public: int fine_nx() const
+    {
+        return _fine_nx;
+    }
+
+    public: int fine_ny() const
+    {
+        return _fine_ny;
+    }
+
+    public: int fine_nz() const
+    {
+        return _fine_nz;
+    }
+
+    public: int fine_factor() const
+    {
+        return _fine_factor;
+    }
+
+    // number of fine voxels along the axes of the high resolution box
+    public: int fine_nofv_x() const
+    {
+        return _fine_nx * _fine_factor;
+    }
+
+    public: int fine_nofv_y() const
+    {
+        return _fine_ny * _fine_factor;
+    }
+
+    public: int fine_nofv_z() const
+    {
+        return _fine_nz * _fine_factor;
+    }
+
+    public: int fine_nof_voxels() const
+    {
+        return fine_nofv_x() * fine_nofv_y() * fine_nofv_z();
+    }
 #pragma endregion
+
+    private: void read_materials(const std::string& fname);
+
+    // tight box of non-air voxels, slices are scanned in parallel
+    private: void find_box();
 };
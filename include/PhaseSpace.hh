@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "globals.hh"
+
+class PhaseSpaceMessenger;
+class Detector;
+
+//---------------------------------------------------------------------
+/// PhaseSpace class
+///
+/// Phase-space capture and replay at the phantom surface. In capture
+/// mode every particle entering the phantom container is written to the
+/// phase-space file and killed, so the run transports the source side
+/// only. In replay mode the source starts every history from its records
+/// instead, so phantom studies skip the source side transport. Capture
+/// and replay need the same phantom container, see PhaseSpaceStream.
+//---------------------------------------------------------------------
+
+class PhaseSpace
+{
+#pragma region Singleton
+    private: static PhaseSpace* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: PhaseSpaceMessenger* _messenger;
+
+    private: std::string          _fname;
+    private: bool                 _capture;
+    private: bool                 _replay;
+
+    // replay: first record of every captured history, and the end of the last one
+    private: std::vector<int64_t> _history_start;
+
+    // replay: source histories of the capture run, captured ones included
+    private: int64_t              _nof_source_histories;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: PhaseSpace();
+    public: PhaseSpace(const PhaseSpace&)            = delete;
+    public: PhaseSpace& operator=(const PhaseSpace&) = delete;
+    public: ~PhaseSpace();
+#pragma endregion
+
+#pragma region Singleton
+    public: static PhaseSpace* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: const std::string& fname() const
+    {
+        return _fname;
+    }
+
+    // replay takes over if both are on
+    public: bool capture() const
+    {
+        return _capture && !_replay;
+    }
+
+    public: bool replay() const
+    {
+        return _replay;
+    }
+
+    // worker: part file of the thread, put together on master at the end of run
+    public: std::string part_name(int thread_id) const
+    {
+        return _fname + ".part" + std::to_string(thread_id);
+    }
+
+    // worker: captured histories of the file loaded by begin_run()
+    public: int64_t nof_histories() const
+    {
+        return _history_start.empty() ? 0 : int64_t(_history_start.size()) - 1;
+    }
+
+    // worker: records [first, last) of the history, histories are replayed over and over
+    public: std::pair<int64_t, int64_t> history_records(int64_t history) const
+    {
+        int64_t k = history % nof_histories();
+        return {_history_start[k], _history_start[k + 1]};
+    }
+
+    // worker: source histories with no particle reaching the phantom, which the
+    // capture run had next to the history; over all captured histories they sum up
+    // to the source histories of the capture run
+    public: int64_t empty_histories(int64_t history) const
+    {
+        int64_t n = nof_histories();
+        int64_t k = history % n;
+        int64_t q = _nof_source_histories / n;
+        int64_t r = _nof_source_histories % n;
+        return std::max<int64_t>(0, q - 1 + ((k + 1)*r)/n - (k*r)/n);
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_fname(const std::string& fname)
+    {
+        _fname = fname;
+    }
+
+    public: void set_capture(bool capture)
+    {
+        _capture = capture;
+    }
+
+    public: void set_replay(bool replay)
+    {
+        _replay = replay;
+    }
+
+    // master: index histories of the file to replay, before workers start
+    public: void begin_run(const Detector* detector);
+
+    // master: header and part files of the workers into the phase-space file in capture mode,
+    // in replay mode check that the run covered the source histories of the file once
+    public: void end_run(const Detector* detector, int64_t nof_histories) const;
+#pragma endregion
+};
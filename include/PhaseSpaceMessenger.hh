@@ -0,0 +1,32 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class PhaseSpace;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+
+class PhaseSpaceMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: PhaseSpace*         _phase_space;
+
+    private: G4UIdirectory*      _phsp_directory;
+
+    private: G4UIcmdWithAString* _fname_cmd;
+    private: G4UIcmdWithABool*   _capture_cmd;
+    private: G4UIcmdWithABool*   _replay_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: PhaseSpaceMessenger(PhaseSpace* phase_space);
+    public: ~PhaseSpaceMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
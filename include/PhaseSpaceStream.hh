@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//---------------------------------------------------------------------
+/// Phase-space file at the phantom surface
+///
+/// File is the header followed by records of particles entering the
+/// phantom container. Records of one history are contiguous, the first
+/// one is flagged. Every worker writes its records to its own part file
+/// through this stream, master puts the header and the parts together
+/// at the end of run, see PhaseSpace.
+//---------------------------------------------------------------------
+
+class PhaseSpaceStream
+{
+#pragma region Typedefs
+    public: enum : int8_t { gamma, electron, positron };
+    public: enum : int8_t { new_history = 1 };
+
+    public: struct header
+    {
+        char    magic[8];       // "PHPS0001"
+        int32_t record_size;    // sizeof(record), checked by readers
+        int32_t reserved;
+        int64_t nof_histories;  // histories simulated to make the file
+        int64_t nof_records;
+        float   lo[3];          // phantom container corners, mm
+        float   hi[3];
+    };
+
+    public: struct record
+    {
+        float   x, y, z;        // mm, on the container surface
+        float   wx, wy, wz;     // direction
+        float   e;              // kinetic energy, MeV
+        float   weight;
+        int16_t source;
+        int8_t  particle;
+        int8_t  flags;
+    };
+
+    static_assert(sizeof(header) == 56, "phase-space header is written as is");
+    static_assert(sizeof(record) == 36, "phase-space record is written as is");
+#pragma endregion
+
+#pragma region Data
+    private: std::string         _fname;
+    private: std::ofstream       _os;
+
+    private: std::vector<record> _buffer;
+    private: size_t              _size;
+
+    private: int64_t             _nof_records;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: PhaseSpaceStream();
+    public: PhaseSpaceStream(const PhaseSpaceStream&)            = delete;
+    public: PhaseSpaceStream& operator=(const PhaseSpaceStream&) = delete;
+    public: ~PhaseSpaceStream();
+#pragma endregion
+
+#pragma region Observers
+    public: bool is_open() const
+    {
+        return _os.is_open();
+    }
+#pragma endregion
+
+#pragma region Mutators
+    // part file has no header, false if it cannot be opened
+    public: bool open(const std::string& fname, size_t buffer_size);
+
+    public: void push(const record& r)
+    {
+        _buffer[_size++] = r;
+        if (_size == _buffer.size())
+            flush();
+    }
+
+    // writes what is buffered and closes the file
+    public: void close();
+#pragma endregion
+
+    private: void flush();
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+
+#include "globals.hh"
+
+class PhysicsCacheMessenger;
+class G4VUserPhysicsList;
+
+//---------------------------------------------------------------------
+/// PhysicsCache class
+///
+/// Keeps built physics tables in a cache directory, one subdirectory
+/// per key. Key covers Geant4 version, physics list, material table and
+/// production cuts. If the tables of the current key are in the cache,
+/// physics list retrieves them instead of building, otherwise they are
+/// stored at the end of the first run.
+//---------------------------------------------------------------------
+
+class PhysicsCache
+{
+#pragma region Singleton
+    private: static PhysicsCache* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: PhysicsCacheMessenger* _messenger;
+
+    private: G4VUserPhysicsList*    _physics;
+    private: std::string            _physics_name;
+
+    private: std::string            _dir;       // cache root, empty means cache is off
+    private: std::string            _key;       // description of what tables depend on
+    private: std::string            _entry_dir; // _dir/<hash of key>
+    private: bool                   _retrieved;
+    private: bool                   _store_pending;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: PhysicsCache(G4VUserPhysicsList* physics, const std::string& physics_name);
+    public: PhysicsCache(const PhysicsCache&)            = delete;
+    public: PhysicsCache& operator=(const PhysicsCache&) = delete;
+    public: ~PhysicsCache();
+#pragma endregion
+
+#pragma region Singleton
+    public: static PhysicsCache* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return !_dir.empty();
+    }
+
+    public: bool retrieved() const
+    {
+        return _retrieved;
+    }
+
+    // description of what physics tables depend on
+    public: std::string key() const;
+#pragma endregion
+
+#pragma region Mutators
+    // after initialization, materials and cuts have to be known, before the first run
+    public: void set_dir(const std::string& dir);
+
+    // master: store the tables built by the first run, if they were not retrieved
+    public: void store();
+#pragma endregion
+};
@@ -0,0 +1,29 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class PhysicsCache;
+class G4UIcmdWithAString;
+
+class PhysicsCacheMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: PhysicsCache*       _cache;
+
+    private: G4UIdirectory*      _cache_directory;
+
+    private: G4UIcmdWithAString* _dir_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: PhysicsCacheMessenger(PhysicsCache* cache);
+    public: ~PhysicsCacheMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+class G4ParticleDefinition;
+class G4LogicalVolume;
+
+//---------------------------------------------------------------------
+/// Profiler class
+///
+/// Per-thread counters and TSC timers for the hot path sections.
+/// Every thread owns its own instance, no locking on the hot path,
+/// all instances are aggregated by master into JSON report at the
+/// end of run. High frequency sections are timed on a sample of calls
+/// only, all calls are counted.
+/// Everything is compiled out unless PH_PROFILE is defined.
+//---------------------------------------------------------------------
+
+class Profiler
+{
+#pragma region Typedefs
+    public: enum Section
+    {
+        GENERATE,     // Source::GeneratePrimaries
+        TRACKING,     // begin to end of event action
+        MATERIAL,     // Phantom::ComputeMaterial
+        SCORING,      // DoseScorer::ProcessHits
+        RECORD_EVENT, // Run::RecordEvent
+        MERGE,        // Run::Merge
+        NOF_SECTIONS
+    };
+
+    public: template <typename T> using counters = std::vector<std::pair<const T*, uint64_t>>;
+#pragma endregion
+
+#pragma region Registry
+    private: static std::mutex             _registry_mutex;
+    private: static std::vector<Profiler*> _registry;
+
+    // TSC calibration against wall clock, done over the whole run
+    private: static uint64_t                              _run_ticks;
+    private: static std::chrono::steady_clock::time_point _run_start;
+#pragma endregion
+
+#pragma region Data
+    private: int      _thread_id;
+
+    private: uint64_t _calls[NOF_SECTIONS];
+    private: uint64_t _timed[NOF_SECTIONS];
+    private: uint64_t _ticks[NOF_SECTIONS];
+    private: uint64_t _start[NOF_SECTIONS];
+
+    private: counters<G4ParticleDefinition> _particle_steps;
+    private: counters<G4LogicalVolume>      _volume_steps;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    private: Profiler(int thread_id);
+    public:  Profiler(const Profiler&)            = delete;
+    public:  Profiler& operator=(const Profiler&) = delete;
+    public:  ~Profiler();
+#pragma endregion
+
+    // instance of the calling thread
+    public: static Profiler& local();
+
+    public: static uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // 1 of (mask+1) calls is timed for sections hit per step
+    public: static uint64_t sample_mask(Section s)
+    {
+        return (s == MATERIAL || s == SCORING) ? 15 : 0;
+    }
+
+    public: bool sample(Section s)
+    {
+        return (_calls[s]++ & sample_mask(s)) == 0;
+    }
+
+    public: void add(Section s, uint64_t t)
+    {
+        ++_timed[s];
+        _ticks[s] += t;
+    }
+
+    // for sections which begin and end in different callbacks
+    public: void start(Section s)
+    {
+        ++_calls[s];
+        _start[s] = ticks();
+    }
+
+    public: void stop(Section s)
+    {
+        add(s, ticks() - _start[s]);
+    }
+
+    public: void count_step(const G4ParticleDefinition* particle, const G4LogicalVolume* volume)
+    {
+        ++find(_particle_steps, particle);
+        ++find(_volume_steps, volume);
+    }
+
+    public: void clear();
+
+    // master: mark run start for TSC calibration
+    public: static void begin_run();
+
+    // master: aggregate all threads and write JSON report
+    public: static void report(const std::string& fname, int run_id, int64_t nof_events);
+
+    // only a handful of particles and volumes, linear search with the last hit in front
+    private: template <typename T> static uint64_t& find(counters<T>& cnt, const T* key)
+    {
+        for(size_t k = 0; k != cnt.size(); ++k)
+        {
+            if (cnt[k].first == key)
+            {
+                if (k != 0)
+                {
+                    std::swap(cnt[k], cnt[0]);
+                }
+                return cnt[0].second;
+            }
+        }
+        cnt.emplace(cnt.begin(), key, 0);
+        return cnt[0].second;
+    }
+};
+
+// RAII timer for the section, timed only for the sampled calls
+class ProfileScope
+{
+    private: Profiler&         _profiler;
+    private: Profiler::Section _section;
+    private: uint64_t          _t0;
+    private: bool              _on;
+
+    public: ProfileScope(Profiler::Section s):
+        _profiler(Profiler::local()),
+        _section{s},
+        _t0{0},
+        _on{_profiler.sample(s)}
+    {
+        if (_on)
+            _t0 = Profiler::ticks();
+    }
+
+    public: ~ProfileScope()
+    {
+        if (_on)
+            _profiler.add(_section, Profiler::ticks() - _t0);
+    }
+};
+
+#ifdef PH_PROFILE
+#define PH_PROFILE_SCOPE(section)     ProfileScope ph_profile_scope{Profiler::section}
+#define PH_PROFILE_START(section)     Profiler::local().start(Profiler::section)
+#define PH_PROFILE_STOP(section)      Profiler::local().stop(Profiler::section)
+#define PH_PROFILE_STEP(step)         Profiler::local().count_step((step)->GetTrack()->GetDefinition(), \
+                                          (step)->GetPreStepPoint()->GetPhysicalVolume()->GetLogicalVolume())
+#define PH_PROFILE_CLEAR()            Profiler::local().clear()
+#define PH_PROFILE_BEGIN_RUN()        Profiler::begin_run()
+#define PH_PROFILE_REPORT(f, id, n)   Profiler::report(f, id, n)
+#else
+#define PH_PROFILE_SCOPE(section)
+#define PH_PROFILE_START(section)     ((void)0)
+#define PH_PROFILE_STOP(section)      ((void)0)
+#define PH_PROFILE_STEP(step)         ((void)0)
+#define PH_PROFILE_CLEAR()            ((void)0)
+#define PH_PROFILE_BEGIN_RUN()        ((void)0)
+#define PH_PROFILE_REPORT(f, id, n)   ((void)0)
+#endif
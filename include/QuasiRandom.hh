@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "globals.hh"
+
+class QuasiRandomMessenger;
+
+//---------------------------------------------------------------------
+/// QuasiRandom class
+///
+/// Digitally shifted Sobol sequence over the few dimensions the dose
+/// in the focus depends on smoothly: assembly rotation angle, polar
+/// cosine, azimuth and energy choice of every assembly sample. Point
+/// index comes from the event ID, so threads take disjoint segments
+/// of the sequence. Master draws a new random shift for every run,
+/// so each run is an independent randomized replicate and the dose
+/// stays unbiased.
+//---------------------------------------------------------------------
+
+class QuasiRandom
+{
+#pragma region Typedefs
+    public: static constexpr int nof_dims = 4;
+    public: static constexpr int nof_bits = 32;
+#pragma endregion
+
+#pragma region Singleton
+    private: static QuasiRandom* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: QuasiRandomMessenger* _messenger;
+
+    private: bool                  _enabled;
+
+    // direction numbers of every dimension and random digital shift of the run
+    private: std::array<std::array<uint32_t, nof_bits>, nof_dims> _directions;
+    private: std::array<uint32_t, nof_dims>                       _shift;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: QuasiRandom();
+    public: QuasiRandom(const QuasiRandom&)            = delete;
+    public: QuasiRandom& operator=(const QuasiRandom&) = delete;
+    public: ~QuasiRandom();
+#pragma endregion
+
+#pragma region Singleton
+    public: static QuasiRandom* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _enabled;
+    }
+
+    // point of the sequence, all coordinates in (0,1)
+    public: void point(uint64_t index, double* u) const;
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_enabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    // master: new digital shift, drawn before workers start the run
+    public: void begin_run();
+#pragma endregion
+};
@@ -0,0 +1,29 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class QuasiRandom;
+class G4UIcmdWithABool;
+
+class QuasiRandomMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: QuasiRandom*      _qmc;
+
+    private: G4UIdirectory*    _qmc_directory;
+
+    private: G4UIcmdWithABool* _enable_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: QuasiRandomMessenger(QuasiRandom* qmc);
+    public: ~QuasiRandomMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
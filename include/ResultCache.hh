@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "globals.hh"
+
+#include "DoseGrid.hh"
+
+class ResultCacheMessenger;
+
+//---------------------------------------------------------------------
+/// ResultCache class
+///
+/// Content addressed cache of run results. Key is hash over everything
+/// the dose depends on: executable, physics and materials, phantom
+/// header with its materials file, /GP/source and /GP/geometry settings
+/// with their input files and master random engine state. Entries are
+/// checkpoints <hash>.<events>.chk, so cached beamOn either reuses an
+/// entry with the same number of events, or resumes the largest smaller
+/// one and simulates only the extra events. Random sequence continues
+/// from the entry, so the result is the same as of simulation from
+/// scratch.
+//---------------------------------------------------------------------
+
+class ResultCache
+{
+#pragma region Singleton
+    private: static ResultCache* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: ResultCacheMessenger* _messenger;
+
+    private: std::string           _dir; // empty means cache is off
+
+    private: std::string           _pending_entry; // entry to store at the end of the current run
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: ResultCache();
+    public: ResultCache(const ResultCache&)            = delete;
+    public: ResultCache& operator=(const ResultCache&) = delete;
+    public: ~ResultCache();
+#pragma endregion
+
+#pragma region Singleton
+    public: static ResultCache* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return !_dir.empty();
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_dir(const std::string& dir)
+    {
+        _dir = dir;
+    }
+
+    // master: beamOn which looks the result up first
+    public: void beam_on(int nof_events);
+
+    // master, end of run: store merged result if the run was started by beam_on
+    public: void end_run(const DoseGrid& total);
+#pragma endregion
+
+    private: std::string make_key() const;
+};
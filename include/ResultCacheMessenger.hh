@@ -0,0 +1,31 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class ResultCache;
+class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+
+class ResultCacheMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: ResultCache*          _cache;
+
+    private: G4UIdirectory*        _cache_directory;
+
+    private: G4UIcmdWithAString*   _dir_cmd;
+    private: G4UIcmdWithAnInteger* _beam_on_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: ResultCacheMessenger(ResultCache* cache);
+    public: ~ResultCacheMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
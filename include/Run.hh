@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -9,6 +11,11 @@
 
 #include "G4THitsMap.hh"
 
+#include "DoseGrid.hh"
+#include "DoseMatrix.hh"
+#include "ListModeStream.hh"
+#include "PhaseSpaceStream.hh"
+
 //---------------------------------------------------------------------
 /// Run class
 ///
@@ -23,6 +30,38 @@ class Run : public G4Run
     private: std::vector<std::string>          _CollName;
     private: std::vector<int>                  _CollID;
     private: std::vector<G4THitsMap<double>*>  _runMap;
+
+    // dense per-history dose and dose squared, for uncertainty and checkpoints
+    private: DoseGrid                          _grid;
+    private: int                               _key_offset;
+    private: int                               _dose_coll; // index of DoseDeposit collection
+    private: int                               _history;   // history being tracked in the event, -1 if none
+    private: int64_t                           _event_histories; // histories of the event counted so far
+    private: int64_t                           _nof_recorded;
+
+    // per-source dose influence matrix, only when Dij scoring is on
+    private: DoseMatrix                        _dij;
+    private: int                               _source;    // source of the primary being tracked
+
+    // fine voxels of multi-resolution phantom, keyed after the grid ones
+    private: DoseGrid                          _fine_grid;
+
+    // per-shot dose of the plan, only when shot dose is on
+    private: std::vector<DoseGrid>             _shot_grids;
+    private: int                               _shot;      // shot of the history being tracked
+
+    // list-mode stream of the worker, only when list mode is on
+    private: ListModeStream                    _list_mode;
+    private: int                               _event_id;  // event of the history being tracked
+
+    // phase-space part of the worker, only in capture mode,
+    // and the history of the last captured particle
+    private: PhaseSpaceStream                  _phase_space;
+    private: int                               _captured_event;
+    private: int                               _captured_history;
+
+    private: std::chrono::steady_clock::time_point _last_publish;
+    private: std::chrono::steady_clock::time_point _last_monitor;
 #pragma endregion
 
 #pragma region Ctor/Dtor/ops
@@ -35,6 +74,66 @@ class Run : public G4Run
     public:  virtual void RecordEvent(const G4Event*) override;
 #pragma endregion
 
+#pragma region Mutators
+    // called when primary of the history starts tracking,
+    // dose of the previous history of the event is scored at switch
+    public: void begin_history(int history, int shot)
+    {
+        if (history == _history)
+            return;
+
+        if (_history >= 0)
+            end_history();
+        _history  = history;
+        _shot     = shot;
+        _event_id = current_event_id();
+    }
+
+    public: void set_source(int source)
+    {
+        _source = source;
+    }
+
+    // dose of the step into the row of the source being tracked
+    public: void score_dij(int idx, double d)
+    {
+        if (!_dij.empty() && idx >= 0 && idx < _dij.nof_voxels())
+            _dij.score(_source, idx, d);
+    }
+
+    // worker: opens its list-mode and phase-space files for the run
+    public: void open_streams(int run_id);
+
+    // worker: writes what is left, called at the end of its run
+    public: void close_streams()
+    {
+        _list_mode.close();
+        _phase_space.close();
+    }
+
+    // energy deposited at the point by the history being tracked
+    public: void record_list_mode(float x, float y, float z, float edep, float density)
+    {
+        if (_list_mode.is_open())
+            _list_mode.push(ListModeStream::record{x, y, z, edep, density, _event_id, int32_t(_source), int32_t(_history)});
+    }
+
+    // particle entering the phantom, source and history are the ones being tracked
+    public: void capture(PhaseSpaceStream::record r)
+    {
+        if (!_phase_space.is_open())
+            return;
+
+        bool first = (_event_id != _captured_event || _history != _captured_history);
+        r.source   = int16_t(_source);
+        r.flags    = first ? PhaseSpaceStream::new_history : 0;
+        _phase_space.push(r);
+
+        _captured_event   = _event_id;
+        _captured_history = _history;
+    }
+#pragma endregion
+
 #pragma region Observers
     // Access methods for scoring information.
     // - Number of HitsMap for this RUN.
@@ -57,10 +156,57 @@ class Run : public G4Run
 
     public: G4THitsMap<double>* GetHitsMap(const std::string& fullName) const;
 
+    public: const DoseGrid& grid() const
+    {
+        return _grid;
+    }
+
+    // empty unless phantom has FINEBOX
+    public: const DoseGrid& fine_grid() const
+    {
+        return _fine_grid;
+    }
+
+    public: const std::vector<DoseGrid>& shot_grids() const
+    {
+        return _shot_grids;
+    }
+
+    public: const DoseMatrix& dij() const
+    {
+        return _dij;
+    }
+
+    public: bool list_mode() const
+    {
+        return _list_mode.is_open();
+    }
+
+    public: bool capture() const
+    {
+        return _phase_space.is_open();
+    }
+
+    // DoseDeposit hits map key of the voxel is its linear index plus this offset
+    public: int key_offset() const
+    {
+        return _key_offset;
+    }
+
     void ConstructMFD(const std::vector<std::string>&);
 
     virtual void Merge(const G4Run*) override;
 #pragma endregion
+
+    private: void init_grid();
+    private: void end_history();
+    private: void add_history();
+    private: void add_empty_histories(int64_t n);
+    private: void score_event(const G4THitsMap<double>& evtMap);
+    private: void publish_checkpoint();
+    private: void publish_monitor();
+
+    private: static int current_event_id();
 };
 
 //==========================================================================
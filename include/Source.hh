@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <fstream>
 #include <string>
 #include <cmath>
 #include <utility>
@@ -9,11 +11,15 @@
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4SystemOfUnits.hh"
 
+#include "Spectrum.hh"
+#include "PhaseSpaceStream.hh"
+
 class G4ParticleGun;
 class G4Event;
 class G4ParticleDefinition;
 
 class SourceMessenger;
+class PhaseSpace;
 
 class Source : public G4VUserPrimaryGeneratorAction
 {
@@ -22,6 +28,29 @@ class Source : public G4VUserPrimaryGeneratorAction
     public: using angles  = std::pair<float, float>; // source position as pait of <latitude, longitude>
     public: using sincos  = std::pair<float, float>; // same sources, but position converted to trigs of angles
     public: using sncsphi = std::pair<sincos,float>; // all data for fast position description
+
+    // uniforms of one assembly sample, pseudo-random or quasi-random point
+    public: enum { u_rotation, u_polar, u_phi, u_energy, nof_uniforms };
+    public: using uniforms = std::array<double, nof_uniforms>;
+
+    // sampled source particle: weight, energy, position, direction and type
+    public: struct particle
+    {
+        double w, e;
+        double x, y, z;
+        double wx, wy, wz;
+        G4ParticleDefinition* def;
+    };
+
+    // single isocentre of the plan: shift, assembly rotation range and
+    // collimator sampling cosines, sampled in proportion to its weight
+    public: struct shot
+    {
+        float  shift_x, shift_y, shift_z;
+        float  rot_start, rot_stop;
+        float  polar_start, polar_stop;
+        double weight;
+    };
 #pragma endregion
 
 #pragma region Data
@@ -47,9 +76,60 @@ class Source : public G4VUserPrimaryGeneratorAction
     private: float               _shift_y;
     private: float               _shift_z;
 
+    // number of independent assembly samples packed into one event
+    private: int                 _histories_per_event;
+
+    // source histories the current event stands for, histories_per_event
+    // plus replayed histories which never reached the phantom
+    private: int64_t             _event_histories;
+
+    // directional biasing: radius of the sphere around the isocentre, mm,
+    // 0 means no biasing, and fraction of photons aimed at it
+    private: float               _bias_radius;
+    private: double              _bias_fraction;
+
     // processed source info
     private: std::vector<sncsphi>  _srcs;
 
+    // energy spectrum of the assembly, empty means two Co60 lines,
+    // and spectra of single sources, -1 means source uses the assembly one
+    private: Spectrum              _spectrum;
+    private: std::vector<Spectrum> _spectra;
+    private: std::vector<int>      _src_spectrum;
+
+    // plan shots and their cumulative weights, empty means single shot of the settings above
+    private: std::vector<shot>     _shots;
+    private: std::vector<double>   _shot_cdf;
+    private: bool                  _shot_dose; // score dose of every shot separately
+
+    // shot sampled for every history of the current event
+    private: std::vector<int>      _event_shots;
+
+    // per event buffer of sampled particles, one per source
+    private: std::vector<particle> _particles;
+
+    // weights of the event primaries, in generation order
+    private: std::vector<double>   _weights;
+
+    // phase-space replay: file of the worker, opened once per run, records of
+    // the history being generated, and history and source of every primary
+    private: std::ifstream                         _replay_is;
+    private: int                                   _replay_run;
+    private: std::vector<PhaseSpaceStream::record> _replay_records;
+    private: std::vector<int>                      _primary_history;
+    private: std::vector<int>                      _primary_source;
+
+    // collimator phase space of one channel, see set_collimator_phsp: file of
+    // the worker, its sizes, the block of records read last and the channel
+    // particles of the histories of the current event
+    private: std::string                           _col_fname;
+    private: std::ifstream                         _col_is;
+    private: int64_t                               _col_nof_records;
+    private: int64_t                               _col_nof_histories;
+    private: std::vector<PhaseSpaceStream::record> _col_block;
+    private: int64_t                               _col_block_first;
+    private: std::vector<particle>                 _col_channels;
+
     private: G4ParticleDefinition* _gamma;
     private: G4ParticleDefinition* _electron;
     private: G4ParticleDefinition* _positron;
@@ -118,15 +198,85 @@ class Source : public G4VUserPrimaryGeneratorAction
         return _shift_z;
     }
 
+    public: int histories_per_event() const
+    {
+        return _histories_per_event;
+    }
+
+    public: int64_t event_histories() const
+    {
+        return _event_histories;
+    }
+
+    public: float bias_radius() const
+    {
+        return _bias_radius;
+    }
+
+    public: double bias_fraction() const
+    {
+        return _bias_fraction;
+    }
+
+    // history the primary belongs to, primaries get track IDs in generation order
+    public: int history_of_primary(int track_id) const
+    {
+        if (!_primary_history.empty())
+            return (track_id > 0 && track_id <= int(_primary_history.size())) ? _primary_history[track_id - 1] : 0;
+        return _srcs.empty() ? 0 : (track_id - 1) / int(_srcs.size());
+    }
+
+    // source the primary comes from, the same generation order
+    public: int source_of_primary(int track_id) const
+    {
+        if (!_primary_source.empty())
+            return (track_id > 0 && track_id <= int(_primary_source.size())) ? _primary_source[track_id - 1] : 0;
+        return _srcs.empty() ? 0 : (track_id - 1) % int(_srcs.size());
+    }
+
+    // 1 if no plan is loaded
+    public: int nof_shots() const
+    {
+        return _shots.empty() ? 1 : int(_shots.size());
+    }
+
+    public: bool shot_dose() const
+    {
+        return _shot_dose;
+    }
+
+    // shot of the history of the current event
+    public: int shot_of_history(int history) const
+    {
+        return (history >= 0 && history < int(_event_shots.size())) ? _event_shots[history] : 0;
+    }
+
+    // shot made of single source settings, used when no plan is loaded
+    public: shot current_shot() const
+    {
+        return shot{_shift_x, _shift_y, _shift_z, _rot_start, _rot_stop, _polar_start, _polar_stop, 1.0};
+    }
+
     public: std::vector<sncsphi> sources() const
     {
         return _srcs;
     }
+
+    // records of the collimator phase space, 0 if none is loaded
+    public: int64_t col_nof_records() const
+    {
+        return _col_nof_records;
+    }
 #pragma endregion
 
 #pragma region Mutators
     public: void GeneratePrimaries(G4Event* anEvent) override;
 
+    // sample one photon and put it through all sources of the rotated assembly
+    public: void sample_assembly(std::vector<particle>& particles) const;
+    public: void sample_assembly(const shot& s, std::vector<particle>& particles) const;
+    public: void sample_assembly(const shot& s, const uniforms& u, std::vector<particle>& particles) const;
+
     public: void set_iso_radius(float radius)
     {
         _iso_radius = radius;
@@ -159,8 +309,62 @@ class Source : public G4VUserPrimaryGeneratorAction
         _shift_z = shift;
     }
 
+    public: void set_histories_per_event(int n)
+    {
+        _histories_per_event = n;
+    }
+
+    public: void set_bias_radius(float radius)
+    {
+        _bias_radius = radius;
+    }
+
+    public: void set_bias_fraction(double fraction)
+    {
+        _bias_fraction = fraction;
+    }
+
+    // sources file, one source per line: latitude longitude (degree)
+    // and optional spectrum file of the source
     public: void set_sources(const std::string& fname);
 
+    // spectrum of all sources without their own one, see Spectrum::load
+    public: void set_spectrum(const std::string& fname);
+
+    // plan file, one shot per line: shift x y z (mm), weight,
+    // rotation start and stop (degree), collimator angle (degree)
+    public: void set_plan(const std::string& fname);
+
+    public: void set_shot_dose(bool on)
+    {
+        _shot_dose = on;
+    }
+
+    // phase space written at the exit of the collimator channel, see
+    // Detector::make_collimator; every history takes one record and puts it
+    // through all sources of the rotated assembly instead of a sampled photon,
+    // "none" goes back to sampling
+    public: void set_collimator_phsp(const std::string& fname);
+
     private: void set_sources(const std::vector<angles>& srcs);
+
+    // spectrum index for every source, loading every distinct file once
+    private: void set_spectra(const std::vector<std::string>& fnames);
+
+    // primaries of the event from the phase-space file
+    private: void replay(G4Event* anEvent, const PhaseSpace& phase_space);
+
+    // collimator stage: one photon per history into the channel on -X axis
+    private: void generate_channel(G4Event* anEvent);
+
+    // particle of the channel frame through all sources of the rotated assembly,
+    // sources with own spectrum resample its energy if source_spectra is on
+    private: void place_assembly(const shot& s, const particle& channel, const uniforms& u, bool source_spectra, std::vector<particle>& particles) const;
+
+    // record of the collimator phase space for the history, false if it cannot be read
+    private: bool collimator_particle(int64_t history, particle& p);
+
+    // particle gun makes unit weight vertices, weights are set afterwards
+    private: void set_weights(G4Event* anEvent) const;
 #pragma endregion
 };
@@ -9,6 +9,8 @@ class Source;
 class G4UImessenger;
 class G4UIcmdWithAnInteger;
 class G4UIcmdWithAString;
+class G4UIcmdWithABool;
+class G4UIcmdWithADouble;
 class G4UIcmdWithADoubleAndUnit;
 
 class SourceMessenger : public G4UImessenger
@@ -30,6 +32,17 @@ class SourceMessenger : public G4UImessenger
 	private: G4UIcmdWithADoubleAndUnit* _shift_z_cmd;
 
 	private: G4UIcmdWithAString*        _src_fname_cmd;
+	private: G4UIcmdWithAString*        _spectrum_cmd;
+
+	private: G4UIcmdWithAnInteger*      _histories_cmd;
+
+	private: G4UIcmdWithAString*        _plan_fname_cmd;
+	private: G4UIcmdWithABool*          _shot_dose_cmd;
+
+	private: G4UIcmdWithADoubleAndUnit* _bias_radius_cmd;
+	private: G4UIcmdWithADouble*        _bias_fraction_cmd;
+
+	private: G4UIcmdWithAString*        _col_phsp_cmd;
 #pragma endregion
 
 #pragma region Ctor/Dtor/ops
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "globals.hh"
+
+//---------------------------------------------------------------------
+/// Spectrum class
+///
+/// Tabulated photon energy spectrum, mix of monoenergetic lines and
+/// flat bins, sampled by Walker alias method in constant time however
+/// many bins it has. Alias table is built once, when spectrum is set.
+/// One uniform picks the bin and position inside it, so spectrum works
+/// with stratified and quasi-random energy uniforms as well.
+//---------------------------------------------------------------------
+
+class Spectrum
+{
+#pragma region Typedefs
+    // energy range and relative weight, line has e_lo == e_hi
+    public: struct bin
+    {
+        double e_lo, e_hi;
+        double weight;
+    };
+
+    // probability to keep the column and the bin to go to otherwise
+    private: struct cell
+    {
+        double prob;
+        int    alias;
+    };
+#pragma endregion
+
+#pragma region Data
+    private: std::vector<bin>  _bins;
+    private: std::vector<cell> _cells;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Spectrum()                              = default;
+    public: Spectrum(const Spectrum&)               = default;
+    public: Spectrum(Spectrum&&)                    = default;
+
+    public: Spectrum& operator=(const Spectrum&)    = default;
+    public: Spectrum& operator=(Spectrum&&)         = default;
+
+    public: ~Spectrum()                             = default;
+#pragma endregion
+
+#pragma region Observers
+    public: bool empty() const
+    {
+        return _bins.empty();
+    }
+
+    public: int nof_bins() const
+    {
+        return int(_bins.size());
+    }
+
+    public: double mean_energy() const;
+
+    // energy for uniform u in [0,1)
+    public: double sample(double u) const
+    {
+        double x = u * double(_cells.size());
+        int    i = std::min(int(x), int(_cells.size()) - 1);
+        double f = x - double(i);
+
+        const cell& c = _cells[i];
+
+        int    k;
+        double t;
+        if (f < c.prob)
+        {
+            k = i;
+            t = f / c.prob;
+        }
+        else
+        {
+            k = c.alias;
+            t = (f - c.prob) / (1.0 - c.prob);
+        }
+
+        const bin& b = _bins[k];
+        return b.e_lo + (b.e_hi - b.e_lo) * t;
+    }
+#pragma endregion
+
+#pragma region Mutators
+    // builds alias table, false and spectrum unchanged if bins make no spectrum
+    public: bool set_bins(const std::vector<bin>& bins);
+
+    // spectrum file, one line or bin per line, energies in MeV:
+    //   energy weight
+    //   energy_low energy_high weight
+    public: bool load(const std::string& fname);
+#pragma endregion
+};
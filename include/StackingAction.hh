@@ -0,0 +1,35 @@
+#pragma once
+
+#include "G4UserStackingAction.hh"
+#include "globals.hh"
+
+class G4Track;
+class Source;
+class VarianceReduction;
+
+//---------------------------------------------------------------------
+/// Stacking action
+///
+/// With variance reduction on, secondaries born outside of the sphere
+/// of interest play Russian roulette, survivors carry 1/p weight.
+/// Photon copies made by splitting and forced interaction are not
+/// secondaries of a process and are never rouletted. Everything else is
+/// stacked as usual
+//---------------------------------------------------------------------
+
+class StackingAction : public G4UserStackingAction
+{
+#pragma region Data
+    private: const Source*            _source;
+    private: const VarianceReduction* _vr;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public:          StackingAction(const Source* source);
+    public: virtual ~StackingAction();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track* aTrack) override;
+#pragma endregion
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include "G4UserSteppingAction.hh"
+#include "globals.hh"
+
+class G4Step;
+class G4Track;
+class G4ParticleDefinition;
+class Source;
+class VarianceReduction;
+class Detector;
+class DoseScorer;
+
+//---------------------------------------------------------------------
+/// Stepping action
+///
+/// Counts steps for the profiler, and with variance reduction on,
+/// splits photons entering the sphere of interest and plays Russian
+/// roulette with photons leaving it, see VarianceReduction.
+/// With range rejection on, electron whose range is shorter than the
+/// distance to the nearest face of its voxel deposits its energy there.
+/// In phase-space capture mode, particles entering the phantom container
+/// are handed to the run and killed. With forced interaction on, photons
+/// entering it make a collided and an uncollided copy, see ForcedCollision
+//---------------------------------------------------------------------
+
+class SteppingAction : public G4UserSteppingAction
+{
+#pragma region Data
+    private: const Source*               _source;
+    private: const VarianceReduction*    _vr;
+    private: const G4ParticleDefinition* _gamma;
+    private: const G4ParticleDefinition* _electron;
+    private: const G4ParticleDefinition* _positron;
+
+    // scorer of this thread, found on the first rejected electron
+    private: const Detector*             _detector;
+    private: DoseScorer*                 _scorer;
+
+    // forced interaction: attenuation of the phantom materials on the log
+    // energy grid, built on the first forced photon, and at its energy
+    private: std::vector<std::vector<double>> _mu_table;
+    private: std::vector<double>              _mu;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public:          SteppingAction(const Source* source);
+    public: virtual ~SteppingAction();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void UserSteppingAction(const G4Step* aStep) override;
+#pragma endregion
+
+    private: void split(G4Track* track, int n);
+
+    private: void reject_range(const G4Step* aStep);
+
+    // true if the step crosses from the world into the phantom container
+    private: bool entering_container(const G4Step* aStep) const;
+
+    private: void force_interaction(const G4Step* aStep);
+
+    private: double attenuation(size_t material, double e) const;
+
+    // true if the particle entered the phantom and is captured
+    private: bool capture(const G4Step* aStep);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "globals.hh"
+
+class G4UImanager;
+
+//---------------------------------------------------------------------
+/// Sweep class
+///
+/// Runs a table of parameter points back to back in one process, so
+/// geometry, physics tables and worker threads are set up only once.
+/// Spec file header names the columns, every other line is a point:
+///
+///   # comment
+///   events  src_angle:degree  iso_radius:mm  shift_x:mm
+///   100000  2.0               380.0          0.0
+///
+/// Column is /GP/source/<name> command, or full command if it starts
+/// with '/', optional unit follows the colon. "events" column is the
+/// number of events of the point. Result files of the point are renamed
+/// to sweep_<point>_<file>, summary goes to sweep.out.
+//---------------------------------------------------------------------
+
+class Sweep
+{
+#pragma region Data
+    private: std::vector<std::string>              _commands; // per column, empty for events column
+    private: std::vector<std::string>              _units;
+    private: int                                   _events_column;
+
+    private: std::vector<std::vector<std::string>> _points;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: Sweep(const std::string& fname);
+    public: ~Sweep()
+    {
+    }
+#pragma endregion
+
+#pragma region Observers
+    public: size_t nof_points() const
+    {
+        return _points.size();
+    }
+#pragma endregion
+
+    public: void run(G4UImanager* UImanager) const;
+};
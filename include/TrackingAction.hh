@@ -0,0 +1,33 @@
+#pragma once
+
+#include "G4UserTrackingAction.hh"
+#include "globals.hh"
+
+class G4Track;
+class Source;
+
+//---------------------------------------------------------------------
+/// Tracking action
+///
+/// Tells the run which history and source is being tracked, so dose of
+/// the event with several source histories is scored history by history,
+/// and dose influence matrix gets dose of every source in its own row.
+/// Secondaries are stacked on top of their parent primary, so all of
+/// them are tracked before the primaries of the next history start.
+//---------------------------------------------------------------------
+
+class TrackingAction : public G4UserTrackingAction
+{
+#pragma region Data
+    private: const Source* _source;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public:          TrackingAction(const Source* source);
+    public: virtual ~TrackingAction();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void PreUserTrackingAction(const G4Track* aTrack) override;
+#pragma endregion
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+
+class VarianceReductionMessenger;
+class Source;
+
+//---------------------------------------------------------------------
+/// VarianceReduction class
+///
+/// Settings of weight based variance reduction around the focus.
+/// Region of interest is a sphere, photons entering it are split into
+/// N copies of 1/N weight, photons leaving it play Russian roulette
+/// with 1/N survival, so weight inside is N times lower than outside.
+/// Secondaries born outside of the sphere play Russian roulette with
+/// their own survival probability. Scored dose is weighted, so the
+/// mean dose is unchanged and its variance in the sphere goes down.
+/// Forced interaction makes every photon entering the phantom collide
+/// in it, with its weight times the probability to do so, and passes an
+/// uncollided copy with the rest, see SteppingAction.
+//---------------------------------------------------------------------
+
+class VarianceReduction
+{
+#pragma region Singleton
+    private: static VarianceReduction* _instance;
+#pragma endregion
+
+#pragma region Data
+    private: VarianceReductionMessenger* _messenger;
+
+    // sphere of interest, NaN centre follows the source isocentre
+    private: double                      _roi_radius;
+    private: G4ThreeVector               _roi_centre;
+
+    private: int                         _split;    // photon copies on entering the sphere
+    private: double                      _survival; // roulette survival of secondaries outside
+
+    private: bool                        _force;    // forced first collision in the phantom
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: VarianceReduction();
+    public: VarianceReduction(const VarianceReduction&)            = delete;
+    public: VarianceReduction& operator=(const VarianceReduction&) = delete;
+    public: ~VarianceReduction();
+#pragma endregion
+
+#pragma region Singleton
+    public: static VarianceReduction* Instance();
+#pragma endregion
+
+#pragma region Observers
+    public: bool enabled() const
+    {
+        return _roi_radius > 0.0 && (_split > 1 || _survival < 1.0);
+    }
+
+    public: double roi_radius() const
+    {
+        return _roi_radius;
+    }
+
+    public: bool has_roi_centre() const
+    {
+        return !std::isnan(_roi_centre.x());
+    }
+
+    public: const G4ThreeVector& roi_centre() const
+    {
+        return _roi_centre;
+    }
+
+    public: int split() const
+    {
+        return _split;
+    }
+
+    public: double survival() const
+    {
+        return _survival;
+    }
+
+    // independent of the sphere settings
+    public: bool forced() const
+    {
+        return _force;
+    }
+
+    // worker: centre of the sphere, isocentre of its source unless set
+    public: G4ThreeVector centre(const Source* source) const;
+
+    public: bool inside(const G4ThreeVector& centre, const G4ThreeVector& p) const
+    {
+        return (p - centre).mag2() < _roi_radius*_roi_radius;
+    }
+#pragma endregion
+
+#pragma region Mutators
+    public: void set_roi_radius(double radius)
+    {
+        _roi_radius = radius;
+    }
+
+    public: void set_roi_centre(const G4ThreeVector& centre)
+    {
+        _roi_centre = centre;
+    }
+
+    public: void set_split(int split)
+    {
+        _split = split;
+    }
+
+    public: void set_survival(double survival)
+    {
+        _survival = survival;
+    }
+
+    public: void set_force(bool force)
+    {
+        _force = force;
+    }
+#pragma endregion
+};
@@ -0,0 +1,37 @@
+// -*- C++ -*-
+
+#pragma once
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class VarianceReduction;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithABool;
+class G4UIcmdWithADouble;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWith3VectorAndUnit;
+
+class VarianceReductionMessenger : public G4UImessenger
+{
+#pragma region Data
+    private: VarianceReduction*         _vr;
+
+    private: G4UIdirectory*             _vr_directory;
+
+    private: G4UIcmdWithADoubleAndUnit* _roi_radius_cmd;
+    private: G4UIcmdWith3VectorAndUnit* _roi_centre_cmd;
+    private: G4UIcmdWithAnInteger*      _split_cmd;
+    private: G4UIcmdWithADouble*        _survival_cmd;
+    private: G4UIcmdWithABool*          _force_cmd;
+#pragma endregion
+
+#pragma region Ctor/Dtor/ops
+    public: VarianceReductionMessenger(VarianceReduction* vr);
+    public: ~VarianceReductionMessenger();
+#pragma endregion
+
+#pragma region Interfaces
+    public: virtual void SetNewValue(G4UIcommand* cmd, G4String value) override;
+#pragma endregion
+};
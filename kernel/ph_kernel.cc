@@ -0,0 +1,474 @@
+// Dose kernel superposition for multi-shot plans in homogeneous phantom
+//
+// Usage: ph_kernel plan.in kernels.txt nof_histories [phantom.hed] [output] [method] [nof_threads]
+//
+//  plan.in       - plan in /GP/source/plan_fname format
+//  kernels.txt   - one kernel per collimator angle, lines of
+//                  <src_angle, degree> <dose.out of the centred shot> <its number of histories>
+//  nof_histories - number of plan histories to produce dose for
+//  phantom.hed   - phantom header, the grid of kernels and output
+//  output        - dose.out format output, "dose_kernel.out" by default
+//  method        - direct, fft or auto (default), the result is the same
+//  nof_threads   - hardware concurrency by default
+//
+// In the homogeneous phantom dose of the shifted shot is the dose of the
+// centred shot with the same collimator angle translated by the shift.
+// Kernels are made once by Monte Carlo with high statistics, see kernel.mac,
+// then any plan is a weighted sum of translated kernels. Sub-voxel shift is
+// trilinear interpolation, which is the kernel convolved with eight point
+// weights around the shift. So for many shots all of them are put on one
+// small grid of point weights per kernel and convolved with the kernel by FFT.
+// Output is for nof_histories histories with shots sampled in proportion
+// to their weights, directly comparable to dose.out of the plan run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "G4SystemOfUnits.hh"
+
+#include "PhantomSetup.hh"
+
+using kclock  = std::chrono::steady_clock;
+using complex = std::complex<float>;
+
+struct shot
+{
+    double shift_x, shift_y, shift_z; // voxels
+    double weight;
+    double src_angle;                 // degree
+};
+
+struct kernel
+{
+    double              src_angle;
+    std::vector<double> dose;         // Gy per history
+    std::vector<shot>   shots;
+};
+
+static int nof_threads = 1;
+
+// split [0, n) between threads
+template <typename F> static void parallel_for(int n, F&& f)
+{
+    int nt = std::max(1, std::min(nof_threads, n));
+
+    std::vector<std::thread> threads;
+    for(int t = 1; t < nt; ++t)
+        threads.emplace_back([&f, n, nt, t]() { for(int k = n*t/nt; k != n*(t + 1)/nt; ++k) f(k); });
+    for(int k = 0; k != n/nt; ++k)
+        f(k);
+    for(auto& th: threads)
+        th.join();
+}
+
+static std::vector<shot> read_plan(const std::string& fname, const PhantomSetup& phs)
+{
+    std::ifstream is(fname);
+    if (!is)
+        throw std::runtime_error("Cannot open plan file: " + fname);
+
+    std::vector<shot> shots;
+    std::string       line;
+    while (std::getline(is, line))
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream ls(line);
+
+        double x, y, z, weight, rstart, rstop, angle;
+        ls >> x >> y >> z >> weight >> rstart >> rstop >> angle;
+        if (ls.fail() || weight < 0.0)
+            throw std::runtime_error("Bad plan line: " + line);
+
+        // rotation range is not used, kernels are for the full rotation of the centred shot
+        shots.push_back(shot{x*mm / phs.voxel_x(), y*mm / phs.voxel_y(), z*mm / phs.voxel_z(), weight, angle});
+    }
+    if (shots.empty())
+        throw std::runtime_error("No shots in " + fname);
+
+    return shots;
+}
+
+// dose.out of the kernel run, per history
+static std::vector<double> read_dose_out(const std::string& fname, const PhantomSetup& phs, double nof_histories)
+{
+    std::ifstream is(fname);
+    if (!is)
+        throw std::runtime_error("Cannot open kernel dose file: " + fname);
+
+    // dose.out keys are voxel index plus nofv_z, see Run::key_offset()
+    std::vector<double> dose(phs.nof_voxels(), 0.0);
+
+    int    key;
+    double d;
+    while (is >> key >> d)
+    {
+        int idx = key - phs.nofv_z();
+        if (idx >= 0 && idx < phs.nof_voxels())
+            dose[idx] = d / nof_histories;
+    }
+    return dose;
+}
+
+static std::vector<kernel> read_kernels(const std::string& fname, const PhantomSetup& phs)
+{
+    std::ifstream is(fname);
+    if (!is)
+        throw std::runtime_error("Cannot open kernels file: " + fname);
+
+    std::vector<kernel> kernels;
+    std::string         line;
+    while (std::getline(is, line))
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream ls(line);
+
+        double      angle, nof_histories;
+        std::string dose_name;
+        ls >> angle >> dose_name >> nof_histories;
+        if (ls.fail() || nof_histories <= 0.0)
+            throw std::runtime_error("Bad kernel line: " + line);
+
+        kernels.push_back(kernel{angle, read_dose_out(dose_name, phs, nof_histories), {}});
+    }
+    return kernels;
+}
+
+// shot dose added directly, trilinear interpolation of the translated kernel
+static void superpose_direct(const PhantomSetup& phs, const kernel& k, double scale, std::vector<double>& out)
+{
+    const int nx = phs.nofv_x();
+    const int ny = phs.nofv_y();
+    const int nz = phs.nofv_z();
+
+    for(const auto& s: k.shots)
+    {
+        int    fx = int(std::floor(s.shift_x));
+        int    fy = int(std::floor(s.shift_y));
+        int    fz = int(std::floor(s.shift_z));
+        double ax = s.shift_x - fx;
+        double ay = s.shift_y - fy;
+        double az = s.shift_z - fz;
+
+        double w = scale * s.weight;
+
+        // out(i) += w * sum over corners of K(i - f - c) * corner weight
+        parallel_for(nz, [&](int iz)
+        {
+            for(int cz = 0; cz != 2; ++cz)
+            {
+                int jz = iz - fz - cz;
+                if (jz < 0 || jz >= nz)
+                    continue;
+                double wz = w * (cz ? az : 1.0 - az);
+
+                for(int iy = 0; iy != ny; ++iy)
+                {
+                    for(int cy = 0; cy != 2; ++cy)
+                    {
+                        int jy = iy - fy - cy;
+                        if (jy < 0 || jy >= ny)
+                            continue;
+                        double wzy = wz * (cy ? ay : 1.0 - ay);
+
+                        double*       o  = out.data()    + phs.idx(0, iy, iz);
+                        const double* kk = k.dose.data() + phs.idx(0, jy, jz);
+
+                        int x0 = std::max(0, fx);
+                        int x1 = std::min(nx, nx + fx + 1);
+                        double w0 = wzy * (1.0 - ax);
+                        double w1 = wzy * ax;
+                        for(int ix = x0; ix < x1; ++ix)
+                        {
+                            int jx = ix - fx;
+                            if (jx < nx)
+                                o[ix] += w0 * kk[jx];
+                            if (jx >= 1)
+                                o[ix] += w1 * kk[jx - 1];
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+static int pow2_ceil(int n)
+{
+    int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+// in place radix-2 FFT of n complex values with stride
+static void fft(complex* a, int n, int stride, bool inverse, std::vector<complex>& line)
+{
+    line.resize(n);
+    for(int k = 0; k != n; ++k)
+        line[k] = a[size_t(k) * stride];
+
+    // bit reversal
+    for(int i = 1, j = 0; i < n; ++i)
+    {
+        int bit = n >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(line[i], line[j]);
+    }
+
+    for(int len = 2; len <= n; len <<= 1)
+    {
+        double  ang = 2.0 * M_PI / len * (inverse ? 1.0 : -1.0);
+        complex wl(float(std::cos(ang)), float(std::sin(ang)));
+        for(int i = 0; i < n; i += len)
+        {
+            complex w(1.0f, 0.0f);
+            for(int j = 0; j != len/2; ++j)
+            {
+                complex u = line[i + j];
+                complex v = line[i + j + len/2] * w;
+                line[i + j]         = u + v;
+                line[i + j + len/2] = u - v;
+                w *= wl;
+            }
+        }
+    }
+
+    for(int k = 0; k != n; ++k)
+        a[size_t(k) * stride] = line[k];
+}
+
+static void fft3(std::vector<complex>& a, int px, int py, int pz, bool inverse)
+{
+    // x lines
+    parallel_for(pz, [&](int z)
+    {
+        std::vector<complex> line;
+        for(int y = 0; y != py; ++y)
+            fft(a.data() + (size_t(z)*py + y)*px, px, 1, inverse, line);
+    });
+    // y lines
+    parallel_for(pz, [&](int z)
+    {
+        std::vector<complex> line;
+        for(int x = 0; x != px; ++x)
+            fft(a.data() + size_t(z)*py*px + x, py, px, inverse, line);
+    });
+    // z lines
+    parallel_for(py, [&](int y)
+    {
+        std::vector<complex> line;
+        for(int x = 0; x != px; ++x)
+            fft(a.data() + size_t(y)*px + x, pz, px*py, inverse, line);
+    });
+}
+
+// integer extent of shift point weights, and linear convolution size padded to power of two
+struct fft_grid
+{
+    int tx0, ty0, tz0;
+    int px, py, pz;
+
+    fft_grid(const PhantomSetup& phs, const kernel& k)
+    {
+        tx0 = ty0 = tz0 = 1 << 30;
+        int tx1 = -tx0, ty1 = -ty0, tz1 = -tz0;
+        for(const auto& s: k.shots)
+        {
+            tx0 = std::min(tx0, int(std::floor(s.shift_x)));
+            ty0 = std::min(ty0, int(std::floor(s.shift_y)));
+            tz0 = std::min(tz0, int(std::floor(s.shift_z)));
+            tx1 = std::max(tx1, int(std::floor(s.shift_x)) + 1);
+            ty1 = std::max(ty1, int(std::floor(s.shift_y)) + 1);
+            tz1 = std::max(tz1, int(std::floor(s.shift_z)) + 1);
+        }
+
+        px = pow2_ceil(phs.nofv_x() + tx1 - tx0);
+        py = pow2_ceil(phs.nofv_y() + ty1 - ty0);
+        pz = pow2_ceil(phs.nofv_z() + tz1 - tz0);
+    }
+
+    double size() const
+    {
+        return double(px) * double(py) * double(pz);
+    }
+};
+
+// all shots of the kernel as point weights on one grid, convolved with the kernel
+static void superpose_fft(const PhantomSetup& phs, const kernel& k, double scale, std::vector<double>& out)
+{
+    const int nx = phs.nofv_x();
+    const int ny = phs.nofv_y();
+    const int nz = phs.nofv_z();
+
+    const fft_grid g{phs, k};
+
+    const int tx0 = g.tx0, ty0 = g.ty0, tz0 = g.tz0;
+    const int px  = g.px,  py  = g.py,  pz  = g.pz;
+
+    auto at = [px, py](int x, int y, int z) { return (size_t(z)*py + y)*px + x; };
+
+    std::vector<complex> kf(size_t(px)*py*pz, complex(0.0f, 0.0f));
+    std::vector<complex> df(size_t(px)*py*pz, complex(0.0f, 0.0f));
+
+    for(int iz = 0; iz != nz; ++iz)
+        for(int iy = 0; iy != ny; ++iy)
+            for(int ix = 0; ix != nx; ++ix)
+                kf[at(ix, iy, iz)] = complex(float(k.dose[phs.idx(ix, iy, iz)]), 0.0f);
+
+    for(const auto& s: k.shots)
+    {
+        int    fx = int(std::floor(s.shift_x));
+        int    fy = int(std::floor(s.shift_y));
+        int    fz = int(std::floor(s.shift_z));
+        double ax = s.shift_x - fx;
+        double ay = s.shift_y - fy;
+        double az = s.shift_z - fz;
+
+        for(int c = 0; c != 8; ++c)
+        {
+            int cx = c & 1, cy = (c >> 1) & 1, cz = (c >> 2) & 1;
+            double w = scale * s.weight * (cx ? ax : 1.0 - ax) * (cy ? ay : 1.0 - ay) * (cz ? az : 1.0 - az);
+            df[at(fx + cx - tx0, fy + cy - ty0, fz + cz - tz0)] += complex(float(w), 0.0f);
+        }
+    }
+
+    fft3(kf, px, py, pz, false);
+    fft3(df, px, py, pz, false);
+    for(size_t k = 0; k != kf.size(); ++k)
+        kf[k] *= df[k];
+    fft3(kf, px, py, pz, true);
+
+    // out(i) = conv(i - t0), FFT inverse is not normalized,
+    // round-off far from the shots is dropped, as direct sum gives exact zeros there
+    float norm = 1.0f / float(size_t(px)*py*pz);
+
+    float cut = 0.0f;
+    for(const auto& c: kf)
+        cut = std::max(cut, std::abs(c.real()));
+    cut *= 1.0e-6f;
+    for(int iz = 0; iz != nz; ++iz)
+    {
+        int cz = iz - tz0;
+        if (cz < 0 || cz >= pz)
+            continue;
+        for(int iy = 0; iy != ny; ++iy)
+        {
+            int cy = iy - ty0;
+            if (cy < 0 || cy >= py)
+                continue;
+            for(int ix = 0; ix != nx; ++ix)
+            {
+                int cx = ix - tx0;
+                if (cx < 0 || cx >= px)
+                    continue;
+                float c = kf[at(cx, cy, cz)].real();
+                if (std::abs(c) > cut)
+                    out[phs.idx(ix, iy, iz)] += double(c * norm);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::fprintf(stderr, "Usage: ph_kernel plan.in kernels.txt nof_histories [phantom.hed] [output] [method] [nof_threads]\n");
+        return 1;
+    }
+
+    double      nof_histories = std::stod(argv[3]);
+    std::string hed_name      = (argc > 4) ? argv[4] : "phantom.hed";
+    std::string out_name      = (argc > 5) ? argv[5] : "dose_kernel.out";
+    std::string method        = (argc > 6) ? argv[6] : "auto";
+    nof_threads               = (argc > 7) ? std::stoi(argv[7]) : int(std::max(1u, std::thread::hardware_concurrency()));
+
+    try
+    {
+        auto t0 = kclock::now();
+
+        PhantomSetup        phs{hed_name.c_str()};
+        std::vector<shot>   shots   = read_plan(argv[1], phs);
+        std::vector<kernel> kernels = read_kernels(argv[2], phs);
+
+        double total_weight = 0.0;
+        for(const auto& s: shots)
+        {
+            auto k = std::find_if(kernels.begin(), kernels.end(),
+                                  [&s](const kernel& kk) { return std::abs(kk.src_angle - s.src_angle) < 1.0e-3; });
+            if (k == kernels.end())
+                throw std::runtime_error("No kernel for collimator angle " + std::to_string(s.src_angle));
+
+            k->shots.push_back(s);
+            total_weight += s.weight;
+        }
+        if (total_weight <= 0.0)
+            throw std::runtime_error("Plan has zero total weight");
+
+        std::chrono::duration<double> load = kclock::now() - t0;
+        t0 = kclock::now();
+
+        // shot gets nof_histories * weight / total_weight histories on average
+        double scale = nof_histories / total_weight;
+
+        std::vector<double> out(phs.nof_voxels(), 0.0);
+        for(const auto& k: kernels)
+        {
+            if (k.shots.empty())
+                continue;
+
+            // direct sum is 8 passes over the grid per shot, FFT is 3 transforms of the padded grid
+            double n           = fft_grid{phs, k}.size();
+            double direct_cost = 8.0 * double(k.shots.size()) * phs.nof_voxels();
+            double fft_cost    = 3.0 * 5.0 * n * std::log2(n);
+
+            bool use_fft = (method == "fft") || (method == "auto" && fft_cost < direct_cost);
+            if (use_fft)
+                superpose_fft(phs, k, scale, out);
+            else
+                superpose_direct(phs, k, scale, out);
+
+            std::printf("kernel %g degree: %zu shots, %s\n", k.src_angle, k.shots.size(), use_fft ? "fft" : "direct");
+        }
+
+        std::chrono::duration<double> sup = kclock::now() - t0;
+
+        std::ofstream os(out_name);
+        for(int k = 0; k != phs.nof_voxels(); ++k)
+        {
+            if (out[k] != 0.0)
+                os << (k + phs.nofv_z()) << "     " << out[k] << std::endl;
+        }
+
+        std::printf("%zu shots, kernels loaded in %.3f s, superposed in %.3f ms, dose written to %s\n",
+                    shots.size(), load.count(), 1000.0 * sup.count(), out_name.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "ph_kernel: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
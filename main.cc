@@ -28,6 +28,18 @@
 #include "PhantomSetup.hh"
 #include "Detector.hh"
 #include "Initialization.hh"
+#include "Checkpoint.hh"
+#include "Monitor.hh"
+#include "Dij.hh"
+#include "ListMode.hh"
+#include "PhaseSpace.hh"
+#include "Sweep.hh"
+#include "PhysicsCache.hh"
+#include "ResultCache.hh"
+#include "VarianceReduction.hh"
+#include "QuasiRandom.hh"
+#include "Denoise.hh"
+#include "ForcedCollision.hh"
 
 int main(int argc, char* argv[])
 {
@@ -60,11 +72,42 @@ int main(int argc, char* argv[])
     auto* phs_vec = new std::vector<G4String>;
     phs_vec->push_back("G4EmStandardPhysics");
     G4VModularPhysicsList* phys = new G4GenericPhysicsList(phs_vec);
+    phys->RegisterPhysics(new ForcedCollisionPhysics); // idle unless /GP/vr/force is on
     runManager->SetUserInitialization(phys);
 
     // User action initialization
     runManager->SetUserInitialization(new Initialization());
 
+    // Checkpoint and resume control, shared by master and workers
+    Checkpoint* checkpoint = new Checkpoint;
+
+    // Live progress telemetry, monitor thread runs on master
+    Monitor* monitor = new Monitor;
+
+    // Per-source dose influence matrix scoring settings
+    Dij* dij = new Dij;
+
+    // List-mode energy deposition output for offline rebinning, see ph_rebin
+    ListMode* list_mode = new ListMode;
+
+    // Phase-space capture and replay at the phantom surface, off by default
+    PhaseSpace* phase_space = new PhaseSpace;
+
+    // Built physics tables cache, /GP/physics/cache_dir turns it on
+    PhysicsCache* physics_cache = new PhysicsCache{phys, "G4EmStandardPhysics"};
+
+    // Run results cache, /GP/cache/beamOn looks the result up before simulating
+    ResultCache* result_cache = new ResultCache;
+
+    // Photon splitting and Russian roulette around the focus, off by default
+    VarianceReduction* vr = new VarianceReduction;
+
+    // Digitally shifted Sobol sampling of the source assembly, off by default
+    QuasiRandom* qmc = new QuasiRandom;
+
+    // Denoised dose next to the raw one at the end of run, off by default
+    Denoise* denoise = new Denoise;
+
     runManager->Initialize();
 
 #ifdef G4VIS_USE
@@ -87,13 +130,34 @@ int main(int argc, char* argv[])
         delete ui;
 #endif
     }
+    else if (argc == 2)
+    {
+        std::string command   = "/control/execute ";
+        std::string file_name = argv[1];
+        UImanager->ApplyCommand(command + file_name);
+    }
     else
     {
+        // sweep mode: setup macro once, then all points of the spec in this process
+        Sweep sweep{argv[2]};
+
         std::string command   = "/control/execute ";
         std::string file_name = argv[1];
         UImanager->ApplyCommand(command + file_name);
+
+        sweep.run(UImanager);
     }
 
+    delete denoise;
+    delete qmc;
+    delete vr;
+    delete result_cache;
+    delete physics_cache;
+    delete phase_space;
+    delete list_mode;
+    delete dij;
+    delete monitor;
+    delete checkpoint;
     delete runManager;
 
 #ifdef G4VIS_USE
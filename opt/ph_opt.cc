@@ -0,0 +1,564 @@
+// Source weight optimizer over per-source dose influence matrix
+//
+// Usage: ph_opt dij.bin objectives.txt [phantom.hed] [nof_threads] [max_iterations]
+//
+//  dij.bin        - matrix written with /GP/dij/enable, see DoseMatrix.hh
+//  objectives.txt - ROI dose objectives, one per line
+//  phantom.hed    - phantom header, grid must match the matrix
+//  nof_threads    - number of threads, hardware concurrency by default
+//  max_iterations - 500 by default
+//
+// Objectives file lines, voxel indices are inclusive, lengths are in mm
+// relative to the phantom centre, doses are in Gy, "inf" means no limit:
+//
+//  <name> box    ix0 ix1 iy0 iy1 iz0 iz1 <min dose> <max dose> <importance>
+//  <name> sphere x y z r                 <min dose> <max dose> <importance>
+//  <name> mask   file.msk                <min dose> <max dose> <importance>
+//
+// Mask file is one byte per voxel in PhantomSetup::idx() order, nonzero inside.
+// Every ROI contributes importance/N * sum of squared under and over dosage
+// of its N voxels, non-negative source weights minimizing the sum are found
+// with projected gradient and Barzilai-Borwein steps.
+//
+// Only ROI voxels are kept, packed into blocks of voxels with all sources
+// of the block stored contiguously, so one pass over a block computes its
+// dose, residual and gradient contribution while the block is in cache.
+// Blocks are split between threads. Weights go to weights.out.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "G4SystemOfUnits.hh"
+
+#include "PhantomSetup.hh"
+
+using oclock = std::chrono::steady_clock;
+
+// voxels per block, block of all sources is 36 x 256 x 4 bytes for the reference assembly
+static const int BLK   = 256;
+static const int LANES = 8;
+
+struct dij
+{
+    int                  nof_srcs = 0;
+    int                  nofv_x   = 0;
+    int                  nofv_y   = 0;
+    int                  nofv_z   = 0;
+    int64_t              nof_histories = 0;
+    std::vector<int64_t> row_start;
+    std::vector<int32_t> voxel;
+    std::vector<float>   dose;
+
+    int nof_voxels() const
+    {
+        return nofv_x * nofv_y * nofv_z;
+    }
+};
+
+struct roi
+{
+    std::string      name;
+    double           lo;
+    double           hi;
+    double           importance;
+    std::vector<int> voxels;
+};
+
+// objective terms, one per ROI voxel, packed in blocks
+struct problem
+{
+    int                nof_srcs   = 0;
+    int                nof_terms  = 0;
+    int                nof_blocks = 0;
+
+    std::vector<float> a;   // [block][source][BLK] dose per unit weight
+    std::vector<float> lo;  // [term] lower dose limit
+    std::vector<float> hi;  // [term] upper dose limit
+    std::vector<float> c;   // [term] importance / ROI size, 0 for padding
+};
+
+static dij read_dij(const std::string& fname)
+{
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    if (!is)
+        throw std::runtime_error("Cannot open dose matrix file: " + fname);
+
+    char    magic[8];
+    int32_t dims[4];
+    int64_t nnz = 0;
+
+    dij m;
+    is.read(magic, sizeof(magic));
+    is.read(reinterpret_cast<char*>(dims), sizeof(dims));
+    is.read(reinterpret_cast<char*>(&m.nof_histories), sizeof(m.nof_histories));
+    is.read(reinterpret_cast<char*>(&nnz), sizeof(nnz));
+    if (!is || std::memcmp(magic, "PHDIJ001", sizeof(magic)) != 0)
+        throw std::runtime_error("Not a dose matrix file: " + fname);
+
+    m.nof_srcs = dims[0];
+    m.nofv_x   = dims[1];
+    m.nofv_y   = dims[2];
+    m.nofv_z   = dims[3];
+
+    m.row_start.resize(m.nof_srcs + 1);
+    m.voxel.resize(nnz);
+    m.dose.resize(nnz);
+
+    is.read(reinterpret_cast<char*>(m.row_start.data()), m.row_start.size() * sizeof(int64_t));
+    is.read(reinterpret_cast<char*>(m.voxel.data()),     m.voxel.size()     * sizeof(int32_t));
+    is.read(reinterpret_cast<char*>(m.dose.data()),      m.dose.size()      * sizeof(float));
+    if (!is)
+        throw std::runtime_error("Truncated dose matrix file: " + fname);
+
+    return m;
+}
+
+static std::vector<roi> read_objectives(const std::string& fname, const PhantomSetup& phs)
+{
+    std::ifstream is(fname);
+    if (!is)
+        throw std::runtime_error("Cannot open objectives file: " + fname);
+
+    std::vector<roi> rois;
+    std::string      line;
+    while (std::getline(is, line))
+    {
+        std::istringstream ls(line);
+
+        roi         r;
+        std::string shape;
+        if (!(ls >> r.name) || r.name[0] == '#')
+            continue;
+        ls >> shape;
+
+        if (shape == "box")
+        {
+            int ix0, ix1, iy0, iy1, iz0, iz1;
+            ls >> ix0 >> ix1 >> iy0 >> iy1 >> iz0 >> iz1;
+
+            for(int iz = std::max(iz0, 0); iz <= std::min(iz1, phs.nofv_z() - 1); ++iz)
+                for(int iy = std::max(iy0, 0); iy <= std::min(iy1, phs.nofv_y() - 1); ++iy)
+                    for(int ix = std::max(ix0, 0); ix <= std::min(ix1, phs.nofv_x() - 1); ++ix)
+                        r.voxels.push_back(phs.idx(ix, iy, iz));
+        }
+        else if (shape == "sphere")
+        {
+            double x, y, z, rr;
+            ls >> x >> y >> z >> rr;
+
+            // voxel centres, phantom is centered at the origin
+            for(int iz = 0; iz != phs.nofv_z(); ++iz)
+            {
+                double vz = (iz + 0.5)*phs.voxel_z() - 0.5*phs.cube_z() - z*mm;
+                for(int iy = 0; iy != phs.nofv_y(); ++iy)
+                {
+                    double vy = (iy + 0.5)*phs.voxel_y() - 0.5*phs.cube_y() - y*mm;
+                    for(int ix = 0; ix != phs.nofv_x(); ++ix)
+                    {
+                        double vx = (ix + 0.5)*phs.voxel_x() - 0.5*phs.cube_x() - x*mm;
+                        if (vx*vx + vy*vy + vz*vz <= rr*rr*mm*mm)
+                            r.voxels.push_back(phs.idx(ix, iy, iz));
+                    }
+                }
+            }
+        }
+        else if (shape == "mask")
+        {
+            std::string mname;
+            ls >> mname;
+
+            std::ifstream ms(mname, std::ios::in | std::ios::binary);
+            std::vector<char> mask(phs.nof_voxels(), 0);
+            ms.read(mask.data(), mask.size());
+            if (!ms)
+                throw std::runtime_error("Cannot read mask of " + r.name + " from " + mname);
+
+            for(int k = 0; k != phs.nof_voxels(); ++k)
+            {
+                if (mask[k] != 0)
+                    r.voxels.push_back(k);
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Unknown shape " + shape + " of " + r.name);
+        }
+
+        std::string lo, hi;
+        ls >> lo >> hi >> r.importance;
+        if (ls.fail())
+            throw std::runtime_error("Bad objective line: " + line);
+
+        // stod, unlike stream extraction, understands "inf"
+        r.lo = std::stod(lo);
+        r.hi = std::stod(hi);
+        if (r.lo > r.hi)
+            throw std::runtime_error("Min dose above max dose for " + r.name);
+
+        if (r.voxels.empty())
+        {
+            std::printf("ROI %s is empty, ignored\n", r.name.c_str());
+            continue;
+        }
+        rois.push_back(std::move(r));
+    }
+    return rois;
+}
+
+// terms of all ROIs, voxel in several ROIs gets a term in every one of them
+static problem build_problem(const dij& m, const std::vector<roi>& rois)
+{
+    problem p;
+    p.nof_srcs = m.nof_srcs;
+
+    // per voxel linked list of its terms
+    std::vector<int> head(m.nof_voxels(), -1);
+    std::vector<int> next;
+    for(const auto& r: rois)
+    {
+        float c = float(r.importance / double(r.voxels.size()));
+        for(int v: r.voxels)
+        {
+            next.push_back(head[v]);
+            head[v] = p.nof_terms++;
+
+            p.lo.push_back(float(r.lo));
+            p.hi.push_back(float(r.hi));
+            p.c.push_back(c);
+        }
+    }
+
+    p.nof_blocks = (p.nof_terms + BLK - 1) / BLK;
+
+    // padding terms have zero importance, so they never contribute
+    size_t nof_padded = size_t(p.nof_blocks) * BLK;
+    p.lo.resize(nof_padded, 0.0f);
+    p.hi.resize(nof_padded, 0.0f);
+    p.c.resize(nof_padded, 0.0f);
+    p.a.assign(nof_padded * p.nof_srcs, 0.0f);
+
+    for(int s = 0; s != m.nof_srcs; ++s)
+    {
+        for(int64_t k = m.row_start[s]; k != m.row_start[s + 1]; ++k)
+        {
+            for(int t = head[m.voxel[k]]; t >= 0; t = next[t])
+            {
+                size_t b = size_t(t / BLK);
+                p.a[(b*p.nof_srcs + s)*BLK + t % BLK] = m.dose[k];
+            }
+        }
+    }
+    return p;
+}
+
+// objective and its gradient over blocks [b0, b1)
+static double eval_blocks(const problem& p, const float* w, int b0, int b1, double* grad)
+{
+    const int ns = p.nof_srcs;
+
+    alignas(64) float d[BLK];
+    alignas(64) float g[BLK];
+
+    double f = 0.0;
+    for(int b = b0; b != b1; ++b)
+    {
+        const float* __restrict__ ab = p.a.data()  + size_t(b) * ns * BLK;
+        const float* __restrict__ lo = p.lo.data() + size_t(b) * BLK;
+        const float* __restrict__ hi = p.hi.data() + size_t(b) * BLK;
+        const float* __restrict__ c  = p.c.data()  + size_t(b) * BLK;
+
+        // block dose
+        std::fill(d, d + BLK, 0.0f);
+        for(int s = 0; s != ns; ++s)
+        {
+            const float  ws = w[s];
+            const float* __restrict__ as = ab + s*BLK;
+            for(int v = 0; v != BLK; ++v)
+                d[v] += ws * as[v];
+        }
+
+        // residual, weighted, and objective
+        float fb[LANES] = {};
+        for(int v = 0; v != BLK; v += LANES)
+        {
+            for(int l = 0; l != LANES; ++l)
+            {
+                float dv = d[v + l];
+                float r  = std::min(dv - lo[v + l], 0.0f) + std::max(dv - hi[v + l], 0.0f);
+                g[v + l] = 2.0f * c[v + l] * r;
+                fb[l]   += c[v + l] * r * r;
+            }
+        }
+        for(int l = 0; l != LANES; ++l)
+            f += fb[l];
+
+        // gradient, the block is still in cache
+        for(int s = 0; s != ns; ++s)
+        {
+            const float* __restrict__ as = ab + s*BLK;
+
+            float acc[LANES] = {};
+            for(int v = 0; v != BLK; v += LANES)
+            {
+                for(int l = 0; l != LANES; ++l)
+                    acc[l] += as[v + l] * g[v + l];
+            }
+
+            float sum = 0.0f;
+            for(int l = 0; l != LANES; ++l)
+                sum += acc[l];
+            grad[s] += sum;
+        }
+    }
+    return f;
+}
+
+class evaluator
+{
+    private: const problem&                    _p;
+    private: int                               _nof_threads;
+    private: std::vector<float>                _w;
+    private: std::vector<std::vector<double>>  _grads;
+    private: std::vector<double>               _fs;
+
+    public: int64_t nof_evals = 0;
+
+    public: evaluator(const problem& p, int nof_threads):
+        _p(p),
+        _nof_threads{std::max(1, std::min(nof_threads, p.nof_blocks))},
+        _w(p.nof_srcs),
+        _grads(_nof_threads, std::vector<double>(p.nof_srcs)),
+        _fs(_nof_threads)
+    {
+    }
+
+    public: double operator()(const std::vector<double>& w, std::vector<double>& grad)
+    {
+        ++nof_evals;
+        for(int s = 0; s != _p.nof_srcs; ++s)
+            _w[s] = float(w[s]);
+
+        auto work = [this](int t)
+        {
+            int b0 = int(int64_t(_p.nof_blocks) * t / _nof_threads);
+            int b1 = int(int64_t(_p.nof_blocks) * (t + 1) / _nof_threads);
+
+            std::fill(_grads[t].begin(), _grads[t].end(), 0.0);
+            _fs[t] = eval_blocks(_p, _w.data(), b0, b1, _grads[t].data());
+        };
+
+        std::vector<std::thread> threads;
+        for(int t = 1; t < _nof_threads; ++t)
+            threads.emplace_back(work, t);
+        work(0);
+        for(auto& th: threads)
+            th.join();
+
+        double f = 0.0;
+        grad.assign(_p.nof_srcs, 0.0);
+        for(int t = 0; t != _nof_threads; ++t)
+        {
+            f += _fs[t];
+            for(int s = 0; s != _p.nof_srcs; ++s)
+                grad[s] += _grads[t][s];
+        }
+        return f;
+    }
+};
+
+static double dot(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double s = 0.0;
+    for(size_t k = 0; k != a.size(); ++k)
+        s += a[k] * b[k];
+    return s;
+}
+
+// norm of projected gradient step, zero at the constrained minimum
+static double pg_norm(const std::vector<double>& w, const std::vector<double>& grad)
+{
+    double s = 0.0;
+    for(size_t k = 0; k != w.size(); ++k)
+    {
+        double d = w[k] - std::max(0.0, w[k] - grad[k]);
+        s += d*d;
+    }
+    return std::sqrt(s);
+}
+
+// dose of the ROI voxels for given weights, straight from the matrix rows
+static std::vector<double> roi_dose(const dij& m, const std::vector<double>& w)
+{
+    std::vector<double> d(m.nof_voxels(), 0.0);
+    for(int s = 0; s != m.nof_srcs; ++s)
+    {
+        for(int64_t k = m.row_start[s]; k != m.row_start[s + 1]; ++k)
+            d[m.voxel[k]] += w[s] * m.dose[k];
+    }
+    return d;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "Usage: ph_opt dij.bin objectives.txt [phantom.hed] [nof_threads] [max_iterations]\n");
+        return 1;
+    }
+
+    std::string hed_name    = (argc > 3) ? argv[3] : "phantom.hed";
+    int         nof_threads = (argc > 4) ? std::stoi(argv[4]) : int(std::max(1u, std::thread::hardware_concurrency()));
+    int         max_iters   = (argc > 5) ? std::stoi(argv[5]) : 500;
+
+    try
+    {
+        auto t0 = oclock::now();
+
+        PhantomSetup phs{hed_name.c_str()};
+        dij          m = read_dij(argv[1]);
+        if (m.nofv_x != phs.nofv_x() || m.nofv_y != phs.nofv_y() || m.nofv_z != phs.nofv_z())
+            throw std::runtime_error("Dose matrix grid does not match " + hed_name);
+
+        std::vector<roi> rois = read_objectives(argv[2], phs);
+        if (rois.empty())
+            throw std::runtime_error("No objectives");
+
+        problem p = build_problem(m, rois);
+
+        std::chrono::duration<double> load = oclock::now() - t0;
+        std::printf("%d sources, %lld nonzeros, %d terms in %d blocks, loaded in %.3f s\n",
+                    m.nof_srcs, (long long)m.voxel.size(), p.nof_terms, p.nof_blocks, load.count());
+
+        evaluator eval{p, nof_threads};
+
+        // start from equal weights, scaled so the mean dose of ROIs with
+        // lower limit hits that limit
+        std::vector<double> w(m.nof_srcs, 1.0);
+        {
+            std::vector<double> d = roi_dose(m, w);
+
+            double lo_sum = 0.0;
+            double d_sum  = 0.0;
+            for(const auto& r: rois)
+            {
+                if (r.lo <= 0.0)
+                    continue;
+                for(int v: r.voxels)
+                {
+                    lo_sum += r.lo;
+                    d_sum  += d[v];
+                }
+            }
+            double scale = (lo_sum > 0.0 && d_sum > 0.0) ? lo_sum / d_sum : 1.0;
+            for(auto& ws: w)
+                ws *= scale;
+        }
+
+        t0 = oclock::now();
+
+        std::vector<double> grad;
+        std::vector<double> w_new(m.nof_srcs);
+        std::vector<double> grad_new;
+
+        double f     = eval(w, grad);
+        double f0    = f;
+        double pg0   = pg_norm(w, grad);
+        double gmax  = 0.0;
+        for(double gs: grad)
+            gmax = std::max(gmax, std::abs(gs));
+
+        double step = (gmax > 0.0) ? 0.1 * (*std::max_element(w.begin(), w.end())) / gmax : 1.0;
+
+        int it = 0;
+        for(; it != max_iters; ++it)
+        {
+            double pg = pg_norm(w, grad);
+            if (pg <= 1.0e-6 * pg0 || f <= 1.0e-12 * f0)
+                break;
+
+            // projected step with Armijo backtracking
+            double f_new = 0.0;
+            int    k     = 0;
+            for(; k != 40; ++k)
+            {
+                for(int s = 0; s != m.nof_srcs; ++s)
+                    w_new[s] = std::max(0.0, w[s] - step * grad[s]);
+
+                f_new = eval(w_new, grad_new);
+
+                double decrease = 0.0;
+                for(int s = 0; s != m.nof_srcs; ++s)
+                    decrease += grad[s] * (w[s] - w_new[s]);
+
+                if (f_new <= f - 1.0e-4 * decrease)
+                    break;
+                step *= 0.5;
+            }
+            if (k == 40)
+                break;
+
+            // Barzilai-Borwein step for the next iteration
+            std::vector<double> sw(m.nof_srcs);
+            std::vector<double> yg(m.nof_srcs);
+            for(int s = 0; s != m.nof_srcs; ++s)
+            {
+                sw[s] = w_new[s] - w[s];
+                yg[s] = grad_new[s] - grad[s];
+            }
+            double sy = dot(sw, yg);
+            step = (sy > 0.0) ? dot(sw, sw) / sy : 2.0 * step;
+
+            w.swap(w_new);
+            grad.swap(grad_new);
+            f = f_new;
+        }
+
+        std::chrono::duration<double> solve = oclock::now() - t0;
+        std::printf("%d iterations, %lld evaluations, %d threads, objective %g -> %g, solved in %.3f s\n",
+                    it, (long long)eval.nof_evals, nof_threads, f0, f, solve.count());
+
+        // per ROI dose statistics with the final weights
+        std::vector<double> d = roi_dose(m, w);
+        std::printf("%-16s %10s %12s %12s %12s %10s\n", "ROI", "voxels", "min, Gy", "mean, Gy", "max, Gy", "in limits");
+        for(const auto& r: rois)
+        {
+            double dmin = std::numeric_limits<double>::max();
+            double dmax = 0.0;
+            double sum  = 0.0;
+            int    in   = 0;
+            for(int v: r.voxels)
+            {
+                dmin = std::min(dmin, d[v]);
+                dmax = std::max(dmax, d[v]);
+                sum += d[v];
+                in  += (d[v] >= r.lo && d[v] <= r.hi) ? 1 : 0;
+            }
+            std::printf("%-16s %10zu %12.5g %12.5g %12.5g %9.1f%%\n", r.name.c_str(), r.voxels.size(),
+                        dmin, sum / double(r.voxels.size()), dmax, 100.0 * in / double(r.voxels.size()));
+        }
+
+        std::ofstream os("weights.out");
+        for(int s = 0; s != m.nof_srcs; ++s)
+            os << s << "     " << w[s] << std::endl;
+        std::printf("weights written to weights.out\n");
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "ph_opt: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
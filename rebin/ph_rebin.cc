@@ -0,0 +1,228 @@
+// Dose on any grid from list-mode energy deposition streams
+//
+// Usage: ph_rebin grid.hed output quantity nof_threads stream [stream ...]
+//
+//  grid.hed    - phantom header of the output grid, VOXELSIZE and DIMENSION
+//                are used, the grid is centred at the phantom centre as the
+//                phantom one, so a smaller DIMENSION is a box around the centre
+//  output      - dose.out format output, keys are voxel index plus nofv_z
+//  quantity    - dose (Gy) or edep (MeV)
+//  nof_threads - 0 for hardware concurrency
+//  stream      - files written with /GP/listmode/enable, see ListModeStream.hh
+//
+// Records are split into chunks of all streams, threads take chunks one by
+// one and bin them into their own grid, then grids are summed slab by slab
+// in parallel. Dose of the voxel is sum of edep/density over its volume, so
+// it is the volume average of the dose, the same as the phantom scorer gives
+// for the grid of the run. Records outside of the grid are dropped.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "G4SystemOfUnits.hh"
+
+#include "PhantomSetup.hh"
+#include "ListModeStream.hh"
+
+using rclock = std::chrono::steady_clock;
+using record = ListModeStream::record;
+
+static constexpr int64_t chunk_records = int64_t(1) << 18;
+
+struct chunk
+{
+    int     stream;
+    int64_t first;
+    int64_t count;
+};
+
+static int64_t count_records(const std::string& fname)
+{
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    if (!is)
+        throw std::runtime_error("Cannot open list-mode file: " + fname);
+
+    ListModeStream::header h;
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!is || std::memcmp(h.magic, "PHLM0002", sizeof(h.magic)) != 0)
+        throw std::runtime_error("Not a list-mode file: " + fname);
+    if (h.record_size != int32_t(sizeof(record)))
+        throw std::runtime_error("Unexpected record size in " + fname);
+
+    is.seekg(0, std::ios::end);
+    int64_t size = int64_t(is.tellg()) - int64_t(sizeof(h));
+
+    // the tail of a stream cut short is dropped
+    return size / int64_t(sizeof(record));
+}
+
+// records of the chunk into the grid of the thread
+static void bin_chunk(const std::string& fname, const chunk& c, const PhantomSetup& phs, bool dose, std::vector<double>& grid, std::vector<record>& buffer)
+{
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    is.seekg(std::streamoff(sizeof(ListModeStream::header) + c.first * sizeof(record)));
+
+    buffer.resize(size_t(c.count));
+    is.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(c.count * sizeof(record)));
+    if (!is)
+        throw std::runtime_error("Failed reading " + fname);
+
+    // grid is centred at the origin, voxel sizes are in mm
+    float half_x = 0.5f * phs.cube_x() / float(mm);
+    float half_y = 0.5f * phs.cube_y() / float(mm);
+    float half_z = 0.5f * phs.cube_z() / float(mm);
+    float inv_x  = float(mm) / phs.voxel_x();
+    float inv_y  = float(mm) / phs.voxel_y();
+    float inv_z  = float(mm) / phs.voxel_z();
+
+    for(const auto& r: buffer)
+    {
+        float fx = (r.x + half_x) * inv_x;
+        float fy = (r.y + half_y) * inv_y;
+        float fz = (r.z + half_z) * inv_z;
+        if (!(fx >= 0.0f && fy >= 0.0f && fz >= 0.0f))
+            continue;
+
+        int ix = int(fx);
+        int iy = int(fy);
+        int iz = int(fz);
+        if (ix >= phs.nofv_x() || iy >= phs.nofv_y() || iz >= phs.nofv_z())
+            continue;
+
+        double e = double(r.edep);
+        if (dose)
+        {
+            if (r.density <= 0.0f)
+                continue;
+            e /= double(r.density);
+        }
+        grid[phs.idx(ix, iy, iz)] += e;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 6)
+    {
+        std::fprintf(stderr, "Usage: ph_rebin grid.hed output quantity nof_threads stream [stream ...]\n");
+        return 1;
+    }
+
+    std::string hed_name    = argv[1];
+    std::string out_name    = argv[2];
+    std::string quantity    = argv[3];
+    int         nof_threads = std::stoi(argv[4]);
+    if (nof_threads <= 0)
+        nof_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<std::string> streams{argv + 5, argv + argc};
+
+    try
+    {
+        if (quantity != "dose" && quantity != "edep")
+            throw std::runtime_error("Unknown quantity: " + quantity);
+        bool dose = (quantity == "dose");
+
+        auto t0 = rclock::now();
+
+        PhantomSetup phs{hed_name.c_str()};
+
+        std::vector<chunk> chunks;
+        int64_t            nof_records = 0;
+        for(int k = 0; k != int(streams.size()); ++k)
+        {
+            int64_t n = count_records(streams[k]);
+            for(int64_t first = 0; first < n; first += chunk_records)
+                chunks.push_back(chunk{k, first, std::min(chunk_records, n - first)});
+            nof_records += n;
+        }
+
+        nof_threads = std::max(1, std::min(nof_threads, int(chunks.size())));
+
+        // every thread bins into its own grid, chunks are handed out in order
+        std::vector<std::vector<double>> grids(nof_threads);
+        std::atomic<size_t>              next{0};
+        std::vector<std::string>         errors(nof_threads);
+
+        auto worker = [&](int t)
+        {
+            try
+            {
+                grids[t].assign(phs.nof_voxels(), 0.0);
+
+                std::vector<record> buffer;
+                for(size_t c = next++; c < chunks.size(); c = next++)
+                    bin_chunk(streams[chunks[c].stream], chunks[c], phs, dose, grids[t], buffer);
+            }
+            catch (const std::exception& e)
+            {
+                errors[t] = e.what();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(int t = 1; t < nof_threads; ++t)
+            threads.emplace_back(worker, t);
+        worker(0);
+        for(auto& th: threads)
+            th.join();
+
+        for(const auto& e: errors)
+            if (!e.empty())
+                throw std::runtime_error(e);
+
+        // sum of thread grids, each thread takes its slab of voxels
+        std::vector<double>& out = grids[0];
+        auto reduce = [&](int t)
+        {
+            int64_t n     = phs.nof_voxels();
+            int64_t first = n*t/nof_threads;
+            int64_t last  = n*(t + 1)/nof_threads;
+            for(size_t g = 1; g < grids.size(); ++g)
+                for(int64_t k = first; k != last; ++k)
+                    out[k] += grids[g][k];
+        };
+
+        threads.clear();
+        for(int t = 1; t < nof_threads; ++t)
+            threads.emplace_back(reduce, t);
+        reduce(0);
+        for(auto& th: threads)
+            th.join();
+
+        // sum of MeV/(g/cm3) over the voxel volume is Gy
+        double scale = dose ? (MeV / (g/cm3)) / (phs.voxel_volume() * gray) : 1.0;
+
+        std::ofstream os(out_name);
+        for(int k = 0; k != phs.nof_voxels(); ++k)
+        {
+            if (out[k] != 0.0)
+                os << (k + phs.nofv_z()) << "     " << out[k]*scale << "\n";
+        }
+        if (!os)
+            throw std::runtime_error("Failed writing " + out_name);
+
+        std::chrono::duration<double> elapsed = rclock::now() - t0;
+        std::printf("%lld records of %zu streams, %d x %d x %d grid, %d threads, %.3f s, %s written to %s\n",
+                    (long long)nof_records, streams.size(), phs.nofv_x(), phs.nofv_y(), phs.nofv_z(),
+                    nof_threads, elapsed.count(), quantity.c_str(), out_name.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "ph_rebin: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "G4RunManager.hh"
+#include "G4MTRunManager.hh"
+#include "Randomize.hh"
+
+#include "Checkpoint.hh"
+#include "CheckpointMessenger.hh"
+#include "Detector.hh"
+
+// version 2 adds fine box grid after the dose grid, version 1 files are still read
+static const char chk_magic[8]    = { 'P', 'H', 'C', 'H', 'K', '0', '0', '2' };
+static const char chk_magic_v1[8] = { 'P', 'H', 'C', 'H', 'K', '0', '0', '1' };
+
+Checkpoint* Checkpoint::_instance = nullptr;
+
+Checkpoint* Checkpoint::Instance()
+{
+    return _instance;
+}
+
+Checkpoint::Checkpoint():
+    _messenger{nullptr},
+
+    _fname{"dose.chk"},
+    _every_events{0},
+    _every_minutes{0.0},
+
+    _mutex{},
+    _writing{false},
+    _last_write{clock::now()},
+
+    _base{},
+    _fine_base{},
+    _snapshots{},
+    _fine_snapshots{},
+    _snapshot_events{},
+
+    _rng_name{},
+    _rng_state{},
+    _rng_skip{0},
+
+    _events_per_publish{1},
+    _events_written{0}
+{
+    _instance  = this;
+    _messenger = new CheckpointMessenger(this);
+}
+
+Checkpoint::~Checkpoint()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+bool Checkpoint::publish_due(int64_t local_events, clock::time_point last_publish) const
+{
+    if (_every_events > 0 && local_events % _events_per_publish == 0)
+        return true;
+
+    if (_every_minutes > 0.0)
+    {
+        std::chrono::duration<double, std::ratio<60>> elapsed = clock::now() - last_publish;
+        if (elapsed.count() >= _every_minutes)
+            return true;
+    }
+
+    return false;
+}
+
+void Checkpoint::begin_run(int64_t nof_events_to_process)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _snapshots.clear();
+    _fine_snapshots.clear();
+    _snapshot_events.clear();
+    _last_write     = clock::now();
+    _events_written = 0;
+
+    // each worker publishes its share of the checkpoint interval
+    int nthreads = G4MTRunManager::GetMasterRunManager()->GetNumberOfThreads();
+    _events_per_publish = std::max<int64_t>(1, _every_events / std::max(1, nthreads));
+
+    // G4MTRunManager draws two seeds per event from the master engine, so
+    // restoring this state and skipping 2N draws lands right after the run
+    auto* engine = G4Random::getTheEngine();
+    _rng_name  = engine->name();
+    _rng_state = engine->put();
+    _rng_skip  = 2 * uint64_t(nof_events_to_process);
+}
+
+void Checkpoint::publish(int thread_id, int64_t local_events, const DoseGrid& local, const DoseGrid& local_fine)
+{
+    DoseGrid merged;
+    DoseGrid merged_fine;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _snapshots[thread_id]       = local;
+        _fine_snapshots[thread_id]  = local_fine;
+        _snapshot_events[thread_id] = local_events;
+
+        // cadence is in events, while grids count histories
+        int64_t nof_events = 0;
+        for(const auto& s: _snapshot_events)
+            nof_events += s.second;
+
+        bool due = (_every_events > 0) && (nof_events - _events_written >= _every_events);
+        if (_every_minutes > 0.0)
+        {
+            std::chrono::duration<double, std::ratio<60>> elapsed = clock::now() - _last_write;
+            due = due || (elapsed.count() >= _every_minutes);
+        }
+
+        // if another worker is busy writing, skip this one, data will be in the next checkpoint
+        if (!due || _writing.exchange(true))
+            return;
+
+        merged = _base;
+        for(const auto& s: _snapshots)
+            merged.merge(s.second);
+
+        merged_fine = _fine_base;
+        for(const auto& s: _fine_snapshots)
+            merged_fine.merge(s.second);
+
+        _last_write     = clock::now();
+        _events_written = nof_events;
+    }
+
+    // actual I/O is done outside of the lock, other workers keep on publishing
+    write(_fname, merged, merged_fine, _rng_name, _rng_state, _rng_skip);
+
+    G4cout << "Checkpoint: " << merged.nof_events() << " histories written to " << _fname << G4endl;
+
+    _writing = false;
+}
+
+DoseGrid Checkpoint::end_run(const DoseGrid& merged, DoseGrid& fine)
+{
+    DoseGrid result{_base};
+    DoseGrid result_fine{_fine_base};
+    if ((result.nof_voxels() != 0 && merged.nof_voxels() != 0 && !result.same_shape(merged)) ||
+        (result_fine.nof_voxels() != 0 && fine.nof_voxels() != 0 && !result_fine.same_shape(fine)))
+    {
+        G4Exception("Checkpoint", "001", JustWarning,
+                    "Resumed checkpoint does not match phantom grid, it is ignored");
+        result      = DoseGrid{};
+        result_fine = DoseGrid{};
+    }
+    result.merge(merged);
+    result_fine.merge(fine);
+    fine = std::move(result_fine);
+
+    if (enabled())
+    {
+        // run is complete, master engine is already past all used seeds
+        auto* engine = G4Random::getTheEngine();
+        write(_fname, result, fine, engine->name(), engine->put(), 0);
+
+        G4cout << "Checkpoint: final " << result.nof_events() << " histories written to " << _fname << G4endl;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _base      = DoseGrid{};
+    _fine_base = DoseGrid{};
+    _snapshots.clear();
+    _fine_snapshots.clear();
+    _snapshot_events.clear();
+
+    return result;
+}
+
+void Checkpoint::write(const std::string& fname, const DoseGrid& grid, const DoseGrid& fine,
+                       const std::string& rng_name, const std::vector<unsigned long>& rng_state, uint64_t rng_skip) const
+{
+    // write to temporary file and rename it, so preemption in the middle
+    // of the write never destroys previous checkpoint
+    std::string tmp_name = fname + ".tmp";
+    {
+        std::ofstream os(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!os)
+        {
+            G4Exception("Checkpoint", "002", JustWarning,
+                        ("Cannot open checkpoint file: " + tmp_name).c_str());
+            return;
+        }
+
+        os.write(chk_magic, sizeof(chk_magic));
+
+        uint32_t name_len = uint32_t(rng_name.size());
+        os.write(reinterpret_cast<const char*>(&name_len), sizeof(name_len));
+        os.write(rng_name.data(), name_len);
+
+        uint64_t state_len = rng_state.size();
+        os.write(reinterpret_cast<const char*>(&state_len), sizeof(state_len));
+        for(auto s: rng_state)
+        {
+            uint64_t v = s;
+            os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+        os.write(reinterpret_cast<const char*>(&rng_skip), sizeof(rng_skip));
+
+        grid.write(os);
+
+        // empty grid cannot be read back, so fine box is preceded by a flag
+        uint8_t has_fine = (fine.nof_voxels() != 0) ? 1 : 0;
+        os.write(reinterpret_cast<const char*>(&has_fine), sizeof(has_fine));
+        if (has_fine)
+            fine.write(os);
+    }
+
+    std::rename(tmp_name.c_str(), fname.c_str());
+}
+
+void Checkpoint::resume(const std::string& fname)
+{
+    G4cout << "Checkpoint::resume " << fname << G4endl;
+
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    if (!is)
+    {
+        G4Exception("Checkpoint", "003", JustWarning,
+                    ("Cannot open checkpoint file: " + fname).c_str());
+        return;
+    }
+
+    char magic[sizeof(chk_magic)];
+    is.read(magic, sizeof(magic));
+    bool v1 = is && memcmp(magic, chk_magic_v1, sizeof(chk_magic_v1)) == 0;
+    if (!is || (!v1 && memcmp(magic, chk_magic, sizeof(chk_magic)) != 0))
+    {
+        G4Exception("Checkpoint", "004", JustWarning,
+                    ("Not a checkpoint file: " + fname).c_str());
+        return;
+    }
+
+    uint32_t name_len = 0;
+    is.read(reinterpret_cast<char*>(&name_len), sizeof(name_len));
+    std::string rng_name(name_len, ' ');
+    is.read(&rng_name[0], name_len);
+
+    uint64_t state_len = 0;
+    is.read(reinterpret_cast<char*>(&state_len), sizeof(state_len));
+    std::vector<unsigned long> rng_state;
+    rng_state.reserve(state_len);
+    for(uint64_t k = 0; k != state_len && is; ++k)
+    {
+        uint64_t v = 0;
+        is.read(reinterpret_cast<char*>(&v), sizeof(v));
+        rng_state.push_back(static_cast<unsigned long>(v));
+    }
+
+    uint64_t rng_skip = 0;
+    is.read(reinterpret_cast<char*>(&rng_skip), sizeof(rng_skip));
+
+    DoseGrid grid;
+    bool ok = is && grid.read(is);
+
+    DoseGrid fine;
+    if (ok && !v1)
+    {
+        uint8_t has_fine = 0;
+        is.read(reinterpret_cast<char*>(&has_fine), sizeof(has_fine));
+        ok = is && (has_fine == 0 || fine.read(is));
+    }
+
+    if (!ok)
+    {
+        G4Exception("Checkpoint", "005", JustWarning,
+                    ("Corrupted checkpoint file: " + fname).c_str());
+        return;
+    }
+
+    auto* detector = static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (detector != nullptr &&
+        (grid.nofv_x() != detector->nofv_x() || grid.nofv_y() != detector->nofv_y() || grid.nofv_z() != detector->nofv_z()))
+    {
+        G4Exception("Checkpoint", "006", JustWarning,
+                    "Checkpoint grid does not match phantom, resume cancelled");
+        return;
+    }
+
+    // without the fine box dose, dose_fine.out would only cover the resumed histories
+    if (detector != nullptr)
+    {
+        const auto& phs = detector->phs();
+        bool fine_ok = phs.has_fine()
+                     ? (fine.nofv_x() == phs.fine_nofv_x() && fine.nofv_y() == phs.fine_nofv_y() && fine.nofv_z() == phs.fine_nofv_z())
+                     : (fine.nof_voxels() == 0);
+        if (!fine_ok)
+        {
+            G4Exception("Checkpoint", "008", JustWarning,
+                        "Checkpoint fine box does not match phantom, resume cancelled");
+            return;
+        }
+    }
+
+    // continue master random sequence right after the checkpointed run,
+    // so resumed histories never repeat already simulated ones
+    auto* engine = G4Random::getTheEngine();
+    if (engine->name() == rng_name && engine->get(rng_state))
+    {
+        const int chunk = 4096;
+        std::vector<double> scratch(chunk);
+        for(uint64_t left = rng_skip; left != 0; )
+        {
+            int n = int(std::min<uint64_t>(left, chunk));
+            engine->flatArray(n, scratch.data());
+            left -= n;
+        }
+    }
+    else
+    {
+        G4Exception("Checkpoint", "007", JustWarning,
+                    "Cannot restore random engine state, resumed run uses current one");
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _base      = std::move(grid);
+    _fine_base = std::move(fine);
+
+    G4cout << "Checkpoint: resumed " << _base.nof_events() << " histories from " << fname << G4endl;
+}
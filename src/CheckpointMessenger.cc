@@ -0,0 +1,85 @@
+#include "CheckpointMessenger.hh"
+#include "Checkpoint.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADouble.hh"
+
+CheckpointMessenger::CheckpointMessenger(Checkpoint* checkpoint):
+    _checkpoint{checkpoint},
+    _chk_directory{nullptr},
+    _fname_cmd{nullptr},
+    _every_events_cmd{nullptr},
+    _every_minutes_cmd{nullptr},
+    _resume_cmd{nullptr}
+{
+    _chk_directory = new G4UIdirectory("/GP/checkpoint/");
+    _chk_directory->SetGuidance("Checkpoint and resume control");
+
+    // checkpoint is handled on master, no need to send commands to workers
+    _fname_cmd = new G4UIcmdWithAString("/GP/checkpoint/fname", this);
+    _fname_cmd->SetGuidance("Set checkpoint file name");
+    _fname_cmd->SetParameterName("chkFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _every_events_cmd = new G4UIcmdWithAnInteger("/GP/checkpoint/every_events", this);
+    _every_events_cmd->SetGuidance("Write checkpoint every N events, 0 to disable");
+    _every_events_cmd->SetParameterName("everyEvents", false);
+    _every_events_cmd->SetRange("everyEvents>=0");
+    _every_events_cmd->SetToBeBroadcasted(false);
+    _every_events_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _every_minutes_cmd = new G4UIcmdWithADouble("/GP/checkpoint/every_minutes", this);
+    _every_minutes_cmd->SetGuidance("Write checkpoint every T minutes, 0 to disable");
+    _every_minutes_cmd->SetParameterName("everyMinutes", false);
+    _every_minutes_cmd->SetRange("everyMinutes>=0.0");
+    _every_minutes_cmd->SetToBeBroadcasted(false);
+    _every_minutes_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _resume_cmd = new G4UIcmdWithAString("/GP/checkpoint/resume", this);
+    _resume_cmd->SetGuidance("Load checkpoint file, next run adds its histories to it");
+    _resume_cmd->SetParameterName("resumeFname", false);
+    _resume_cmd->SetToBeBroadcasted(false);
+    _resume_cmd->AvailableForStates(G4State_Idle);
+}
+
+CheckpointMessenger::~CheckpointMessenger()
+{
+    delete _fname_cmd;
+    delete _every_events_cmd;
+    delete _every_minutes_cmd;
+    delete _resume_cmd;
+
+    delete _chk_directory;
+}
+
+void CheckpointMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _fname_cmd)
+    {
+        _checkpoint->set_fname(value);
+        return;
+    }
+
+    if (cmd == _every_events_cmd)
+    {
+        _checkpoint->set_every_events(_every_events_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    if (cmd == _every_minutes_cmd)
+    {
+        _checkpoint->set_every_minutes(_every_minutes_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _resume_cmd)
+    {
+        _checkpoint->resume(value);
+        return;
+    }
+
+    return;
+}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+#include "Denoise.hh"
+#include "DenoiseMessenger.hh"
+#include "DoseGrid.hh"
+#include "Detector.hh"
+
+#include "G4SystemOfUnits.hh"
+
+// neighbours of the voxel along one axis at most
+static constexpr int max_radius = 6;
+
+Denoise* Denoise::_instance = nullptr;
+
+Denoise* Denoise::Instance()
+{
+    return _instance;
+}
+
+Denoise::Denoise():
+    _messenger{nullptr},
+    _enabled{false},
+    _fname{"dose_denoised.out"},
+    _sigma_space{2.0*mm},
+    _range{2.0},
+    _sigma_density{0.1*g/cm3},
+    _nof_threads{0}
+{
+    _instance  = this;
+    _messenger = new DenoiseMessenger(this);
+}
+
+Denoise::~Denoise()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+// spatial weights of the neighbours along the axis, up to two widths
+static std::vector<double> space_weights(double sigma, double side)
+{
+    int r = std::min(max_radius, int(std::floor(2.0*sigma/side)));
+
+    std::vector<double> w(size_t(r) + 1);
+    for(int k = 0; k <= r; ++k)
+    {
+        double d = k*side/sigma;
+        w[k] = std::exp(-0.5*d*d);
+    }
+    return w;
+}
+
+std::vector<double> Denoise::filter(const DoseGrid& grid, const std::vector<double>& density,
+                                    double side_x, double side_y, double side_z) const
+{
+    int nx = grid.nofv_x();
+    int ny = grid.nofv_y();
+    int nz = grid.nofv_z();
+
+    std::vector<double> mean(size_t(grid.nof_voxels()));
+    std::vector<double> var(size_t(grid.nof_voxels()));
+    for(int k = 0; k != grid.nof_voxels(); ++k)
+    {
+        double s = grid.sigma(k);
+        mean[k]  = grid.mean(k);
+        var[k]   = s*s;
+    }
+
+    auto wx = space_weights(_sigma_space, side_x);
+    auto wy = space_weights(_sigma_space, side_y);
+    auto wz = space_weights(_sigma_space, side_z);
+    int  rx = int(wx.size()) - 1;
+    int  ry = int(wy.size()) - 1;
+    int  rz = int(wz.size()) - 1;
+
+    bool   guided = _sigma_density > 0.0 && density.size() == mean.size();
+    double range2 = _range*_range;
+
+    std::vector<double> out(mean.size(), 0.0);
+
+    // threads take slices one by one, every voxel is written by one thread
+    std::atomic<int> next{0};
+    auto worker = [&]()
+    {
+        for(int iz = next++; iz < nz; iz = next++)
+        {
+            for(int iy = 0; iy != ny; ++iy)
+            {
+                for(int ix = 0; ix != nx; ++ix)
+                {
+                    size_t i  = size_t(ix) + size_t(nx)*(size_t(iy) + size_t(ny)*size_t(iz));
+                    double mi = mean[i];
+                    double vi = var[i];
+
+                    double sum_w = 0.0;
+                    double sum   = 0.0;
+                    for(int jz = std::max(iz - rz, 0); jz <= std::min(iz + rz, nz - 1); ++jz)
+                    {
+                        for(int jy = std::max(iy - ry, 0); jy <= std::min(iy + ry, ny - 1); ++jy)
+                        {
+                            double wzy = wz[std::abs(jz - iz)] * wy[std::abs(jy - iy)];
+                            for(int jx = std::max(ix - rx, 0); jx <= std::min(ix + rx, nx - 1); ++jx)
+                            {
+                                size_t j = size_t(jx) + size_t(nx)*(size_t(jy) + size_t(ny)*size_t(jz));
+                                // difference within the noise of both voxels is averaged away
+                                double dd = mean[j] - mi;
+                                double v  = range2*(vi + var[j]);
+                                double e  = 0.0;
+                                if (v > 0.0)
+                                    e = dd*dd/v;
+                                else if (dd != 0.0)
+                                    continue;
+
+                                if (guided)
+                                {
+                                    double dr = (density[j] - density[i]) / _sigma_density;
+                                    e += dr*dr;
+                                }
+
+                                // one exponent for both kernels
+                                double w = wzy * wx[std::abs(jx - ix)] * std::exp(-0.5*e);
+
+                                sum_w += w;
+                                sum   += w*mean[j];
+                            }
+                        }
+                    }
+
+                    // the voxel itself always has unit weight
+                    out[i] = sum / sum_w;
+                }
+            }
+        }
+    };
+
+    int nof_threads = (_nof_threads > 0) ? _nof_threads : int(std::max(1u, std::thread::hardware_concurrency()));
+    nof_threads     = std::max(1, std::min(nof_threads, nz));
+
+    std::vector<std::thread> threads;
+    for(int t = 1; t < nof_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& th: threads)
+        th.join();
+
+    return out;
+}
+
+void Denoise::write(const DoseGrid& total, const Detector* detector, int key_offset) const
+{
+    if (!_enabled || detector == nullptr || total.nof_voxels() == 0 || total.nof_events() == 0)
+        return;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    auto filtered = filter(total, detector->densities(), detector->voxel_x(), detector->voxel_y(), detector->voxel_z());
+
+    // the same sum over histories as the raw dose.out
+    double n = double(total.nof_events());
+
+    std::ofstream os(_fname);
+    for(size_t k = 0; k != filtered.size(); ++k)
+    {
+        if (filtered[k] != 0.0)
+            os << (int(k) + key_offset) << "     " << filtered[k]*n/gray << "\n";
+    }
+    os.close();
+    if (!os)
+    {
+        G4Exception("Denoise", "001", JustWarning, ("Failed writing " + _fname).c_str());
+        return;
+    }
+
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    G4cout << "Denoise: " << total.nofv_x() << " x " << total.nofv_y() << " x " << total.nofv_z()
+           << " grid filtered in " << dt.count() << " s, written to " << _fname << G4endl;
+}
@@ -0,0 +1,124 @@
+#include "DenoiseMessenger.hh"
+#include "Denoise.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+DenoiseMessenger::DenoiseMessenger(Denoise* denoise):
+    _denoise{denoise},
+    _denoise_directory{nullptr},
+    _enable_cmd{nullptr},
+    _fname_cmd{nullptr},
+    _sigma_space_cmd{nullptr},
+    _range_cmd{nullptr},
+    _sigma_density_cmd{nullptr},
+    _threads_cmd{nullptr}
+{
+    _denoise_directory = new G4UIdirectory("/GP/denoise/");
+    _denoise_directory->SetGuidance("Denoising of the merged dose at the end of run");
+
+    // settings are used on master only, no need to send commands to workers
+    _enable_cmd = new G4UIcmdWithABool("/GP/denoise/enable", this);
+    _enable_cmd->SetGuidance("Write filtered dose next to the raw dose.out");
+    _enable_cmd->SetParameterName("denoiseEnable", true);
+    _enable_cmd->SetDefaultValue(true);
+    _enable_cmd->SetToBeBroadcasted(false);
+    _enable_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _fname_cmd = new G4UIcmdWithAString("/GP/denoise/fname", this);
+    _fname_cmd->SetGuidance("Set filtered dose file name");
+    _fname_cmd->SetParameterName("denoiseFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _sigma_space_cmd = new G4UIcmdWithADoubleAndUnit("/GP/denoise/sigma_space", this);
+    _sigma_space_cmd->SetGuidance("Set width of the spatial Gaussian, neighbours up to two widths are used");
+    _sigma_space_cmd->SetParameterName("sigmaSpace", false);
+    _sigma_space_cmd->SetDefaultUnit("mm");
+    _sigma_space_cmd->SetUnitCandidates("mm cm");
+    _sigma_space_cmd->SetRange("sigmaSpace>0.0");
+    _sigma_space_cmd->SetToBeBroadcasted(false);
+    _sigma_space_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _range_cmd = new G4UIcmdWithADouble("/GP/denoise/range", this);
+    _range_cmd->SetGuidance("Set width of the dose Gaussian in combined standard errors of the two voxels");
+    _range_cmd->SetGuidance("Smaller keeps more of the dose edges, larger smooths more");
+    _range_cmd->SetParameterName("range", false);
+    _range_cmd->SetRange("range>0.0");
+    _range_cmd->SetToBeBroadcasted(false);
+    _range_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _sigma_density_cmd = new G4UIcmdWithADoubleAndUnit("/GP/denoise/sigma_density", this);
+    _sigma_density_cmd->SetGuidance("Set width of the density Gaussian, dose is not averaged over tissue interfaces");
+    _sigma_density_cmd->SetGuidance("0 turns density guidance off");
+    _sigma_density_cmd->SetParameterName("sigmaDensity", false);
+    _sigma_density_cmd->SetDefaultUnit("g/cm3");
+    _sigma_density_cmd->SetUnitCandidates("g/cm3 mg/cm3 kg/m3");
+    _sigma_density_cmd->SetRange("sigmaDensity>=0.0");
+    _sigma_density_cmd->SetToBeBroadcasted(false);
+    _sigma_density_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _threads_cmd = new G4UIcmdWithAnInteger("/GP/denoise/threads", this);
+    _threads_cmd->SetGuidance("Set number of filter threads, 0 for hardware concurrency");
+    _threads_cmd->SetParameterName("denoiseThreads", false);
+    _threads_cmd->SetRange("denoiseThreads>=0");
+    _threads_cmd->SetToBeBroadcasted(false);
+    _threads_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+DenoiseMessenger::~DenoiseMessenger()
+{
+    delete _enable_cmd;
+    delete _fname_cmd;
+    delete _sigma_space_cmd;
+    delete _range_cmd;
+    delete _sigma_density_cmd;
+    delete _threads_cmd;
+
+    delete _denoise_directory;
+}
+
+void DenoiseMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _enable_cmd)
+    {
+        _denoise->set_enabled(_enable_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _fname_cmd)
+    {
+        _denoise->set_fname(value);
+        return;
+    }
+
+    if (cmd == _sigma_space_cmd)
+    {
+        _denoise->set_sigma_space(_sigma_space_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _range_cmd)
+    {
+        _denoise->set_range(_range_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _sigma_density_cmd)
+    {
+        _denoise->set_sigma_density(_sigma_density_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _threads_cmd)
+    {
+        _denoise->set_nof_threads(_threads_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    return;
+}
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
 #include "globals.hh"
 
 #include "G4Box.hh"
@@ -5,26 +10,40 @@
 #include "G4VPhysicalVolume.hh"
 #include "G4PVPlacement.hh"
 #include "G4PVParameterised.hh"
+#include "G4PVReplica.hh"
+#include "G4RunManager.hh"
 #include "G4Material.hh"
+#include "G4Cons.hh"
+#include "G4Tubs.hh"
+#include "G4RotationMatrix.hh"
 #include "G4Element.hh"
 #include "G4UIcommand.hh"
 #include "G4PhysicalConstants.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4VisAttributes.hh"
+#include "G4Region.hh"
+#include "G4ProductionCuts.hh"
+#include "G4ProductionCutsTable.hh"
 
 #include "G4SDManager.hh"
 #include "G4MultiFunctionalDetector.hh"
 #include "G4PSDoseDeposit.hh"
 #include "G4PSDoseDeposit3D.hh"
 
+#include "DoseScorer.hh"
+
 #include "PhantomSetup.hh"
 #include "Phantom.hh"
+#include "NestedPhantom.hh"
 #include "Detector.hh"
+#include "DetectorMessenger.hh"
 
 Detector::Detector(const PhantomSetup& phs):
     G4VUserDetectorConstruction{},
+    _messenger{nullptr},
     _Air{nullptr},
     _Water{nullptr},
+    _Tungsten{nullptr},
 
     _world_solid{nullptr},
     _world_logic{nullptr},
@@ -44,19 +63,167 @@ Detector::Detector(const PhantomSetup& phs):
 
     _constructed{false},
 
-    _checkOverlaps{true}
+    _checkOverlaps{true},
+
+    _navigation{navigation::regular},
+    _construct_seconds{0.0},
+
+    _autocrop{false},
+    _crop_x0{0},
+    _crop_y0{0},
+    _crop_z0{0},
+    _crop_nx{phs.nofv_x()},
+    _crop_ny{phs.nofv_y()},
+    _crop_nz{phs.nofv_z()},
+    _mat_index{},
+
+    _blocks{},
+    _block_mat_index{},
+
+    _auto_cuts{false},
+    _cut_fraction{0.5},
+    _world_cut{1.0*cm},
+    _default_cut{std::numeric_limits<double>::quiet_NaN()},
+    _range_rejection{false},
+    _phantom_region{nullptr},
+    _phantom_cuts{nullptr},
+    _collimator{false},
+    _col_length{60.0*mm},
+    _col_exit_distance{200.0*mm},
+    _col_entrance_radius{4.0*mm},
+    _col_exit_radius{6.0*mm},
+    _col_outer_radius{30.0*mm},
+    _exit_logic{nullptr}
 {
+    _messenger = new DetectorMessenger(this);
 }
 
 Detector::~Detector()
 {
+    delete _messenger;
+}
+
+const char* Detector::navigation_name(navigation nav)
+{
+    switch (nav)
+    {
+        case navigation::regular: return "regular";
+        case navigation::smart:   return "smart";
+        case navigation::xaxis:   return "xaxis";
+        case navigation::nested:  return "nested";
+    }
+    return "unknown";
+}
+
+bool Detector::navigation_from_name(const std::string& name, navigation& nav)
+{
+    for(auto n: { navigation::regular, navigation::smart, navigation::xaxis, navigation::nested })
+    {
+        if (name == navigation_name(n))
+        {
+            nav = n;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Detector::set_navigation(navigation nav)
+{
+    if (nav == _navigation)
+        return;
+    _navigation = nav;
+
+    rebuild();
+}
+
+void Detector::set_autocrop(bool autocrop)
+{
+    if (autocrop == _autocrop)
+        return;
+    _autocrop = autocrop;
+
+    rebuild();
+}
+
+void Detector::rebuild()
+{
+    // built geometry has to go, next run constructs it again
+    if (_constructed)
+    {
+        _constructed = false;
+        G4RunManager::GetRunManager()->ReinitializeGeometry(true);
+    }
+}
+
+void Detector::init_crop()
+{
+    _blocks.clear();
+    _block_mat_index.clear();
+
+    _crop_x0 = 0;
+    _crop_y0 = 0;
+    _crop_z0 = 0;
+    _crop_nx = _phs.nofv_x();
+    _crop_ny = _phs.nofv_y();
+    _crop_nz = _phs.nofv_z();
+
+    // multi-resolution blocks are placed in the whole grid
+    if (_autocrop && _phs.has_fine())
+        G4Exception("Detector", "002", JustWarning, "Autocrop is not done for phantom with FINEBOX");
+
+    if (_autocrop && !_phs.has_fine())
+    {
+        _crop_x0 = _phs.box_x0();
+        _crop_y0 = _phs.box_y0();
+        _crop_z0 = _phs.box_z0();
+        _crop_nx = _phs.box_nx();
+        _crop_ny = _phs.box_ny();
+        _crop_nz = _phs.box_nz();
+    }
+
+    _mat_index.clear();
+    _mat_IDs = nullptr;
+    if (!_phs.has_materials())
+        return;
+
+    // material indices of the built part, in its own linear order
+    bool bad_index = false;
+    _mat_index.reserve(size_t(_crop_nx) * _crop_ny * _crop_nz);
+    for(int iz = 0; iz != _crop_nz; ++iz)
+    {
+        for(int iy = 0; iy != _crop_ny; ++iy)
+        {
+            for(int ix = 0; ix != _crop_nx; ++ix)
+            {
+                size_t m = size_t(_phs.material(_phs.idx(_crop_x0 + ix, _crop_y0 + iy, _crop_z0 + iz)));
+                if (m >= _materials.size())
+                {
+                    bad_index = true;
+                    m = 0;
+                }
+                _mat_index.push_back(m);
+            }
+        }
+    }
+    _mat_IDs = _mat_index.data();
+
+    if (bad_index)
+        G4Exception("Detector", "001", JustWarning, "Phantom has unknown material indices, they are set to air");
 }
 
 G4VPhysicalVolume* Detector::Construct()
 {
     if( !_constructed || _world_phys == nullptr)
     {
-        init_materials();
+        auto t0 = std::chrono::steady_clock::now();
+
+        // materials survive geometry reinitialization
+        if (_materials.empty())
+            init_materials();
+        _scorers.clear();
+
+        init_crop();
 
         //----- Build world
         double world_x = 50.0 * cm;
@@ -79,10 +246,32 @@ G4VPhysicalVolume* Detector::Construct()
                                          0,                    // copy number
                                          _checkOverlaps );
 
-        make_phantom_container();
-        make_phantom();
+        if (_collimator)
+        {
+            make_collimator();
+        }
+        else
+        {
+            make_phantom_container();
+            make_phantom_region();
+            if (_phs.has_fine())
+                make_multires_phantom();
+            else if (_navigation == navigation::nested)
+                make_nested_phantom();
+            else
+                make_phantom();
+        }
 
         _constructed = true;
+
+        std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+        _construct_seconds = dt.count();
+
+        if (_collimator)
+            G4cout << "Detector: collimator channel built in " << _construct_seconds << " s" << G4endl;
+        else
+            G4cout << "Detector: phantom built for " << navigation_name(_navigation)
+                   << " navigation in " << _construct_seconds << " s" << G4endl;
     }
 
     return _world_phys;
@@ -131,9 +320,9 @@ void Detector::make_phantom_container()
 {
     // Define the volume that contains all the voxels
     _container_solid = new G4Box{"phantomContainer",
-                                  0.5*cube_x(),
-                                  0.5*cube_y(),
-                                  0.5*cube_z() };
+                                  0.5*_crop_nx*voxel_x(),
+                                  0.5*_crop_ny*voxel_y(),
+                                  0.5*_crop_nz*voxel_z() };
 
     _container_logic = new G4LogicalVolume{ _container_solid,
                                             _Air, // material is not important, it will be fully filled by the voxels
@@ -143,9 +332,10 @@ void Detector::make_phantom_container()
                                            nullptr }; // user limits
 
     // Place it on the world
-    double offset_x = 0.0;
-    double offset_y = 0.0;
-    double offset_z = 0.0;
+    // full grid is centered at the origin, the built part is where it is in the grid
+    double offset_x = (_crop_x0 + 0.5*_crop_nx)*voxel_x() - 0.5*cube_x();
+    double offset_y = (_crop_y0 + 0.5*_crop_ny)*voxel_y() - 0.5*cube_y();
+    double offset_z = (_crop_z0 + 0.5*_crop_nz)*voxel_z() - 0.5*cube_z();
 
     G4ThreeVector pos_center_voxels( offset_x, offset_y, offset_z );
 
@@ -158,6 +348,268 @@ void Detector::make_phantom_container()
                                          1 );                 // copy number
 }
 
+void Detector::make_collimator()
+{
+    // no phantom, so no phantom region either
+    delete _phantom_region;
+    _phantom_region = nullptr;
+    apply_cuts();
+
+    if (_Tungsten == nullptr)
+    {
+        double z, a, density;
+        _Tungsten = new G4Material( "Tungsten", z = 74.0, a = 183.84*g/mole, density = 19.3*g/cm3 );
+    }
+
+    // conical shell along its Z, entrance at -Z; channel is the world air
+    auto* col_solid = new G4Cons{ "collimator",
+                                  _col_entrance_radius, _col_outer_radius,
+                                  _col_exit_radius,     _col_outer_radius,
+                                  0.5*_col_length, 0.0, 2.0*M_PI };
+
+    auto* col_logic = new G4LogicalVolume{ col_solid, _Tungsten, "collimator", nullptr, nullptr, nullptr };
+
+    // frame rotation of the placement is inverse of the volume one, -90 degree
+    // puts the cone Z along world +X, from the source towards the isocentre
+    auto* rotation = new G4RotationMatrix;
+    rotation->rotateY(-90.0*deg);
+
+    new G4PVPlacement( rotation,
+                       G4ThreeVector(-_col_exit_distance - 0.5*_col_length, 0.0, 0.0),
+                       col_logic,
+                       "collimator",
+                       _world_logic,
+                       false,
+                       0,
+                       _checkOverlaps );
+
+    // exit disc, its face is the phase-space plane
+    auto* exit_solid = new G4Tubs{ "collimatorExit", 0.0, _col_outer_radius, 0.5*exit_thickness, 0.0, 2.0*M_PI };
+
+    _exit_logic = new G4LogicalVolume{ exit_solid, _Air, "collimatorExit", nullptr, nullptr, nullptr };
+
+    new G4PVPlacement( rotation,
+                       G4ThreeVector(-_col_exit_distance + exit_gap + 0.5*exit_thickness, 0.0, 0.0),
+                       _exit_logic,
+                       "collimatorExit",
+                       _world_logic,
+                       false,
+                       1,
+                       _checkOverlaps );
+}
+
+void Detector::set_collimator(bool collimator)
+{
+    if (collimator == _collimator)
+        return;
+    _collimator = collimator;
+
+    rebuild();
+}
+
+void Detector::set_col_length(double length)
+{
+    _col_length = length;
+    if (_collimator)
+        rebuild();
+}
+
+void Detector::set_col_exit_distance(double distance)
+{
+    _col_exit_distance = distance;
+    if (_collimator)
+        rebuild();
+}
+
+void Detector::set_col_entrance_radius(double radius)
+{
+    _col_entrance_radius = radius;
+    if (_collimator)
+        rebuild();
+}
+
+void Detector::set_col_exit_radius(double radius)
+{
+    _col_exit_radius = radius;
+    if (_collimator)
+        rebuild();
+}
+
+void Detector::set_col_outer_radius(double radius)
+{
+    _col_outer_radius = radius;
+    if (_collimator)
+        rebuild();
+}
+
+void Detector::make_phantom_region()
+{
+    // old region root volume is gone with the old geometry
+    delete _phantom_region;
+
+    _phantom_region = new G4Region{"phantomRegion"};
+    _phantom_region->AddRootLogicalVolume(_container_logic);
+
+    apply_cuts();
+}
+
+void Detector::set_auto_cuts(bool auto_cuts)
+{
+    _auto_cuts = auto_cuts;
+    apply_cuts();
+}
+
+void Detector::set_cut_fraction(double fraction)
+{
+    _cut_fraction = fraction;
+    apply_cuts();
+}
+
+void Detector::set_world_cut(double cut)
+{
+    _world_cut = cut;
+    apply_cuts();
+}
+
+double Detector::min_voxel() const
+{
+    int f = 1;
+    for(const auto& b: _blocks)
+        f = std::max(f, b.factor);
+
+    return std::min(voxel_x(), std::min(voxel_y(), voxel_z())) / double(f);
+}
+
+double Detector::voxel_safety(double x, double y, double z) const
+{
+    int f = 1;
+    for(const auto& b: _blocks)
+        f = std::max(f, b.factor);
+
+    // full grid is centered at the origin
+    auto safety = [](double p, double half, double side)
+    {
+        double d = std::fmod(p + half, side);
+        if (d < 0.0)
+            d += side;
+        return std::min(d, side - d);
+    };
+
+    return std::min(safety(x, 0.5*cube_x(), voxel_x()/f),
+                    std::min(safety(y, 0.5*cube_y(), voxel_y()/f),
+                             safety(z, 0.5*cube_z(), voxel_z()/f)));
+}
+
+std::vector<double> Detector::densities() const
+{
+    std::vector<double> density(size_t(_phs.nof_voxels()), 0.0);
+    if (_materials.empty())
+        return density;
+
+    for(int k = 0; k != _phs.nof_voxels(); ++k)
+    {
+        size_t m = size_t(_phs.material(k));
+        density[k] = _materials[(m < _materials.size()) ? m : 0]->GetDensity();
+    }
+    return density;
+}
+
+double Detector::optical_depth(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double* length) const
+{
+    double t;
+    double tau = walk(p, w, mu, std::numeric_limits<double>::infinity(), t);
+    if (length != nullptr)
+        *length = t;
+    return tau;
+}
+
+double Detector::optical_distance(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double depth) const
+{
+    double t;
+    walk(p, w, mu, depth, t);
+    return t;
+}
+
+double Detector::walk(const G4ThreeVector& p, const G4ThreeVector& w, const std::vector<double>& mu, double depth, double& length) const
+{
+    // walk voxels of the built part along the ray, coarse grid materials
+    G4ThreeVector lo = container_lo();
+
+    const double side[3] = {voxel_x(), voxel_y(), voxel_z()};
+    const int    n[3]    = {_crop_nx, _crop_ny, _crop_nz};
+
+    int    i[3], step[3];
+    double t_next[3], t_delta[3];
+    for(int k = 0; k != 3; ++k)
+    {
+        // point on the face may round to the voxel outside
+        i[k] = std::min(std::max(int(std::floor((p[k] - lo[k]) / side[k])), 0), n[k] - 1);
+
+        step[k]    = (w[k] > 0.0) ? 1 : ((w[k] < 0.0) ? -1 : 0);
+        t_delta[k] = (step[k] != 0) ? side[k] / std::abs(w[k]) : std::numeric_limits<double>::infinity();
+        t_next[k]  = (step[k] != 0) ? std::max(0.0, (lo[k] + (i[k] + (step[k] > 0 ? 1 : 0))*side[k] - p[k]) / w[k])
+                                    : std::numeric_limits<double>::infinity();
+    }
+
+    double tau = 0.0;
+    double t   = 0.0;
+    for(;;)
+    {
+        int k = (t_next[0] < t_next[1]) ? ((t_next[0] < t_next[2]) ? 0 : 2) : ((t_next[1] < t_next[2]) ? 1 : 2);
+
+        size_t m = _mat_index.empty() ? 0 : _mat_index[size_t(i[0]) + size_t(_crop_nx)*(size_t(i[1]) + size_t(_crop_ny)*size_t(i[2]))];
+        double d = mu[m] * (t_next[k] - t);
+
+        // depth is reached in this voxel
+        if (tau + d >= depth)
+        {
+            length = t + ((mu[m] > 0.0) ? (depth - tau) / mu[m] : 0.0);
+            return depth;
+        }
+        tau += d;
+        t    = t_next[k];
+
+        i[k] += step[k];
+        if (i[k] < 0 || i[k] >= n[k])
+            break;
+        t_next[k] += t_delta[k];
+    }
+    length = t;
+    return tau;
+}
+
+void Detector::apply_cuts()
+{
+    auto* default_cuts = G4ProductionCutsTable::GetProductionCutsTable()->GetDefaultProductionCuts();
+
+    if (!_auto_cuts)
+    {
+        // back to the world cuts everywhere, as before auto cuts
+        if (!std::isnan(_default_cut))
+        {
+            default_cuts->SetProductionCut(_default_cut);
+            _default_cut = std::numeric_limits<double>::quiet_NaN();
+        }
+        if (_phantom_region != nullptr)
+            _phantom_region->SetProductionCuts(default_cuts);
+        return;
+    }
+
+    if (std::isnan(_default_cut))
+        _default_cut = default_cuts->GetProductionCut("gamma");
+    default_cuts->SetProductionCut(_world_cut);
+
+    if (_phantom_cuts == nullptr)
+        _phantom_cuts = new G4ProductionCuts;
+    _phantom_cuts->SetProductionCut(phantom_cut());
+
+    if (_phantom_region != nullptr)
+        _phantom_region->SetProductionCuts(_phantom_cuts);
+
+    G4cout << "Detector: production cuts " << phantom_cut()/mm << " mm in phantom, "
+           << _world_cut/mm << " mm in world" << G4endl;
+}
+
 void Detector::set_scorer(G4LogicalVolume* voxel_logic)
 {
     _scorers.insert(voxel_logic);
@@ -176,10 +628,20 @@ void Detector::ConstructSDandField()
 
     // Define MultiFunctionalDetector with name.
     // declare MFDet as a MultiFunctionalDetector scorer
-    G4MultiFunctionalDetector* MFDet = new G4MultiFunctionalDetector(concreteSDname);
+    // after geometry reinitialization the detector is already there, only
+    // new voxel volume has to be attached and the scorer told how to index
+    auto* MFDet = static_cast<G4MultiFunctionalDetector*>(G4SDManager::GetSDMpointer()->FindSensitiveDetector(concreteSDname, false));
+    if (MFDet == nullptr)
+    {
+        MFDet = new G4MultiFunctionalDetector(concreteSDname);
 
-    G4VPrimitiveScorer* dosedep = new G4PSDoseDeposit3D("DoseDeposit", _phs.nofv_x(), _phs.nofv_y(), _phs.nofv_z());
-    MFDet->RegisterPrimitive(dosedep);
+        G4VPrimitiveScorer* dosedep = new DoseScorer("DoseDeposit", _phs.nofv_x(), _phs.nofv_y(), _phs.nofv_z());
+        MFDet->RegisterPrimitive(dosedep);
+    }
+    auto* scorer = static_cast<DoseScorer*>(MFDet->GetPrimitive(0));
+    scorer->set_nested(_navigation == navigation::nested);
+    scorer->set_crop(_crop_x0, _crop_y0, _crop_z0, _crop_nx, _crop_ny, _crop_nz);
+    scorer->set_blocks(_blocks);
 
     for(auto ite = _scorers.begin(); ite != _scorers.end(); ++ite)
     {
@@ -196,7 +658,7 @@ void Detector::make_phantom()
     phantom->SetVoxelDimensions( 0.5 * _phs.voxel_x(), 0.5 * _phs.voxel_y(), 0.5 * _phs.voxel_z() );
 
     //----- Set number of voxels
-    phantom->SetNoVoxel( _phs.nofv_x(), _phs.nofv_y(), _phs.nofv_z() );
+    phantom->SetNoVoxel( _crop_nx, _crop_ny, _crop_nz );
 
     //----- Set list of materials
     phantom->SetMaterials( _materials );
@@ -231,8 +693,8 @@ void Detector::make_phantom()
     //----- The G4PVParameterised object that uses the created parameterisation
     // should be placed in the fContainer logical volume
     G4PVParameterised * phantom_phys = new G4PVParameterised("phantom", voxel_logic, _container_logic,
-                                                              kXAxis,
-                                                              _phs.nofv_x() * _phs.nofv_y() * _phs.nofv_z(),
+                                                              (_navigation == navigation::smart) ? kUndefined : kXAxis,
+                                                              _crop_nx * _crop_ny * _crop_nz,
                                                               phantom);
     // if axis is set as kUndefined instead of kXAxis, GEANT4 will
     //  do an smart voxel optimisation
@@ -240,8 +702,146 @@ void Detector::make_phantom()
 
     //----- Set this physical volume as having a regular structure of type 1,
     // so that G4RegularNavigation is used
-    phantom_phys->SetRegularStructureId(1); // if not set, G4VoxelNavigation
+    if (_navigation == navigation::regular)
+        phantom_phys->SetRegularStructureId(1); // if not set, G4VoxelNavigation
     //will be used instead
 
     set_scorer(voxel_logic);
 }
+
+void Detector::make_nested_phantom()
+{
+    //----- Y slices, each is a row of X columns, each is a column of Z voxels
+    G4Box* y_solid = new G4Box( "phantomYRep",
+                                0.5 * _crop_nx * voxel_x(), 0.5 * voxel_y(), 0.5 * _crop_nz * voxel_z() );
+    G4LogicalVolume* y_logic = new G4LogicalVolume( y_solid, _Air, "phantomYRepLogical" );
+    new G4PVReplica( "phantomYRep", y_logic, _container_logic, kYAxis, _crop_ny, voxel_y() );
+
+    G4Box* x_solid = new G4Box( "phantomXRep",
+                                0.5 * voxel_x(), 0.5 * voxel_y(), 0.5 * _crop_nz * voxel_z() );
+    G4LogicalVolume* x_logic = new G4LogicalVolume( x_solid, _Air, "phantomXRepLogical" );
+    new G4PVReplica( "phantomXRep", x_logic, y_logic, kXAxis, _crop_nx, voxel_x() );
+
+    y_logic->SetVisAttributes(new G4VisAttributes(G4VisAttributes::Invisible));
+    x_logic->SetVisAttributes(new G4VisAttributes(G4VisAttributes::Invisible));
+
+    //----- Define voxel logical volume, material comes from the parameterisation
+    G4Box* voxel_solid = new G4Box( "Voxel",
+                                    0.5 * voxel_x(), 0.5 * voxel_y(), 0.5 * voxel_z() );
+    G4LogicalVolume* voxel_logic = new G4LogicalVolume( voxel_solid, _materials[0], "VoxelLogical", 0, 0, 0 );
+
+    voxel_logic->SetVisAttributes(new G4VisAttributes(G4VisAttributes::Invisible));
+
+    NestedPhantom* phantom = new NestedPhantom( _materials, _mat_IDs, _crop_nx, _crop_ny, _crop_nz, voxel_z() );
+
+    // kUndefined lets GEANT4 build smart voxels along the column
+    new G4PVParameterised( "phantom", voxel_logic, x_logic, kUndefined, _crop_nz, phantom );
+
+    set_scorer(voxel_logic);
+}
+
+void Detector::make_multires_phantom()
+{
+    if (_navigation != navigation::regular)
+        G4Exception("Detector", "003", JustWarning, "Phantom with FINEBOX always uses regular navigation");
+
+    int nx = nofv_x();
+    int ny = nofv_y();
+    int nz = nofv_z();
+
+    int x0 = _phs.fine_x0();
+    int y0 = _phs.fine_y0();
+    int z0 = _phs.fine_z0();
+    int x1 = x0 + _phs.fine_nx();
+    int y1 = y0 + _phs.fine_ny();
+    int z1 = z0 + _phs.fine_nz();
+
+    //----- Fine box goes first, then slabs of grid voxels filling the rest:
+    // whole YZ planes on both sides in X, then what is left on both sides
+    // in Y, then on both sides in Z. Empty slabs are not built
+    _blocks.push_back(DoseScorer::block{ x0, y0, z0,
+                                         _phs.fine_nofv_x(), _phs.fine_nofv_y(), _phs.fine_nofv_z(),
+                                         _phs.fine_factor() });
+
+    std::vector<DoseScorer::block> slabs{
+        { 0,  0,  0,  x0,      ny,      nz,      1 },
+        { x1, 0,  0,  nx - x1, ny,      nz,      1 },
+        { x0, 0,  0,  x1 - x0, y0,      nz,      1 },
+        { x0, y1, 0,  x1 - x0, ny - y1, nz,      1 },
+        { x0, y0, 0,  x1 - x0, y1 - y0, z0,      1 },
+        { x0, y0, z1, x1 - x0, y1 - y0, nz - z1, 1 } };
+
+    for(const auto& b: slabs)
+    {
+        if (b.nx > 0 && b.ny > 0 && b.nz > 0)
+            _blocks.push_back(b);
+    }
+
+    for(int k = 0; k != int(_blocks.size()); ++k)
+        make_block(k, _blocks[k]);
+}
+
+void Detector::make_block(int copy_no, const DoseScorer::block& b)
+{
+    double vx = voxel_x() / b.factor;
+    double vy = voxel_y() / b.factor;
+    double vz = voxel_z() / b.factor;
+
+    //----- Block container, where the block is in the grid
+    G4Box* block_solid = new G4Box( "phantomBlock",
+                                    0.5 * b.nx * vx, 0.5 * b.ny * vy, 0.5 * b.nz * vz );
+    G4LogicalVolume* block_logic = new G4LogicalVolume( block_solid, _Air, "phantomBlockLogical" );
+
+    G4ThreeVector pos( b.x0 * voxel_x() + 0.5 * b.nx * vx - 0.5 * cube_x(),
+                       b.y0 * voxel_y() + 0.5 * b.ny * vy - 0.5 * cube_y(),
+                       b.z0 * voxel_z() + 0.5 * b.nz * vz - 0.5 * cube_z() );
+
+    G4VPhysicalVolume* block_phys = new G4PVPlacement( nullptr, pos, block_logic, "phantomBlock",
+                                                       _container_logic, false, copy_no );
+
+    block_logic->SetVisAttributes(new G4VisAttributes(G4VisAttributes::Invisible));
+
+    //----- Material of fine voxel is the one of its grid voxel
+    _block_mat_index.emplace_back();
+    size_t* mat_IDs = nullptr;
+    if (_phs.has_materials())
+    {
+        auto& index = _block_mat_index.back();
+        index.reserve(size_t(b.nx) * b.ny * b.nz);
+        for(int iz = 0; iz != b.nz; ++iz)
+        {
+            for(int iy = 0; iy != b.ny; ++iy)
+            {
+                for(int ix = 0; ix != b.nx; ++ix)
+                {
+                    size_t m = size_t(_phs.material(_phs.idx(b.x0 + ix/b.factor, b.y0 + iy/b.factor, b.z0 + iz/b.factor)));
+                    index.push_back((m < _materials.size()) ? m : 0);
+                }
+            }
+        }
+        mat_IDs = index.data();
+    }
+
+    //----- Regular parameterisation of the block, as in make_phantom()
+    Phantom* phantom = new Phantom();
+    phantom->SetVoxelDimensions( 0.5 * vx, 0.5 * vy, 0.5 * vz );
+    phantom->SetNoVoxel( b.nx, b.ny, b.nz );
+    phantom->SetMaterials( _materials );
+    phantom->SetMaterialIndices( mat_IDs );
+
+    G4Box* voxel_solid = new G4Box( "Voxel", 0.5 * vx, 0.5 * vy, 0.5 * vz );
+    G4LogicalVolume* voxel_logic = new G4LogicalVolume( voxel_solid, _materials[0], "VoxelLogical", 0, 0, 0 );
+
+    voxel_logic->SetVisAttributes(new G4VisAttributes(G4VisAttributes::Invisible));
+
+    phantom->BuildContainerSolid(block_phys);
+    phantom->CheckVoxelsFillContainer( block_solid->GetXHalfLength(),
+                                       block_solid->GetYHalfLength(),
+                                       block_solid->GetZHalfLength() );
+
+    G4PVParameterised* phantom_phys = new G4PVParameterised( "phantom", voxel_logic, block_logic,
+                                                             kXAxis, b.nx * b.ny * b.nz, phantom );
+    phantom_phys->SetRegularStructureId(1);
+
+    set_scorer(voxel_logic);
+}
@@ -0,0 +1,207 @@
+#include "DetectorMessenger.hh"
+#include "Detector.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+
+DetectorMessenger::DetectorMessenger(Detector* detector):
+    _detector{detector},
+    _geometry_directory{nullptr},
+    _navigation_cmd{nullptr},
+    _autocrop_cmd{nullptr},
+    _auto_cuts_cmd{nullptr},
+    _cut_fraction_cmd{nullptr},
+    _world_cut_cmd{nullptr},
+    _range_rejection_cmd{nullptr},
+    _collimator_directory{nullptr},
+    _collimator_cmd{nullptr},
+    _col_length_cmd{nullptr},
+    _col_exit_distance_cmd{nullptr},
+    _col_entrance_radius_cmd{nullptr},
+    _col_exit_radius_cmd{nullptr},
+    _col_outer_radius_cmd{nullptr}
+{
+    _geometry_directory = new G4UIdirectory("/GP/geometry/");
+    _geometry_directory->SetGuidance("Phantom geometry");
+
+    // geometry is built on master, workers pick it up on reinitialization
+    _navigation_cmd = new G4UIcmdWithAString("/GP/geometry/navigation", this);
+    _navigation_cmd->SetGuidance("Phantom geometry and navigation strategy,");
+    _navigation_cmd->SetGuidance("in idle state geometry is rebuilt before the next run");
+    _navigation_cmd->SetParameterName("navigation", false);
+    _navigation_cmd->SetCandidates("regular smart xaxis nested");
+    _navigation_cmd->SetToBeBroadcasted(false);
+    _navigation_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _autocrop_cmd = new G4UIcmdWithABool("/GP/geometry/autocrop", this);
+    _autocrop_cmd->SetGuidance("Build only the box of non-air voxels, needs MATERIALS in phantom header");
+    _autocrop_cmd->SetParameterName("autocrop", true);
+    _autocrop_cmd->SetDefaultValue(true);
+    _autocrop_cmd->SetToBeBroadcasted(false);
+    _autocrop_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    // physics list sets the world cuts at initialization, so cuts are set after it
+    _auto_cuts_cmd = new G4UIcmdWithABool("/GP/geometry/auto_cuts", this);
+    _auto_cuts_cmd->SetGuidance("Set production cuts from voxel size, phantom and world air separately,");
+    _auto_cuts_cmd->SetGuidance("set them before /GP/physics/cache_dir");
+    _auto_cuts_cmd->SetParameterName("autoCuts", true);
+    _auto_cuts_cmd->SetDefaultValue(true);
+    _auto_cuts_cmd->SetToBeBroadcasted(false);
+    _auto_cuts_cmd->AvailableForStates(G4State_Idle);
+
+    _cut_fraction_cmd = new G4UIcmdWithADouble("/GP/geometry/cut_fraction", this);
+    _cut_fraction_cmd->SetGuidance("Set phantom production cut as fraction of the smallest voxel side");
+    _cut_fraction_cmd->SetParameterName("cutFraction", false);
+    _cut_fraction_cmd->SetRange("cutFraction>0.0");
+    _cut_fraction_cmd->SetToBeBroadcasted(false);
+    _cut_fraction_cmd->AvailableForStates(G4State_Idle);
+
+    _world_cut_cmd = new G4UIcmdWithADoubleAndUnit("/GP/geometry/world_cut", this);
+    _world_cut_cmd->SetGuidance("Set production cut of the world air with auto cuts");
+    _world_cut_cmd->SetParameterName("worldCut", false);
+    _world_cut_cmd->SetDefaultUnit("mm");
+    _world_cut_cmd->SetUnitCandidates("mm cm m");
+    _world_cut_cmd->SetRange("worldCut>0.0");
+    _world_cut_cmd->SetToBeBroadcasted(false);
+    _world_cut_cmd->AvailableForStates(G4State_Idle);
+
+    _range_rejection_cmd = new G4UIcmdWithABool("/GP/geometry/range_rejection", this);
+    _range_rejection_cmd->SetGuidance("Deposit electrons which range cannot take out of their voxel on the spot");
+    _range_rejection_cmd->SetParameterName("rangeRejection", true);
+    _range_rejection_cmd->SetDefaultValue(true);
+    _range_rejection_cmd->SetToBeBroadcasted(false);
+    _range_rejection_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _collimator_directory = new G4UIdirectory("/GP/collimator/");
+    _collimator_directory->SetGuidance("First stage: single collimator channel instead of the phantom");
+
+    _collimator_cmd = new G4UIcmdWithABool("/GP/collimator/enable", this);
+    _collimator_cmd->SetGuidance("Build one collimator channel on -X axis and its exit disc instead of the phantom,");
+    _collimator_cmd->SetGuidance("with /GP/phsp/capture the run writes phase space at the collimator exit");
+    _collimator_cmd->SetParameterName("collimatorEnable", true);
+    _collimator_cmd->SetDefaultValue(true);
+    _collimator_cmd->SetToBeBroadcasted(false);
+    _collimator_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _col_length_cmd          = make_length_cmd("/GP/collimator/length",          "Set collimator length along the channel",           "colLength");
+    _col_exit_distance_cmd   = make_length_cmd("/GP/collimator/exit_distance",   "Set distance from the isocentre to collimator exit", "colExitDistance");
+    _col_entrance_radius_cmd = make_length_cmd("/GP/collimator/entrance_radius", "Set channel radius at the source side",             "colEntranceRadius");
+    _col_exit_radius_cmd     = make_length_cmd("/GP/collimator/exit_radius",     "Set channel radius at the exit",                    "colExitRadius");
+    _col_outer_radius_cmd    = make_length_cmd("/GP/collimator/outer_radius",    "Set collimator outer radius",                       "colOuterRadius");
+}
+
+G4UIcmdWithADoubleAndUnit* DetectorMessenger::make_length_cmd(const char* name, const char* guidance, const char* parameter)
+{
+    auto* cmd = new G4UIcmdWithADoubleAndUnit(name, this);
+    cmd->SetGuidance(guidance);
+    cmd->SetParameterName(parameter, false);
+    cmd->SetDefaultUnit("mm");
+    cmd->SetUnitCandidates("mm cm");
+    cmd->SetRange((std::string{parameter} + ">0.0").c_str());
+    cmd->SetToBeBroadcasted(false);
+    cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    return cmd;
+}
+
+DetectorMessenger::~DetectorMessenger()
+{
+    delete _navigation_cmd;
+    delete _autocrop_cmd;
+
+    delete _auto_cuts_cmd;
+    delete _cut_fraction_cmd;
+    delete _world_cut_cmd;
+    delete _range_rejection_cmd;
+
+    delete _collimator_cmd;
+    delete _col_length_cmd;
+    delete _col_exit_distance_cmd;
+    delete _col_entrance_radius_cmd;
+    delete _col_exit_radius_cmd;
+    delete _col_outer_radius_cmd;
+
+    delete _collimator_directory;
+    delete _geometry_directory;
+}
+
+void DetectorMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _navigation_cmd)
+    {
+        Detector::navigation nav;
+        if (Detector::navigation_from_name(value, nav))
+            _detector->set_navigation(nav);
+        return;
+    }
+
+    if (cmd == _autocrop_cmd)
+    {
+        _detector->set_autocrop(_autocrop_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _auto_cuts_cmd)
+    {
+        _detector->set_auto_cuts(_auto_cuts_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _cut_fraction_cmd)
+    {
+        _detector->set_cut_fraction(_cut_fraction_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _world_cut_cmd)
+    {
+        _detector->set_world_cut(_world_cut_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _range_rejection_cmd)
+    {
+        _detector->set_range_rejection(_range_rejection_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _collimator_cmd)
+    {
+        _detector->set_collimator(_collimator_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _col_length_cmd)
+    {
+        _detector->set_col_length(_col_length_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _col_exit_distance_cmd)
+    {
+        _detector->set_col_exit_distance(_col_exit_distance_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _col_entrance_radius_cmd)
+    {
+        _detector->set_col_entrance_radius(_col_entrance_radius_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _col_exit_radius_cmd)
+    {
+        _detector->set_col_exit_radius(_col_exit_radius_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _col_outer_radius_cmd)
+    {
+        _detector->set_col_outer_radius(_col_outer_radius_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    return;
+}
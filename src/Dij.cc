@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <fstream>
+
+#include "Dij.hh"
+#include "DijMessenger.hh"
+#include "DoseMatrix.hh"
+
+Dij* Dij::_instance = nullptr;
+
+Dij* Dij::Instance()
+{
+    return _instance;
+}
+
+Dij::Dij():
+    _messenger{nullptr},
+    _enabled{false},
+    _fname{"dij.bin"}
+{
+    _instance  = this;
+    _messenger = new DijMessenger(this);
+}
+
+Dij::~Dij()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+void Dij::write(const DoseMatrix& dm, int64_t nof_histories) const
+{
+    if (dm.empty())
+    {
+        G4Exception("Dij", "001", JustWarning, "Dose influence matrix is empty, nothing written");
+        return;
+    }
+
+    // write and rename, so readers never see half written matrix
+    std::string tmp_name = _fname + ".tmp";
+    {
+        std::ofstream os(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!os.is_open())
+        {
+            G4Exception("Dij", "002", JustWarning, ("Cannot open " + tmp_name).c_str());
+            return;
+        }
+        dm.write(os, nof_histories);
+        if (!os)
+        {
+            G4Exception("Dij", "003", JustWarning, ("Failed writing " + tmp_name).c_str());
+            return;
+        }
+    }
+
+    if (std::rename(tmp_name.c_str(), _fname.c_str()) != 0)
+    {
+        G4Exception("Dij", "004", JustWarning, ("Cannot rename " + tmp_name + " to " + _fname).c_str());
+        return;
+    }
+
+    G4cout << "Dij: " << dm.nof_srcs() << " sources, " << dm.nof_nonzeros()
+           << " nonzeros written to " << _fname << G4endl;
+}
@@ -0,0 +1,55 @@
+#include "DijMessenger.hh"
+#include "Dij.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+
+DijMessenger::DijMessenger(Dij* dij):
+    _dij{dij},
+    _dij_directory{nullptr},
+    _enable_cmd{nullptr},
+    _fname_cmd{nullptr}
+{
+    _dij_directory = new G4UIdirectory("/GP/dij/");
+    _dij_directory->SetGuidance("Per-source dose influence matrix scoring");
+
+    // settings are shared by all threads, no need to send commands to workers
+    _enable_cmd = new G4UIcmdWithABool("/GP/dij/enable", this);
+    _enable_cmd->SetGuidance("Score dose influence matrix, source by voxel");
+    _enable_cmd->SetParameterName("dijEnable", true);
+    _enable_cmd->SetDefaultValue(true);
+    _enable_cmd->SetToBeBroadcasted(false);
+    _enable_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _fname_cmd = new G4UIcmdWithAString("/GP/dij/fname", this);
+    _fname_cmd->SetGuidance("Set dose influence matrix file name");
+    _fname_cmd->SetParameterName("dijFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+DijMessenger::~DijMessenger()
+{
+    delete _enable_cmd;
+    delete _fname_cmd;
+
+    delete _dij_directory;
+}
+
+void DijMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _enable_cmd)
+    {
+        _dij->set_enabled(_enable_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _fname_cmd)
+    {
+        _dij->set_fname(value);
+        return;
+    }
+
+    return;
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "G4SystemOfUnits.hh"
+
+#include "DoseGrid.hh"
+
+DoseGrid::DoseGrid():
+    _nofv_x{0},
+    _nofv_y{0},
+    _nofv_z{0},
+
+    _dose{},
+    _dose2{},
+
+    _nof_events{0}
+{
+}
+
+DoseGrid::DoseGrid(int nofv_x, int nofv_y, int nofv_z):
+    _nofv_x{nofv_x},
+    _nofv_y{nofv_y},
+    _nofv_z{nofv_z},
+
+    _dose(size_t(nofv_x) * size_t(nofv_y) * size_t(nofv_z), 0.0),
+    _dose2(size_t(nofv_x) * size_t(nofv_y) * size_t(nofv_z), 0.0),
+
+    _nof_events{0}
+{
+}
+
+DoseGrid::DoseGrid(const PhantomSetup& phs):
+    DoseGrid(phs.nofv_x(), phs.nofv_y(), phs.nofv_z())
+{
+}
+
+double DoseGrid::sigma(int idx) const
+{
+    if (_nof_events < 2)
+        return 0.0;
+
+    double n    = double(_nof_events);
+    double mean = _dose[idx] / n;
+    double var  = (_dose2[idx] / n - mean*mean) / (n - 1.0);
+
+    return (var > 0.0) ? sqrt(var) : 0.0;
+}
+
+double DoseGrid::total_dose() const
+{
+    double total = 0.0;
+    for(auto d: _dose)
+        total += d;
+
+    return total;
+}
+
+void DoseGrid::merge(const DoseGrid& grid)
+{
+    if (_dose.empty())
+    {
+        *this = grid;
+        return;
+    }
+
+    if (!same_shape(grid))
+        return;
+
+    for(size_t k = 0; k != _dose.size(); ++k)
+    {
+        _dose[k]  += grid._dose[k];
+        _dose2[k] += grid._dose2[k];
+    }
+    _nof_events += grid._nof_events;
+}
+
+void DoseGrid::clear()
+{
+    std::fill(_dose.begin(),  _dose.end(),  0.0);
+    std::fill(_dose2.begin(), _dose2.end(), 0.0);
+    _nof_events = 0;
+}
+
+void DoseGrid::write(std::ostream& os) const
+{
+    int32_t dims[3] = { _nofv_x, _nofv_y, _nofv_z };
+
+    os.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    os.write(reinterpret_cast<const char*>(&_nof_events), sizeof(_nof_events));
+    os.write(reinterpret_cast<const char*>(_dose.data()),  _dose.size()  * sizeof(double));
+    os.write(reinterpret_cast<const char*>(_dose2.data()), _dose2.size() * sizeof(double));
+}
+
+bool DoseGrid::read(std::istream& is)
+{
+    int32_t dims[3] = { 0, 0, 0 };
+    int64_t nof_events = 0;
+
+    is.read(reinterpret_cast<char*>(dims), sizeof(dims));
+    is.read(reinterpret_cast<char*>(&nof_events), sizeof(nof_events));
+    if (!is || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0)
+        return false;
+
+    DoseGrid grid(dims[0], dims[1], dims[2]);
+    grid._nof_events = nof_events;
+
+    is.read(reinterpret_cast<char*>(grid._dose.data()),  grid._dose.size()  * sizeof(double));
+    is.read(reinterpret_cast<char*>(grid._dose2.data()), grid._dose2.size() * sizeof(double));
+    if (!is)
+        return false;
+
+    *this = std::move(grid);
+    return true;
+}
+
+void DoseGrid::write_dose_out(std::ostream& os, int key_offset) const
+{
+    for(size_t k = 0; k != _dose.size(); ++k)
+    {
+        if (_dose[k] != 0.0)
+        {
+            os << (int(k) + key_offset)
+               << "     " << _dose[k]/CLHEP::gray
+               << std::endl;
+        }
+    }
+}
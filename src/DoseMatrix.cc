@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <iostream>
+
+#include "G4SystemOfUnits.hh"
+
+#include "DoseMatrix.hh"
+
+DoseMatrix::DoseMatrix():
+    _nof_srcs{0},
+    _nofv_x{0},
+    _nofv_y{0},
+    _nofv_z{0},
+
+    _keys{},
+    _dose{},
+
+    _pending{}
+{
+}
+
+DoseMatrix::DoseMatrix(int nof_srcs, int nofv_x, int nofv_y, int nofv_z):
+    _nof_srcs{nof_srcs},
+    _nofv_x{nofv_x},
+    _nofv_y{nofv_y},
+    _nofv_z{nofv_z},
+
+    _keys{},
+    _dose{},
+
+    _pending{}
+{
+}
+
+void DoseMatrix::compact()
+{
+    if (_pending.empty())
+        return;
+
+    std::sort(_pending.begin(), _pending.end(), [](const entry& a, const entry& b) { return a.key < b.key; });
+
+    std::vector<int64_t> keys;
+    std::vector<double>  dose;
+    keys.reserve(_keys.size() + _pending.size());
+    dose.reserve(_keys.size() + _pending.size());
+
+    // merge of two sorted lists, equal keys are summed
+    auto push = [&](int64_t key, double d)
+    {
+        if (!keys.empty() && keys.back() == key)
+        {
+            dose.back() += d;
+            return;
+        }
+        keys.push_back(key);
+        dose.push_back(d);
+    };
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i != _keys.size() || j != _pending.size())
+    {
+        if (j == _pending.size() || (i != _keys.size() && _keys[i] <= _pending[j].key))
+        {
+            push(_keys[i], _dose[i]);
+            ++i;
+        }
+        else
+        {
+            push(_pending[j].key, _pending[j].dose);
+            ++j;
+        }
+    }
+
+    _keys.swap(keys);
+    _dose.swap(dose);
+    _pending.clear();
+}
+
+void DoseMatrix::merge(const DoseMatrix& dm)
+{
+    if (empty())
+    {
+        *this = dm;
+        compact();
+        return;
+    }
+
+    if (dm._nof_srcs != _nof_srcs || dm.nof_voxels() != nof_voxels())
+        return;
+
+    _pending.reserve(_pending.size() + dm._keys.size() + dm._pending.size());
+    for(size_t k = 0; k != dm._keys.size(); ++k)
+        _pending.push_back(entry{dm._keys[k], dm._dose[k]});
+    _pending.insert(_pending.end(), dm._pending.cbegin(), dm._pending.cend());
+
+    compact();
+}
+
+void DoseMatrix::clear()
+{
+    _keys.clear();
+    _dose.clear();
+    _pending.clear();
+}
+
+void DoseMatrix::write(std::ostream& os, int64_t nof_histories) const
+{
+    if (!_pending.empty())
+    {
+        DoseMatrix dm{*this};
+        dm.compact();
+        dm.write(os, nof_histories);
+        return;
+    }
+
+    const char magic[8] = { 'P', 'H', 'D', 'I', 'J', '0', '0', '1' };
+    int32_t dims[4]     = { _nof_srcs, _nofv_x, _nofv_y, _nofv_z };
+    int64_t nnz         = int64_t(_keys.size());
+
+    os.write(magic, sizeof(magic));
+    os.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    os.write(reinterpret_cast<const char*>(&nof_histories), sizeof(nof_histories));
+    os.write(reinterpret_cast<const char*>(&nnz), sizeof(nnz));
+
+    // keys are sorted by source, so row starts are found with one pass
+    std::vector<int64_t> row_start(_nof_srcs + 1, nnz);
+    int64_t nvox = int64_t(nof_voxels());
+    int64_t k = 0;
+    for(int s = 0; s != _nof_srcs; ++s)
+    {
+        while (k != nnz && _keys[k] < int64_t(s) * nvox)
+            ++k;
+        row_start[s] = k;
+    }
+    row_start[_nof_srcs] = nnz;
+    os.write(reinterpret_cast<const char*>(row_start.data()), row_start.size() * sizeof(int64_t));
+
+    std::vector<int32_t> voxel(nnz);
+    std::vector<float>   dose(nnz);
+    double norm = (nof_histories > 0) ? 1.0 / (double(nof_histories) * gray) : 1.0 / gray;
+    for(k = 0; k != nnz; ++k)
+    {
+        voxel[k] = int32_t(_keys[k] % nvox);
+        dose[k]  = float(_dose[k] * norm);
+    }
+    os.write(reinterpret_cast<const char*>(voxel.data()), voxel.size() * sizeof(int32_t));
+    os.write(reinterpret_cast<const char*>(dose.data()),  dose.size()  * sizeof(float));
+}
@@ -0,0 +1,182 @@
+#include "DoseScorer.hh"
+#include "Run.hh"
+#include "Dij.hh"
+#include "ListMode.hh"
+#include "Profiler.hh"
+
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Material.hh"
+#include "G4TouchableHistory.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4THitsMap.hh"
+#include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+
+DoseScorer::DoseScorer(const G4String& name, int nofv_x, int nofv_y, int nofv_z):
+    G4PSDoseDeposit3D{name, nofv_x, nofv_y, nofv_z},
+    _key_offset{nofv_z},
+    _nofv_x{nofv_x},
+    _nofv_y{nofv_y},
+    _nofv_z{nofv_z},
+    _nested{false},
+    _cropped{false},
+    _crop_x0{0},
+    _crop_y0{0},
+    _crop_z0{0},
+    _crop_nx{nofv_x},
+    _crop_ny{nofv_y},
+    _blocks{},
+    _fine_base{nofv_z + nofv_x*nofv_y*nofv_z},
+    _evt_map{nullptr}
+{
+}
+
+DoseScorer::~DoseScorer()
+{
+}
+
+void DoseScorer::Initialize(G4HCofThisEvent* HCE)
+{
+    G4PSDoseDeposit3D::Initialize(HCE);
+
+    // base keeps its event map to itself, the same map is in the event collections
+    _evt_map = static_cast<G4THitsMap<double>*>(HCE->GetHC(GetCollectionID(0)));
+}
+
+G4bool DoseScorer::ProcessHits(G4Step* aStep, G4TouchableHistory* aTH)
+{
+    PH_PROFILE_SCOPE(SCORING);
+
+    auto* dij       = Dij::Instance();
+    auto* list_mode = ListMode::Instance();
+    bool  dij_on    = dij != nullptr && dij->enabled();
+    bool  list_on   = list_mode != nullptr && list_mode->enabled();
+    if (!dij_on && !list_on && _blocks.empty())
+        return G4PSDoseDeposit3D::ProcessHits(aStep, aTH);
+
+    // the same dose as G4PSDoseDeposit puts into the hits map,
+    // also given to the dose influence matrix row of the current source
+    // and to the list-mode stream
+    double edep = aStep->GetTotalEnergyDeposit();
+    if (edep == 0.0)
+        return false;
+
+    score(aStep, edep);
+    return true;
+}
+
+void DoseScorer::deposit(const G4Step* aStep, double edep)
+{
+    PH_PROFILE_SCOPE(SCORING);
+
+    if (_evt_map != nullptr && edep > 0.0)
+        score(const_cast<G4Step*>(aStep), edep);
+}
+
+void DoseScorer::score(G4Step* aStep, double edep)
+{
+    auto* dij       = Dij::Instance();
+    auto* list_mode = ListMode::Instance();
+    bool  dij_on    = dij != nullptr && dij->enabled();
+    bool  list_on   = list_mode != nullptr && list_mode->enabled();
+
+    G4StepPoint* preStep = aStep->GetPreStepPoint();
+
+    int    replica = static_cast<const G4TouchableHistory*>(preStep->GetTouchable())->GetReplicaNumber(indexDepth);
+    double dose    = edep / (preStep->GetMaterial()->GetDensity() * ComputeVolume(aStep, replica));
+    dose *= preStep->GetWeight();
+
+    int index = GetIndex(aStep);
+    _evt_map->add(index, dose);
+
+    // fine voxel dose also goes to its grid voxel, weighted by the volume share
+    if (index >= _fine_base)
+    {
+        const block& fine = _blocks[0];
+
+        int copy = index - _fine_base;
+        int ix   = copy % fine.nx;
+        copy     = copy / fine.nx;
+        int iy   = copy % fine.ny;
+        int iz   = copy / fine.ny;
+
+        index = _key_offset + (fine.x0 + ix/fine.factor) + _nofv_x*((fine.y0 + iy/fine.factor) + _nofv_y*(fine.z0 + iz/fine.factor));
+        dose /= double(fine.factor * fine.factor * fine.factor);
+        _evt_map->add(index, dose);
+    }
+
+    if (!dij_on && !list_on)
+        return;
+
+    auto* run = static_cast<Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
+    if (run == nullptr)
+        return;
+
+    if (dij_on)
+        run->score_dij(index - _key_offset, dose);
+
+    // energy and density rather than dose, so any grid can be made of it
+    if (list_on && run->list_mode())
+    {
+        G4ThreeVector p = 0.5*(preStep->GetPosition() + aStep->GetPostStepPoint()->GetPosition());
+        run->record_list_mode(float(p.x()/mm), float(p.y()/mm), float(p.z()/mm),
+                              float(edep*preStep->GetWeight()/MeV), float(preStep->GetMaterial()->GetDensity()/(g/cm3)));
+    }
+}
+
+void DoseScorer::set_crop(int x0, int y0, int z0, int nx, int ny, int nz)
+{
+    _crop_x0 = x0;
+    _crop_y0 = y0;
+    _crop_z0 = z0;
+    _crop_nx = nx;
+    _crop_ny = ny;
+
+    _cropped = (x0 != 0 || y0 != 0 || z0 != 0 || nx != _nofv_x || ny != _nofv_y || nz != _nofv_z);
+}
+
+G4int DoseScorer::GetIndex(G4Step* aStep)
+{
+    if (!_nested && !_cropped && _blocks.empty())
+        return G4PSDoseDeposit3D::GetIndex(aStep);
+
+    const G4VTouchable* touchable = aStep->GetPreStepPoint()->GetTouchable();
+
+    if (!_blocks.empty())
+    {
+        // voxel copy inside the block, block is the first one of fine voxels
+        int copy = touchable->GetReplicaNumber(0);
+        int k    = touchable->GetReplicaNumber(1);
+        if (_blocks[k].factor > 1)
+            return _fine_base + copy;
+
+        const block& b = _blocks[k];
+
+        int ix = copy % b.nx;
+        copy   = copy / b.nx;
+        int iy = copy % b.ny;
+        int iz = copy / b.ny;
+
+        return _key_offset + (b.x0 + ix) + _nofv_x*((b.y0 + iy) + _nofv_y*(b.z0 + iz));
+    }
+
+    int ix, iy, iz;
+    if (_nested)
+    {
+        // Z voxel, X column and Y slice replica numbers
+        iz = touchable->GetReplicaNumber(0);
+        ix = touchable->GetReplicaNumber(1);
+        iy = touchable->GetReplicaNumber(2);
+    }
+    else
+    {
+        int copy = touchable->GetReplicaNumber(0);
+        ix   = copy % _crop_nx;
+        copy = copy / _crop_nx;
+        iy   = copy % _crop_ny;
+        iz   = copy / _crop_ny;
+    }
+
+    return _key_offset + (_crop_x0 + ix) + _nofv_x*((_crop_y0 + iy) + _nofv_y*(_crop_z0 + iz));
+}
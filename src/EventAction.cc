@@ -5,6 +5,7 @@
 #include "G4Event.hh"
 #include "RunAction.hh"
 #include "Run.hh"
+#include "Profiler.hh"
 
 EventAction::EventAction():
     G4UserEventAction{},
@@ -19,8 +20,11 @@ EventAction::~EventAction()
 void EventAction::BeginOfEventAction(const G4Event*)
 {
     // G4cout << "EV: " << evt->GetEventID() << G4endl;
+
+    PH_PROFILE_START(TRACKING);
 }
 
 void EventAction::EndOfEventAction(const G4Event*)
 {
+    PH_PROFILE_STOP(TRACKING);
 }
@@ -0,0 +1,122 @@
+#include <cfloat>
+
+#include "ForcedCollision.hh"
+
+#include "G4Track.hh"
+#include "G4Step.hh"
+#include "G4Gamma.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ProcessManager.hh"
+#include "G4ProcessVector.hh"
+#include "G4VEmProcess.hh"
+#include "G4VUserTrackInformation.hh"
+
+#include "Randomize.hh"
+
+// marks the photon to interact, cleared when it does
+class ForcedCollisionInfo : public G4VUserTrackInformation
+{
+    public: bool pending = true;
+};
+
+ForcedCollision::ForcedCollision():
+    G4VDiscreteProcess{"forcedCollision", fGeneral},
+    _processes{},
+    _sigma{},
+    _change{}
+{
+}
+
+ForcedCollision::~ForcedCollision()
+{
+}
+
+G4bool ForcedCollision::IsApplicable(const G4ParticleDefinition& particle)
+{
+    return &particle == G4Gamma::Gamma();
+}
+
+void ForcedCollision::mark(G4Track* track)
+{
+    track->SetUserInformation(new ForcedCollisionInfo);
+}
+
+G4double ForcedCollision::PostStepGetPhysicalInteractionLength(const G4Track& track, G4double, G4ForceCondition* condition)
+{
+    *condition = NotForced;
+
+    // the only info photons get is ours, the cast is safe
+    auto* info = static_cast<ForcedCollisionInfo*>(track.GetUserInformation());
+    return (info != nullptr && info->pending) ? 0.0 : DBL_MAX;
+}
+
+G4double ForcedCollision::GetMeanFreePath(const G4Track&, G4double, G4ForceCondition* condition)
+{
+    *condition = NotForced;
+    return DBL_MAX;
+}
+
+G4VParticleChange* ForcedCollision::PostStepDoIt(const G4Track& track, const G4Step& step)
+{
+    static_cast<ForcedCollisionInfo*>(track.GetUserInformation())->pending = false;
+
+    if (_processes.empty())
+    {
+        G4ProcessVector* list = track.GetDefinition()->GetProcessManager()->GetProcessList();
+        for(G4int k = 0; k != list->entries(); ++k)
+        {
+            auto* process = dynamic_cast<G4VEmProcess*>((*list)[k]);
+            if (process != nullptr)
+                _processes.push_back(process);
+        }
+        _sigma.resize(_processes.size());
+    }
+
+    // every process has seen this step in its PostStepGetPhysicalInteractionLength,
+    // so its DoIt finds the material and model of the point
+    double e     = track.GetKineticEnergy();
+    double total = 0.0;
+    for(size_t k = 0; k != _processes.size(); ++k)
+    {
+        _sigma[k] = _processes[k]->CrossSectionPerVolume(e, track.GetMaterialCutsCouple());
+        total    += _sigma[k];
+    }
+
+    // rounding may leave u over the last one, it takes it then
+    G4VEmProcess* chosen = nullptr;
+    double u = G4UniformRand() * total;
+    for(size_t k = 0; k != _processes.size(); ++k)
+    {
+        if (_sigma[k] <= 0.0)
+            continue;
+        chosen = _processes[k];
+        u     -= _sigma[k];
+        if (u < 0.0)
+            break;
+    }
+    if (chosen != nullptr)
+        return chosen->PostStepDoIt(track, step);
+
+    // photon goes on unchanged
+    _change.Initialize(track);
+    return &_change;
+}
+
+ForcedCollisionPhysics::ForcedCollisionPhysics():
+    G4VPhysicsConstructor{"ForcedCollision"}
+{
+}
+
+ForcedCollisionPhysics::~ForcedCollisionPhysics()
+{
+}
+
+void ForcedCollisionPhysics::ConstructParticle()
+{
+    G4Gamma::Gamma();
+}
+
+void ForcedCollisionPhysics::ConstructProcess()
+{
+    G4Gamma::Gamma()->GetProcessManager()->AddDiscreteProcess(new ForcedCollision);
+}
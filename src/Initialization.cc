@@ -3,6 +3,9 @@
 #include "Source.hh"
 #include "RunAction.hh"
 #include "EventAction.hh"
+#include "SteppingAction.hh"
+#include "StackingAction.hh"
+#include "TrackingAction.hh"
 
 Initialization::Initialization():
     G4VUserActionInitialization()
@@ -20,8 +23,19 @@ void Initialization::BuildForMaster() const
 
 void Initialization::Build() const
 {
-    SetUserAction(new Source);
+    auto* source = new Source;
+
+    SetUserAction(source);
     SetUserAction(new RunAction);
     SetUserAction(new EventAction);
+    SetUserAction(new TrackingAction(source));
+
+    // step counting and variance reduction, both do nothing when off
+    SetUserAction(make_stepping_action(source));
+    SetUserAction(new StackingAction(source));
 }
 
+G4UserSteppingAction* Initialization::make_stepping_action(const Source* source) const
+{
+    return new SteppingAction(source);
+}
@@ -0,0 +1,25 @@
+#include "ListMode.hh"
+#include "ListModeMessenger.hh"
+
+ListMode* ListMode::_instance = nullptr;
+
+ListMode* ListMode::Instance()
+{
+    return _instance;
+}
+
+ListMode::ListMode():
+    _messenger{nullptr},
+    _enabled{false},
+    _fname{"listmode.bin"},
+    _buffer_size{1 << 16}
+{
+    _instance  = this;
+    _messenger = new ListModeMessenger(this);
+}
+
+ListMode::~ListMode()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
@@ -0,0 +1,71 @@
+#include "ListModeMessenger.hh"
+#include "ListMode.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+ListModeMessenger::ListModeMessenger(ListMode* list_mode):
+    _list_mode{list_mode},
+    _list_mode_directory{nullptr},
+    _enable_cmd{nullptr},
+    _fname_cmd{nullptr},
+    _buffer_cmd{nullptr}
+{
+    _list_mode_directory = new G4UIdirectory("/GP/listmode/");
+    _list_mode_directory->SetGuidance("List-mode energy deposition output");
+
+    // settings are shared by all threads, no need to send commands to workers
+    _enable_cmd = new G4UIcmdWithABool("/GP/listmode/enable", this);
+    _enable_cmd->SetGuidance("Write every scoring step in the phantom, one file per worker thread");
+    _enable_cmd->SetParameterName("listModeEnable", true);
+    _enable_cmd->SetDefaultValue(true);
+    _enable_cmd->SetToBeBroadcasted(false);
+    _enable_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _fname_cmd = new G4UIcmdWithAString("/GP/listmode/fname", this);
+    _fname_cmd->SetGuidance("Set list-mode file name, run and thread numbers are appended");
+    _fname_cmd->SetParameterName("listModeFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _buffer_cmd = new G4UIcmdWithAnInteger("/GP/listmode/buffer", this);
+    _buffer_cmd->SetGuidance("Set number of records buffered per thread before writing");
+    _buffer_cmd->SetParameterName("listModeBuffer", false);
+    _buffer_cmd->SetRange("listModeBuffer > 0");
+    _buffer_cmd->SetToBeBroadcasted(false);
+    _buffer_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+ListModeMessenger::~ListModeMessenger()
+{
+    delete _enable_cmd;
+    delete _fname_cmd;
+    delete _buffer_cmd;
+
+    delete _list_mode_directory;
+}
+
+void ListModeMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _enable_cmd)
+    {
+        _list_mode->set_enabled(_enable_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _fname_cmd)
+    {
+        _list_mode->set_fname(value);
+        return;
+    }
+
+    if (cmd == _buffer_cmd)
+    {
+        _list_mode->set_buffer_size(_buffer_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    return;
+}
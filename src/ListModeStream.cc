@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ListModeStream.hh"
+
+#include "globals.hh"
+
+ListModeStream::ListModeStream():
+    _fname{},
+    _os{},
+    _buffer{},
+    _size{0},
+    _nof_records{0}
+{
+}
+
+ListModeStream::~ListModeStream()
+{
+    close();
+}
+
+bool ListModeStream::open(const std::string& fname, int run_id, int thread_id, size_t buffer_size)
+{
+    close();
+
+    _os.open(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_os.is_open())
+    {
+        G4Exception("ListModeStream", "001", JustWarning, ("Cannot open " + fname).c_str());
+        return false;
+    }
+
+    header h;
+    std::memcpy(h.magic, "PHLM0002", sizeof(h.magic));
+    h.record_size = int32_t(sizeof(record));
+    h.run_id      = run_id;
+    h.thread_id   = thread_id;
+    h.reserved    = 0;
+    _os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    _fname       = fname;
+    _nof_records = 0;
+    _size        = 0;
+    _buffer.resize(std::max(buffer_size, size_t(1)));
+
+    return true;
+}
+
+void ListModeStream::close()
+{
+    if (!_os.is_open())
+        return;
+
+    flush();
+    _os.close();
+
+    G4cout << "ListModeStream: " << _nof_records << " records written to " << _fname << G4endl;
+}
+
+void ListModeStream::flush()
+{
+    if (_size != 0)
+    {
+        _os.write(reinterpret_cast<const char*>(_buffer.data()), std::streamsize(_size * sizeof(record)));
+        _nof_records += int64_t(_size);
+        _size         = 0;
+    }
+
+    if (!_os)
+    {
+        G4Exception("ListModeStream", "002", JustWarning, ("Failed writing " + _fname + ", stream is closed").c_str());
+        _os.close();
+    }
+}
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "G4RunManager.hh"
+#include "G4MTRunManager.hh"
+#include "G4SystemOfUnits.hh"
+
+#include "Monitor.hh"
+#include "MonitorMessenger.hh"
+#include "Checkpoint.hh"
+#include "Detector.hh"
+
+Monitor* Monitor::_instance = nullptr;
+
+Monitor* Monitor::Instance()
+{
+    return _instance;
+}
+
+Monitor::Monitor():
+    _messenger{nullptr},
+
+    _fname{"stdout"},
+    _every_seconds{0.0},
+    _preview_factor{2},
+
+    _counters{},
+
+    _mutex{},
+    _snapshots{},
+    _iso_x{0.0f},
+    _iso_y{0.0f},
+    _iso_z{0.0f},
+
+    _thread{},
+    _wait_mutex{},
+    _wakeup{},
+    _stop{true},
+
+    _detector{nullptr},
+    _out{},
+    _run_id{-1},
+    _events_to_process{0},
+    _run_start{clock::now()},
+    _last_emit{clock::now()}
+{
+    _instance  = this;
+    _messenger = new MonitorMessenger(this);
+}
+
+Monitor::~Monitor()
+{
+    if (_thread.joinable())
+        end_run();
+
+    delete _messenger;
+    _instance = nullptr;
+}
+
+void Monitor::set_isocentre(float x, float y, float z)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // source shifts are NaN until they are set
+    _iso_x = std::isnan(x) ? 0.0f : x;
+    _iso_y = std::isnan(y) ? 0.0f : y;
+    _iso_z = std::isnan(z) ? 0.0f : z;
+}
+
+void Monitor::publish(int thread_id, const DoseGrid& local)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _snapshots[thread_id] = local;
+}
+
+void Monitor::begin_run(int run_id, int64_t nof_events_to_process)
+{
+    if (!enabled())
+        return;
+
+    int nthreads = G4MTRunManager::GetMasterRunManager()->GetNumberOfThreads();
+    _counters = std::vector<counter>(std::max(1, nthreads));
+    for(auto& c: _counters)
+    {
+        c.events.store(0);
+        c.last_events = 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _snapshots.clear();
+    }
+
+    _detector          = static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    _run_id            = run_id;
+    _events_to_process = nof_events_to_process;
+    _run_start         = clock::now();
+    _last_emit         = _run_start;
+
+    if (_fname != "stdout")
+        _out.open(_fname, std::ios::out | std::ios::app);
+
+    _stop   = false;
+    _thread = std::thread(&Monitor::loop, this);
+}
+
+void Monitor::end_run()
+{
+    if (!_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_wait_mutex);
+        _stop = true;
+    }
+    _wakeup.notify_all();
+    _thread.join();
+
+    emit(true);
+
+    if (_out.is_open())
+        _out.close();
+}
+
+void Monitor::loop()
+{
+    std::unique_lock<std::mutex> lock(_wait_mutex);
+    while (!_stop)
+    {
+        _wakeup.wait_for(lock, std::chrono::duration<double>(_every_seconds), [this]() { return _stop; });
+        if (_stop)
+            break;
+
+        lock.unlock();
+        emit(false);
+        lock.lock();
+    }
+}
+
+void Monitor::emit(bool done)
+{
+    auto now = clock::now();
+    std::chrono::duration<double> elapsed  = now - _run_start;
+    std::chrono::duration<double> interval = now - _last_emit;
+    _last_emit = now;
+
+    int64_t             total = 0;
+    std::vector<double> rates;
+    for(auto& c: _counters)
+    {
+        int64_t n = c.events.load(std::memory_order_relaxed);
+        rates.push_back((interval.count() > 0.0) ? double(n - c.last_events) / interval.count() : 0.0);
+        c.last_events = n;
+        total += n;
+    }
+
+    double rate = (elapsed.count() > 0.0) ? double(total) / elapsed.count() : 0.0;
+    double eta  = (rate > 0.0) ? double(std::max<int64_t>(0, _events_to_process - total)) / rate : -1.0;
+
+    // merged dose of the last snapshots, plus resumed checkpoint if any
+    DoseGrid merged;
+    float iso_x, iso_y, iso_z;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto* checkpoint = Checkpoint::Instance();
+        if (checkpoint != nullptr)
+            merged = checkpoint->base();
+
+        for(const auto& s: _snapshots)
+            merged.merge(s.second);
+
+        iso_x = _iso_x;
+        iso_y = _iso_y;
+        iso_z = _iso_z;
+    }
+
+    std::ostringstream os;
+    os << std::setprecision(6);
+    os << "{\"run\": " << _run_id
+       << ", \"done\": " << (done ? "true" : "false")
+       << ", \"elapsed_seconds\": " << elapsed.count()
+       << ", \"events\": " << total
+       << ", \"events_to_process\": " << _events_to_process
+       << ", \"events_per_second\": " << rate
+       << ", \"eta_seconds\": " << eta
+       << ", \"threads\": [";
+    for(size_t k = 0; k != rates.size(); ++k)
+    {
+        os << (k ? ", " : "") << "{\"thread\": " << k
+           << ", \"events\": " << _counters[k].last_events
+           << ", \"events_per_second\": " << rates[k] << "}";
+    }
+    os << "]";
+
+    if (merged.nof_voxels() != 0 && merged.nof_events() != 0)
+    {
+        int peak = 0;
+        for(int k = 1; k != merged.nof_voxels(); ++k)
+        {
+            if (merged.dose(k) > merged.dose(peak))
+                peak = k;
+        }
+
+        os << ", \"dose_events\": " << merged.nof_events()
+           << ", \"peak_voxel\": " << peak
+           << ", \"peak_dose_gy\": " << merged.dose(peak)/gray;
+
+        // uncertainty needs at least two histories
+        if (merged.nof_events() > 1 && merged.dose(peak) > 0.0)
+        {
+            // mean relative uncertainty over voxels above half of the peak
+            double sum = 0.0;
+            int    n   = 0;
+            for(int k = 0; k != merged.nof_voxels(); ++k)
+            {
+                if (merged.dose(k) >= 0.5 * merged.dose(peak))
+                {
+                    sum += merged.sigma(k) / merged.mean(k);
+                    ++n;
+                }
+            }
+
+            os << ", \"peak_rel_uncertainty\": " << merged.sigma(peak) / merged.mean(peak)
+               << ", \"mean_rel_uncertainty_50\": " << ((n != 0) ? sum / double(n) : 0.0);
+        }
+
+        if (_preview_factor > 0 && _detector != nullptr)
+        {
+            std::string preview_name = ((_fname == "stdout") ? std::string{"monitor"} : _fname) + ".preview.json";
+
+            // isocentre voxel, phantom is centered at the origin
+            int ix = int(std::floor((iso_x + 0.5f*_detector->cube_x()) / _detector->voxel_x()));
+            int iy = int(std::floor((iso_y + 0.5f*_detector->cube_y()) / _detector->voxel_y()));
+            int iz = int(std::floor((iso_z + 0.5f*_detector->cube_z()) / _detector->voxel_z()));
+
+            ix = std::min(std::max(ix, 0), merged.nofv_x() - 1);
+            iy = std::min(std::max(iy, 0), merged.nofv_y() - 1);
+            iz = std::min(std::max(iz, 0), merged.nofv_z() - 1);
+
+            write_preview(merged, ix, iy, iz, preview_name);
+            os << ", \"preview\": \"" << preview_name << "\"";
+        }
+    }
+    os << "}";
+
+    if (_fname == "stdout")
+        std::cout << os.str() << std::endl;
+    else
+        _out << os.str() << std::endl;
+}
+
+// one slice, binned by factor x factor voxels, mean dose per history in Gy
+static void write_slice(std::ostream& os, const char* name, const DoseGrid& grid, int factor,
+                        int nu, int nv, int (*idx)(const DoseGrid&, int, int, int), int fixed)
+{
+    int bu = (nu + factor - 1) / factor;
+    int bv = (nv + factor - 1) / factor;
+
+    os << "\"" << name << "\": {\"nu\": " << bu << ", \"nv\": " << bv << ", \"dose\": [";
+    for(int jv = 0; jv != bv; ++jv)
+    {
+        for(int ju = 0; ju != bu; ++ju)
+        {
+            double sum = 0.0;
+            int    n   = 0;
+            for(int v = jv*factor; v != std::min(nv, (jv + 1)*factor); ++v)
+            {
+                for(int u = ju*factor; u != std::min(nu, (ju + 1)*factor); ++u)
+                {
+                    sum += grid.mean(idx(grid, u, v, fixed));
+                    ++n;
+                }
+            }
+            os << ((ju || jv) ? ", " : "") << ((n != 0) ? sum / double(n) / gray : 0.0);
+        }
+    }
+    os << "]}";
+}
+
+static int idx_xy(const DoseGrid& g, int u, int v, int w) { return u + g.nofv_x()*(v + w*g.nofv_y()); }
+static int idx_xz(const DoseGrid& g, int u, int v, int w) { return u + g.nofv_x()*(w + v*g.nofv_y()); }
+static int idx_yz(const DoseGrid& g, int u, int v, int w) { return w + g.nofv_x()*(u + v*g.nofv_y()); }
+
+void Monitor::write_preview(const DoseGrid& grid, int ix, int iy, int iz, const std::string& fname) const
+{
+    // write and rename, so readers never see half written preview
+    std::string tmp_name = fname + ".tmp";
+    {
+        std::ofstream os(tmp_name);
+        os << std::setprecision(4);
+
+        os << "{\"events\": " << grid.nof_events()
+           << ", \"factor\": " << _preview_factor
+           << ", \"isocentre_voxel\": [" << ix << ", " << iy << ", " << iz << "], ";
+        write_slice(os, "xy", grid, _preview_factor, grid.nofv_x(), grid.nofv_y(), idx_xy, iz);
+        os << ", ";
+        write_slice(os, "xz", grid, _preview_factor, grid.nofv_x(), grid.nofv_z(), idx_xz, iy);
+        os << ", ";
+        write_slice(os, "yz", grid, _preview_factor, grid.nofv_y(), grid.nofv_z(), idx_yz, ix);
+        os << "}\n";
+    }
+    std::rename(tmp_name.c_str(), fname.c_str());
+}
@@ -0,0 +1,71 @@
+#include "MonitorMessenger.hh"
+#include "Monitor.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADouble.hh"
+
+MonitorMessenger::MonitorMessenger(Monitor* monitor):
+    _monitor{monitor},
+    _mon_directory{nullptr},
+    _fname_cmd{nullptr},
+    _every_seconds_cmd{nullptr},
+    _preview_factor_cmd{nullptr}
+{
+    _mon_directory = new G4UIdirectory("/GP/monitor/");
+    _mon_directory->SetGuidance("Live run progress telemetry");
+
+    // monitor thread lives on master, no need to send commands to workers
+    _fname_cmd = new G4UIcmdWithAString("/GP/monitor/fname", this);
+    _fname_cmd->SetGuidance("Set JSON Lines output file name, stdout to print");
+    _fname_cmd->SetParameterName("monFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _every_seconds_cmd = new G4UIcmdWithADouble("/GP/monitor/every_seconds", this);
+    _every_seconds_cmd->SetGuidance("Emit progress record every T seconds, 0 to disable");
+    _every_seconds_cmd->SetParameterName("everySeconds", false);
+    _every_seconds_cmd->SetRange("everySeconds>=0.0");
+    _every_seconds_cmd->SetToBeBroadcasted(false);
+    _every_seconds_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _preview_factor_cmd = new G4UIcmdWithAnInteger("/GP/monitor/preview_factor", this);
+    _preview_factor_cmd->SetGuidance("Bin N x N voxels per preview pixel, 0 to disable preview");
+    _preview_factor_cmd->SetParameterName("previewFactor", false);
+    _preview_factor_cmd->SetRange("previewFactor>=0");
+    _preview_factor_cmd->SetToBeBroadcasted(false);
+    _preview_factor_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+MonitorMessenger::~MonitorMessenger()
+{
+    delete _fname_cmd;
+    delete _every_seconds_cmd;
+    delete _preview_factor_cmd;
+
+    delete _mon_directory;
+}
+
+void MonitorMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _fname_cmd)
+    {
+        _monitor->set_fname(value);
+        return;
+    }
+
+    if (cmd == _every_seconds_cmd)
+    {
+        _monitor->set_every_seconds(_every_seconds_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _preview_factor_cmd)
+    {
+        _monitor->set_preview_factor(_preview_factor_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    return;
+}
@@ -0,0 +1,52 @@
+#include "NestedPhantom.hh"
+#include "Profiler.hh"
+
+#include "G4VTouchable.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4ThreeVector.hh"
+
+NestedPhantom::NestedPhantom(const std::vector<G4Material*>& materials, const size_t* mat_IDs,
+                             int nofv_x, int nofv_y, int nofv_z, double voxel_z):
+    G4VNestedParameterisation{},
+    _materials{materials},
+    _mat_IDs{mat_IDs},
+    _nofv_x{nofv_x},
+    _nofv_y{nofv_y},
+    _nofv_z{nofv_z},
+    _voxel_z{voxel_z}
+{
+}
+
+NestedPhantom::~NestedPhantom()
+{
+}
+
+G4Material* NestedPhantom::ComputeMaterial(G4VPhysicalVolume*, const int rep_no, const G4VTouchable* parentTouch)
+{
+    PH_PROFILE_SCOPE(MATERIAL);
+
+    // navigator asks without touchable when it only needs any material
+    if (parentTouch == nullptr || _mat_IDs == nullptr)
+        return _materials[0];
+
+    int ix = parentTouch->GetReplicaNumber(0);
+    int iy = parentTouch->GetReplicaNumber(1);
+
+    return _materials[_mat_IDs[ix + _nofv_x*(iy + _nofv_y*rep_no)]];
+}
+
+int NestedPhantom::GetNumberOfMaterials() const
+{
+    return int(_materials.size());
+}
+
+G4Material* NestedPhantom::GetMaterial(int idx) const
+{
+    return _materials[idx];
+}
+
+void NestedPhantom::ComputeTransformation(const int rep_no, G4VPhysicalVolume* curVol) const
+{
+    double z = (double(rep_no) + 0.5 - 0.5*double(_nofv_z)) * _voxel_z;
+    curVol->SetTranslation(G4ThreeVector(0.0, 0.0, z));
+}
@@ -1,6 +1,7 @@
 #include <fstream>
 
 #include "Phantom.hh"
+#include "Profiler.hh"
 
 #include "G4VisAttributes.hh"
 #include "G4Material.hh"
@@ -45,6 +46,8 @@ void Phantom::read_colour_data()
 
 G4Material* Phantom::ComputeMaterial(int copyNo, G4VPhysicalVolume* physVol, const G4VTouchable*)
 {
+    PH_PROFILE_SCOPE(MATERIAL);
+
     G4Material* mats = G4PhantomParameterisation::ComputeMaterial( copyNo, physVol, nullptr );
     if( physVol )
     {
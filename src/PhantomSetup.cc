@@ -1,8 +1,11 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
+#include <thread>
 
 #include "G4SystemOfUnits.hh"
 
@@ -19,7 +22,24 @@ PhantomSetup::PhantomSetup(const char* hed_name):
 
     _cube_x(-1.0f),
     _cube_y(-1.0f),
-    _cube_z(-1.0f)
+    _cube_z(-1.0f),
+
+    _materials(),
+
+    _box_x0(0),
+    _box_y0(0),
+    _box_z0(0),
+    _box_nx(0),
+    _box_ny(0),
+    _box_nz(0),
+
+    _fine_x0(0),
+    _fine_y0(0),
+    _fine_z0(0),
+    _fine_nx(0),
+    _fine_ny(0),
+    _fine_nz(0),
+    _fine_factor(0)
 {
     G4cout << "Reading file:" << hed_name << G4endl;
     std::ifstream hed_file(hed_name, std::ios::in);
@@ -32,6 +52,8 @@ PhantomSetup::PhantomSetup(const char* hed_name):
     char keyword[17], thebar;
     bool read_cards = true;
 
+    std::string materials_name;
+
     while (read_cards)
     {
         hed_file >> keyword;
@@ -50,6 +72,15 @@ PhantomSetup::PhantomSetup(const char* hed_name):
             {
                 hed_file >> thebar >> _nofv_x >> _nofv_y >> _nofv_z;
             }
+            if (!strcmp(keyword,"MATERIALS"))
+            {
+                hed_file >> thebar >> materials_name;
+            }
+            if (!strcmp(keyword,"FINEBOX"))
+            {
+                hed_file >> thebar >> _fine_x0 >> _fine_y0 >> _fine_z0
+                                   >> _fine_nx >> _fine_ny >> _fine_nz >> _fine_factor;
+            }
         }
     }
 
@@ -73,4 +104,112 @@ PhantomSetup::PhantomSetup(const char* hed_name):
             throw std::logic_error("Problem with setting up phantom");
         }
     }
+
+    _box_nx = _nofv_x;
+    _box_ny = _nofv_y;
+    _box_nz = _nofv_z;
+
+    if (!materials_name.empty())
+    {
+        read_materials(materials_name);
+        find_box();
+    }
+
+    if (_fine_factor > 1)
+    {
+        if (_fine_x0 < 0 || _fine_y0 < 0 || _fine_z0 < 0 ||
+            _fine_nx <= 0 || _fine_ny <= 0 || _fine_nz <= 0 ||
+            _fine_x0 + _fine_nx > _nofv_x || _fine_y0 + _fine_ny > _nofv_y || _fine_z0 + _fine_nz > _nofv_z)
+        {
+            throw std::logic_error("Phantom FINEBOX is outside of the grid");
+        }
+
+        G4cout << "Fine box: " << _fine_nx << " x " << _fine_ny << " x " << _fine_nz
+               << " voxels from (" << _fine_x0 << ", " << _fine_y0 << ", " << _fine_z0
+               << ") split by " << _fine_factor << G4endl;
+    }
+}
+
+void PhantomSetup::read_materials(const std::string& fname)
+{
+    // one byte per voxel, x is the fastest index
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    if (!is)
+        throw std::logic_error("Cannot open phantom materials file: " + fname);
+
+    _materials.resize(size_t(nof_voxels()));
+    is.read(reinterpret_cast<char*>(_materials.data()), std::streamsize(_materials.size()));
+    if (!is)
+        throw std::logic_error("Phantom materials file is shorter than the grid: " + fname);
+}
+
+void PhantomSetup::find_box()
+{
+    // per slice extent of non-air voxels, empty slice has min > max
+    struct extent
+    {
+        int x_min, x_max, y_min, y_max;
+    };
+    std::vector<extent> slices(size_t(_nofv_z), extent{_nofv_x, -1, _nofv_y, -1});
+
+    auto scan = [this, &slices](int z_first, int z_step)
+    {
+        for(int iz = z_first; iz < _nofv_z; iz += z_step)
+        {
+            extent& e = slices[iz];
+            for(int iy = 0; iy != _nofv_y; ++iy)
+            {
+                const uint8_t* row = _materials.data() + idx(0, iy, iz);
+                for(int ix = 0; ix != _nofv_x; ++ix)
+                {
+                    if (row[ix] == 0)
+                        continue;
+
+                    e.x_min = std::min(e.x_min, ix);
+                    e.x_max = std::max(e.x_max, ix);
+                    e.y_min = std::min(e.y_min, iy);
+                    e.y_max = std::max(e.y_max, iy);
+                }
+            }
+        }
+    };
+
+    int nthreads = std::max(1, std::min(int(std::thread::hardware_concurrency()), _nofv_z));
+    std::vector<std::thread> threads;
+    for(int t = 1; t < nthreads; ++t)
+        threads.emplace_back(scan, t, nthreads);
+    scan(0, nthreads);
+    for(auto& t: threads)
+        t.join();
+
+    extent box{_nofv_x, -1, _nofv_y, -1};
+    int    z_min = _nofv_z;
+    int    z_max = -1;
+    for(int iz = 0; iz != _nofv_z; ++iz)
+    {
+        const extent& e = slices[iz];
+        if (e.x_max < 0)
+            continue;
+
+        box.x_min = std::min(box.x_min, e.x_min);
+        box.x_max = std::max(box.x_max, e.x_max);
+        box.y_min = std::min(box.y_min, e.y_min);
+        box.y_max = std::max(box.y_max, e.y_max);
+        z_min     = std::min(z_min, iz);
+        z_max     = std::max(z_max, iz);
+    }
+
+    // all air, nothing to crop to
+    if (z_max < 0)
+        return;
+
+    _box_x0 = box.x_min;
+    _box_y0 = box.y_min;
+    _box_z0 = z_min;
+    _box_nx = box.x_max - box.x_min + 1;
+    _box_ny = box.y_max - box.y_min + 1;
+    _box_nz = z_max - z_min + 1;
+
+    G4cout << "Non-air box: " << _box_nx << " x " << _box_ny << " x " << _box_nz
+           << " voxels from (" << _box_x0 << ", " << _box_y0 << ", " << _box_z0 << ")" << G4endl;
 }
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <dirent.h>
+
+#include "PhaseSpace.hh"
+#include "PhaseSpaceMessenger.hh"
+#include "PhaseSpaceStream.hh"
+#include "Detector.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "G4MTRunManager.hh"
+
+PhaseSpace* PhaseSpace::_instance = nullptr;
+
+PhaseSpace* PhaseSpace::Instance()
+{
+    return _instance;
+}
+
+PhaseSpace::PhaseSpace():
+    _messenger{nullptr},
+    _fname{"phsp.bin"},
+    _capture{false},
+    _replay{false},
+    _history_start{},
+    _nof_source_histories{0}
+{
+    _instance  = this;
+    _messenger = new PhaseSpaceMessenger(this);
+}
+
+PhaseSpace::~PhaseSpace()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+// the same container within a micron
+static bool same_container(const PhaseSpaceStream::header& h, const Detector* detector)
+{
+    G4ThreeVector lo = detector->container_lo();
+    G4ThreeVector hi = detector->container_hi();
+
+    double d = 0.0;
+    for(int k = 0; k != 3; ++k)
+        d = std::max(d, std::max(std::abs(double(h.lo[k])*mm - lo[k]), std::abs(double(h.hi[k])*mm - hi[k])));
+    return d < 1.0e-3*mm;
+}
+
+// part files left by an earlier run, which may have had more threads
+static void remove_parts(const std::string& fname)
+{
+    auto slash = fname.rfind('/');
+    std::string dir    = (slash == std::string::npos) ? std::string{"."} : fname.substr(0, slash);
+    std::string prefix = ((slash == std::string::npos) ? fname : fname.substr(slash + 1)) + ".part";
+
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr)
+        return;
+
+    while (dirent* e = readdir(d))
+    {
+        std::string name = e->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0)
+            std::remove((dir + "/" + name).c_str());
+    }
+    closedir(d);
+}
+
+void PhaseSpace::begin_run(const Detector* detector)
+{
+    _history_start.clear();
+    _nof_source_histories = 0;
+
+    // workers open their parts after master begins the run
+    if (capture())
+        remove_parts(_fname);
+
+    if (!_replay)
+        return;
+
+    std::ifstream is(_fname, std::ios::in | std::ios::binary);
+    if (!is.is_open())
+    {
+        G4Exception("PhaseSpace", "001", JustWarning, ("Cannot open " + _fname + ", nothing is replayed").c_str());
+        return;
+    }
+
+    PhaseSpaceStream::header h;
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!is || std::memcmp(h.magic, "PHPS0001", sizeof(h.magic)) != 0 || h.record_size != int32_t(sizeof(PhaseSpaceStream::record)))
+    {
+        G4Exception("PhaseSpace", "002", JustWarning, (_fname + " is not a phase-space file, nothing is replayed").c_str());
+        return;
+    }
+
+    if (detector != nullptr && !same_container(h, detector))
+        G4Exception("PhaseSpace", "003", JustWarning, (_fname + " was captured on another phantom container, dose near its faces is wrong").c_str());
+
+    // histories start at flagged records
+    std::vector<PhaseSpaceStream::record> buffer(1 << 16);
+    int64_t k = 0;
+    while (k != h.nof_records)
+    {
+        int64_t n = std::min(int64_t(buffer.size()), h.nof_records - k);
+        is.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(n * sizeof(PhaseSpaceStream::record)));
+        if (!is)
+        {
+            G4Exception("PhaseSpace", "004", JustWarning, (_fname + " is truncated, the rest is not replayed").c_str());
+            break;
+        }
+
+        for(int64_t j = 0; j != n; ++j)
+            if (buffer[j].flags & PhaseSpaceStream::new_history)
+                _history_start.push_back(k + j);
+        k += n;
+    }
+
+    // the last history may be cut short by truncation, it is dropped then
+    if (k != h.nof_records && !_history_start.empty())
+    {
+        k = _history_start.back();
+        _history_start.pop_back();
+    }
+    _history_start.push_back(k);
+
+    // histories with no particle reaching the phantom are not in the file,
+    // replay adds them as empty histories, see empty_histories()
+    _nof_source_histories = std::max(h.nof_histories, nof_histories());
+
+    G4cout << "PhaseSpace: " << nof_histories() << " histories with " << k << " particles to replay, captured from "
+           << h.nof_histories << " source histories" << G4endl;
+}
+
+void PhaseSpace::end_run(const Detector* detector, int64_t nof_histories) const
+{
+    // only whole passes over the file give dose of the capture run source
+    if (_replay && _history_start.size() > 1 && nof_histories != _nof_source_histories)
+    {
+        G4Exception("PhaseSpace", "008", JustWarning,
+                    ("Replayed " + std::to_string(nof_histories) + " source histories, " + _fname + " holds "
+                     + std::to_string(_nof_source_histories) + ", phase space is undersampled or reused").c_str());
+    }
+
+    if (!capture())
+        return;
+
+    PhaseSpaceStream::header h;
+    std::memcpy(h.magic, "PHPS0001", sizeof(h.magic));
+    h.record_size   = int32_t(sizeof(PhaseSpaceStream::record));
+    h.reserved      = 0;
+    h.nof_histories = nof_histories;
+    h.nof_records   = 0;
+
+    G4ThreeVector lo = (detector != nullptr) ? detector->container_lo() : G4ThreeVector{};
+    G4ThreeVector hi = (detector != nullptr) ? detector->container_hi() : G4ThreeVector{};
+    for(int k = 0; k != 3; ++k)
+    {
+        h.lo[k] = float(lo[k]/mm);
+        h.hi[k] = float(hi[k]/mm);
+    }
+
+    // write and rename, so readers never see half written file
+    std::string tmp_name = _fname + ".tmp";
+    std::ofstream os(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!os.is_open())
+    {
+        G4Exception("PhaseSpace", "005", JustWarning, ("Cannot open " + tmp_name).c_str());
+        return;
+    }
+    os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    // every worker has written its part, threads are numbered from 0;
+    // whole records only, a part cut short by a failed write loses its tail
+    std::vector<PhaseSpaceStream::record> buffer(1 << 16);
+    int nof_parts = G4MTRunManager::GetMasterRunManager()->GetNumberOfThreads();
+    for(int t = 0; t != nof_parts; ++t)
+    {
+        std::string   part_fname = part_name(t);
+        std::ifstream part(part_fname, std::ios::in | std::ios::binary);
+        if (!part.is_open())
+        {
+            G4Exception("PhaseSpace", "009", JustWarning, ("Cannot open " + part_fname + ", its particles are lost").c_str());
+            continue;
+        }
+
+        part.seekg(0, std::ios::end);
+        int64_t n = int64_t(part.tellg()) / int64_t(sizeof(PhaseSpaceStream::record));
+        part.seekg(0, std::ios::beg);
+
+        for(int64_t k = 0; k < n; k += int64_t(buffer.size()))
+        {
+            auto size = std::streamsize(std::min(int64_t(buffer.size()), n - k) * sizeof(PhaseSpaceStream::record));
+            part.read(reinterpret_cast<char*>(buffer.data()), size);
+            os.write(reinterpret_cast<const char*>(buffer.data()), size);
+        }
+        h.nof_records += n;
+
+        part.close();
+        std::remove(part_fname.c_str());
+    }
+
+    os.seekp(0, std::ios::beg);
+    os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    os.close();
+    if (!os)
+    {
+        G4Exception("PhaseSpace", "006", JustWarning, ("Failed writing " + tmp_name).c_str());
+        return;
+    }
+
+    if (std::rename(tmp_name.c_str(), _fname.c_str()) != 0)
+    {
+        G4Exception("PhaseSpace", "007", JustWarning, ("Cannot rename " + tmp_name + " to " + _fname).c_str());
+        return;
+    }
+
+    G4cout << "PhaseSpace: " << h.nof_records << " particles of " << nof_histories << " histories from "
+           << nof_parts << " threads written to " << _fname << G4endl;
+}
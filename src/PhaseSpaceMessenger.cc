@@ -0,0 +1,70 @@
+#include "PhaseSpaceMessenger.hh"
+#include "PhaseSpace.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+
+PhaseSpaceMessenger::PhaseSpaceMessenger(PhaseSpace* phase_space):
+    _phase_space{phase_space},
+    _phsp_directory{nullptr},
+    _fname_cmd{nullptr},
+    _capture_cmd{nullptr},
+    _replay_cmd{nullptr}
+{
+    _phsp_directory = new G4UIdirectory("/GP/phsp/");
+    _phsp_directory->SetGuidance("Phase-space capture and replay at the phantom surface");
+
+    // settings are shared by all threads, no need to send commands to workers
+    _fname_cmd = new G4UIcmdWithAString("/GP/phsp/fname", this);
+    _fname_cmd->SetGuidance("Set phase-space file name, written by capture and read by replay");
+    _fname_cmd->SetParameterName("phspFname", false);
+    _fname_cmd->SetToBeBroadcasted(false);
+    _fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _capture_cmd = new G4UIcmdWithABool("/GP/phsp/capture", this);
+    _capture_cmd->SetGuidance("Write particles entering the phantom container and kill them");
+    _capture_cmd->SetParameterName("phspCapture", true);
+    _capture_cmd->SetDefaultValue(true);
+    _capture_cmd->SetToBeBroadcasted(false);
+    _capture_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _replay_cmd = new G4UIcmdWithABool("/GP/phsp/replay", this);
+    _replay_cmd->SetGuidance("Start histories from the phase-space file instead of the source");
+    _replay_cmd->SetParameterName("phspReplay", true);
+    _replay_cmd->SetDefaultValue(true);
+    _replay_cmd->SetToBeBroadcasted(false);
+    _replay_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+PhaseSpaceMessenger::~PhaseSpaceMessenger()
+{
+    delete _fname_cmd;
+    delete _capture_cmd;
+    delete _replay_cmd;
+
+    delete _phsp_directory;
+}
+
+void PhaseSpaceMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _fname_cmd)
+    {
+        _phase_space->set_fname(value);
+        return;
+    }
+
+    if (cmd == _capture_cmd)
+    {
+        _phase_space->set_capture(_capture_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    if (cmd == _replay_cmd)
+    {
+        _phase_space->set_replay(_replay_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    return;
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "PhaseSpaceStream.hh"
+
+#include "globals.hh"
+
+PhaseSpaceStream::PhaseSpaceStream():
+    _fname{},
+    _os{},
+    _buffer{},
+    _size{0},
+    _nof_records{0}
+{
+}
+
+PhaseSpaceStream::~PhaseSpaceStream()
+{
+    close();
+}
+
+bool PhaseSpaceStream::open(const std::string& fname, size_t buffer_size)
+{
+    close();
+
+    _os.open(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_os.is_open())
+    {
+        G4Exception("PhaseSpaceStream", "001", JustWarning, ("Cannot open " + fname).c_str());
+        return false;
+    }
+
+    _fname       = fname;
+    _nof_records = 0;
+    _size        = 0;
+    _buffer.resize(std::max(buffer_size, size_t(1)));
+
+    return true;
+}
+
+void PhaseSpaceStream::close()
+{
+    if (!_os.is_open())
+        return;
+
+    flush();
+    _os.close();
+
+    G4cout << "PhaseSpaceStream: " << _nof_records << " particles written to " << _fname << G4endl;
+}
+
+void PhaseSpaceStream::flush()
+{
+    if (_size != 0)
+    {
+        _os.write(reinterpret_cast<const char*>(_buffer.data()), std::streamsize(_size * sizeof(record)));
+        _nof_records += int64_t(_size);
+        _size         = 0;
+    }
+
+    if (!_os)
+    {
+        G4Exception("PhaseSpaceStream", "002", JustWarning, ("Failed writing " + _fname + ", stream is closed").c_str());
+        _os.close();
+    }
+}
@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "G4VUserPhysicsList.hh"
+#include "G4Material.hh"
+#include "G4Element.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4ProductionCuts.hh"
+#include "G4Version.hh"
+#include "G4SystemOfUnits.hh"
+
+#include "PhysicsCache.hh"
+#include "PhysicsCacheMessenger.hh"
+
+PhysicsCache* PhysicsCache::_instance = nullptr;
+
+PhysicsCache* PhysicsCache::Instance()
+{
+    return _instance;
+}
+
+PhysicsCache::PhysicsCache(G4VUserPhysicsList* physics, const std::string& physics_name):
+    _messenger{nullptr},
+    _physics{physics},
+    _physics_name{physics_name},
+    _dir{},
+    _key{},
+    _entry_dir{},
+    _retrieved{false},
+    _store_pending{false}
+{
+    _instance  = this;
+    _messenger = new PhysicsCacheMessenger(this);
+}
+
+PhysicsCache::~PhysicsCache()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+std::string PhysicsCache::key() const
+{
+    std::ostringstream os;
+    os << std::setprecision(17);
+
+    os << "geant4 " << G4VERSION_NUMBER << " " << G4Version << "\n";
+    os << "physics " << _physics_name << "\n";
+    os << "default_cut_mm " << _physics->GetDefaultCutValue()/mm << "\n";
+
+    for(const auto* region: *G4RegionStore::GetInstance())
+    {
+        const auto* cuts = region->GetProductionCuts();
+        if (cuts == nullptr)
+            continue;
+
+        os << "region " << region->GetName()
+           << " " << cuts->GetProductionCut("gamma")/mm
+           << " " << cuts->GetProductionCut("e-")/mm
+           << " " << cuts->GetProductionCut("e+")/mm
+           << " " << cuts->GetProductionCut("proton")/mm << "\n";
+    }
+
+    for(const auto* material: *G4Material::GetMaterialTable())
+    {
+        os << "material " << material->GetName()
+           << " " << material->GetDensity()/(g/cm3);
+
+        const double* fractions = material->GetFractionVector();
+        for(int k = 0; k != int(material->GetNumberOfElements()); ++k)
+            os << " " << material->GetElement(k)->GetZ() << ":" << fractions[k];
+        os << "\n";
+    }
+
+    return os.str();
+}
+
+// FNV-1a, key text is stored next to the tables and compared anyway
+static std::string hash_hex(const std::string& s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for(unsigned char c: s)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+
+    std::ostringstream os;
+    os << std::hex << std::setw(16) << std::setfill('0') << h;
+    return os.str();
+}
+
+static std::string read_file(const std::string& fname)
+{
+    std::ifstream is(fname);
+    if (!is)
+        return std::string{};
+
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+void PhysicsCache::set_dir(const std::string& dir)
+{
+    _dir           = dir;
+    _key           = key();
+    _entry_dir     = _dir + "/" + hash_hex(_key);
+    _retrieved     = false;
+    _store_pending = false;
+
+    // key file is written last, entry without it is incomplete
+    if (read_file(_entry_dir + "/key.txt") == _key)
+    {
+        _physics->SetPhysicsTableRetrieved(_entry_dir);
+        _retrieved = true;
+
+        G4cout << "PhysicsCache: retrieving physics tables from " << _entry_dir << G4endl;
+        return;
+    }
+
+    _store_pending = true;
+    G4cout << "PhysicsCache: no tables in " << _entry_dir << ", they will be stored after the first run" << G4endl;
+}
+
+void PhysicsCache::store()
+{
+    if (!_store_pending)
+        return;
+    _store_pending = false;
+
+    mkdir(_dir.c_str(), 0755);
+
+    // store into private directory and rename, concurrent jobs may fill the same entry
+    std::string tmp_dir = _entry_dir + ".tmp." + std::to_string(getpid());
+    if (mkdir(tmp_dir.c_str(), 0755) != 0)
+    {
+        G4Exception("PhysicsCache", "001", JustWarning, ("Cannot create " + tmp_dir).c_str());
+        return;
+    }
+
+    if (!_physics->StorePhysicsTable(tmp_dir))
+    {
+        G4Exception("PhysicsCache", "002", JustWarning, ("Failed storing physics tables to " + tmp_dir).c_str());
+        return;
+    }
+
+    {
+        std::ofstream os(tmp_dir + "/key.txt");
+        os << _key;
+        if (!os)
+        {
+            G4Exception("PhysicsCache", "003", JustWarning, ("Failed writing key to " + tmp_dir).c_str());
+            return;
+        }
+    }
+
+    if (std::rename(tmp_dir.c_str(), _entry_dir.c_str()) != 0)
+    {
+        // another job has got there first, its tables are the same
+        G4Exception("PhysicsCache", "004", JustWarning, ("Cannot rename " + tmp_dir + " to " + _entry_dir).c_str());
+        return;
+    }
+
+    G4cout << "PhysicsCache: physics tables stored to " << _entry_dir << G4endl;
+}
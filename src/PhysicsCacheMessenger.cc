@@ -0,0 +1,40 @@
+#include "PhysicsCacheMessenger.hh"
+#include "PhysicsCache.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+
+PhysicsCacheMessenger::PhysicsCacheMessenger(PhysicsCache* cache):
+    _cache{cache},
+    _cache_directory{nullptr},
+    _dir_cmd{nullptr}
+{
+    _cache_directory = new G4UIdirectory("/GP/physics/");
+    _cache_directory->SetGuidance("Physics tables cache");
+
+    // tables are built and retrieved on master only
+    _dir_cmd = new G4UIcmdWithAString("/GP/physics/cache_dir", this);
+    _dir_cmd->SetGuidance("Store and retrieve physics tables in this directory,");
+    _dir_cmd->SetGuidance("has to be set after initialization and before the first run");
+    _dir_cmd->SetParameterName("cacheDir", false);
+    _dir_cmd->SetToBeBroadcasted(false);
+    _dir_cmd->AvailableForStates(G4State_Idle);
+}
+
+PhysicsCacheMessenger::~PhysicsCacheMessenger()
+{
+    delete _dir_cmd;
+
+    delete _cache_directory;
+}
+
+void PhysicsCacheMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _dir_cmd)
+    {
+        _cache->set_dir(value);
+        return;
+    }
+
+    return;
+}
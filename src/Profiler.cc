@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+#include "G4Threading.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4LogicalVolume.hh"
+
+#include "Profiler.hh"
+
+static const char* section_names[Profiler::NOF_SECTIONS] =
+{
+    "generate_primaries",
+    "tracking",
+    "compute_material",
+    "scoring",
+    "record_event",
+    "merge"
+};
+
+std::mutex             Profiler::_registry_mutex;
+std::vector<Profiler*> Profiler::_registry;
+
+uint64_t                              Profiler::_run_ticks = 0;
+std::chrono::steady_clock::time_point Profiler::_run_start = std::chrono::steady_clock::now();
+
+Profiler::Profiler(int thread_id):
+    _thread_id{thread_id},
+    _particle_steps{},
+    _volume_steps{}
+{
+    clear();
+}
+
+Profiler::~Profiler()
+{
+    std::lock_guard<std::mutex> lock(_registry_mutex);
+    _registry.erase(std::remove(_registry.begin(), _registry.end(), this), _registry.end());
+}
+
+Profiler& Profiler::local()
+{
+    // threads live as long as the run manager, so is the profiler
+    static G4ThreadLocal Profiler* profiler = nullptr;
+    if (profiler == nullptr)
+    {
+        profiler = new Profiler(G4Threading::G4GetThreadId());
+
+        std::lock_guard<std::mutex> lock(_registry_mutex);
+        _registry.push_back(profiler);
+    }
+    return *profiler;
+}
+
+void Profiler::clear()
+{
+    std::fill(_calls, _calls + NOF_SECTIONS, 0);
+    std::fill(_timed, _timed + NOF_SECTIONS, 0);
+    std::fill(_ticks, _ticks + NOF_SECTIONS, 0);
+    std::fill(_start, _start + NOF_SECTIONS, 0);
+
+    _particle_steps.clear();
+    _volume_steps.clear();
+}
+
+void Profiler::begin_run()
+{
+    _run_start = std::chrono::steady_clock::now();
+    _run_ticks = ticks();
+}
+
+// estimated ticks of all calls from the timed sample
+static inline double all_ticks(uint64_t ticks, uint64_t timed, uint64_t calls)
+{
+    return (timed != 0) ? double(ticks) * double(calls) / double(timed) : 0.0;
+}
+
+template <typename T> static void write_counts(std::ostream& os, const std::map<std::string, T>& counts)
+{
+    os << "{";
+    for(auto it = counts.cbegin(); it != counts.cend(); ++it)
+    {
+        os << (it == counts.cbegin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+    }
+    os << "}";
+}
+
+void Profiler::report(const std::string& fname, int run_id, int64_t nof_events)
+{
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - _run_start;
+    double ticks_per_second = (wall.count() > 0.0) ? double(ticks() - _run_ticks) / wall.count() : 0.0;
+
+    std::lock_guard<std::mutex> lock(_registry_mutex);
+
+    std::vector<Profiler*> profilers{_registry};
+    std::sort(profilers.begin(), profilers.end(),
+              [](const Profiler* a, const Profiler* b) { return a->_thread_id < b->_thread_id; });
+
+    std::ofstream os(fname);
+    os << std::setprecision(9);
+
+    os << "{\n";
+    os << "  \"run\": "              << run_id           << ",\n";
+    os << "  \"events\": "           << nof_events       << ",\n";
+    os << "  \"wall_seconds\": "     << wall.count()     << ",\n";
+    os << "  \"ticks_per_second\": " << ticks_per_second << ",\n";
+    os << "  \"threads\": [\n";
+
+    double                          total_calls[NOF_SECTIONS] = {};
+    double                          total_ticks[NOF_SECTIONS] = {};
+    std::map<std::string, uint64_t> total_particles;
+    std::map<std::string, uint64_t> total_volumes;
+
+    for(size_t i = 0; i != profilers.size(); ++i)
+    {
+        const Profiler& p = *profilers[i];
+
+        os << "    {\n";
+        os << "      \"thread\": " << p._thread_id << ",\n";
+        os << "      \"sections\": {\n";
+        for(int s = 0; s != NOF_SECTIONS; ++s)
+        {
+            double t = all_ticks(p._ticks[s], p._timed[s], p._calls[s]);
+            total_calls[s] += double(p._calls[s]);
+            total_ticks[s] += t;
+
+            os << "        \"" << section_names[s] << "\": {"
+               << "\"calls\": "   << p._calls[s] << ", "
+               << "\"timed\": "   << p._timed[s] << ", "
+               << "\"ticks\": "   << t << ", "
+               << "\"seconds\": " << ((ticks_per_second > 0.0) ? t / ticks_per_second : 0.0)
+               << "}" << (s + 1 != NOF_SECTIONS ? "," : "") << "\n";
+        }
+        os << "      },\n";
+
+        std::map<std::string, uint64_t> particles;
+        for(const auto& c: p._particle_steps)
+        {
+            particles[c.first->GetParticleName()] += c.second;
+            total_particles[c.first->GetParticleName()] += c.second;
+        }
+
+        std::map<std::string, uint64_t> volumes;
+        for(const auto& c: p._volume_steps)
+        {
+            volumes[c.first->GetName()] += c.second;
+            total_volumes[c.first->GetName()] += c.second;
+        }
+
+        os << "      \"steps_by_particle\": ";
+        write_counts(os, particles);
+        os << ",\n";
+        os << "      \"steps_by_volume\": ";
+        write_counts(os, volumes);
+        os << "\n";
+        os << "    }" << (i + 1 != profilers.size() ? "," : "") << "\n";
+    }
+    os << "  ],\n";
+
+    os << "  \"total\": {\n";
+    os << "    \"sections\": {\n";
+    for(int s = 0; s != NOF_SECTIONS; ++s)
+    {
+        os << "      \"" << section_names[s] << "\": {"
+           << "\"calls\": "   << total_calls[s] << ", "
+           << "\"ticks\": "   << total_ticks[s] << ", "
+           << "\"seconds\": " << ((ticks_per_second > 0.0) ? total_ticks[s] / ticks_per_second : 0.0)
+           << "}" << (s + 1 != NOF_SECTIONS ? "," : "") << "\n";
+    }
+    os << "    },\n";
+    os << "    \"steps_by_particle\": ";
+    write_counts(os, total_particles);
+    os << ",\n";
+    os << "    \"steps_by_volume\": ";
+    write_counts(os, total_volumes);
+    os << "\n";
+    os << "  }\n";
+    os << "}\n";
+}
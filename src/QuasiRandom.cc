@@ -0,0 +1,94 @@
+#include "QuasiRandom.hh"
+#include "QuasiRandomMessenger.hh"
+
+#include "Randomize.hh"
+
+QuasiRandom* QuasiRandom::_instance = nullptr;
+
+QuasiRandom* QuasiRandom::Instance()
+{
+    return _instance;
+}
+
+// primitive polynomials and initial direction numbers of the dimensions
+// after the first one, from Joe and Kuo new-joe-kuo-6.21201 table
+struct sobol_init
+{
+    int      s;
+    uint32_t a;
+    uint32_t m[3];
+};
+
+static const sobol_init sobol_table[QuasiRandom::nof_dims - 1] =
+{
+    {1, 0, {1, 0, 0}},
+    {2, 1, {1, 3, 0}},
+    {3, 1, {1, 3, 1}}
+};
+
+QuasiRandom::QuasiRandom():
+    _messenger{nullptr},
+    _enabled{false},
+    _directions{},
+    _shift{}
+{
+    // first dimension is van der Corput sequence
+    for(int k = 0; k != nof_bits; ++k)
+        _directions[0][k] = uint32_t(1) << (nof_bits - 1 - k);
+
+    for(int d = 1; d != nof_dims; ++d)
+    {
+        const sobol_init& t = sobol_table[d - 1];
+        auto&             v = _directions[d];
+
+        for(int k = 0; k != t.s; ++k)
+            v[k] = t.m[k] << (nof_bits - 1 - k);
+
+        for(int k = t.s; k != nof_bits; ++k)
+        {
+            v[k] = v[k - t.s] ^ (v[k - t.s] >> t.s);
+            for(int j = 1; j != t.s; ++j)
+            {
+                if ((t.a >> (t.s - 1 - j)) & 1)
+                    v[k] ^= v[k - j];
+            }
+        }
+    }
+
+    _instance  = this;
+    _messenger = new QuasiRandomMessenger(this);
+}
+
+QuasiRandom::~QuasiRandom()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+void QuasiRandom::begin_run()
+{
+    if (!_enabled)
+        return;
+
+    for(auto& s: _shift)
+        s = uint32_t(G4UniformRand() * 4294967296.0);
+}
+
+void QuasiRandom::point(uint64_t index, double* u) const
+{
+    // sequence period is 2^32 points, far more than any run
+    uint32_t i = uint32_t(index);
+
+    for(int d = 0; d != nof_dims; ++d)
+    {
+        uint32_t x = _shift[d];
+        for(int k = 0; (i >> k) != 0; ++k)
+        {
+            if ((i >> k) & 1)
+                x ^= _directions[d][k];
+        }
+
+        // cell centre, never exactly 0 or 1
+        u[d] = (double(x) + 0.5) / 4294967296.0;
+    }
+}
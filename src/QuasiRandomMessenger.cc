@@ -0,0 +1,40 @@
+#include "QuasiRandomMessenger.hh"
+#include "QuasiRandom.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+
+QuasiRandomMessenger::QuasiRandomMessenger(QuasiRandom* qmc):
+    _qmc{qmc},
+    _qmc_directory{nullptr},
+    _enable_cmd{nullptr}
+{
+    _qmc_directory = new G4UIdirectory("/GP/qmc/");
+    _qmc_directory->SetGuidance("Quasi-random sampling of the source assembly");
+
+    // settings are shared by all threads, no need to send commands to workers
+    _enable_cmd = new G4UIcmdWithABool("/GP/qmc/enable", this);
+    _enable_cmd->SetGuidance("Sample rotation, polar cosine, azimuth and energy from digitally shifted Sobol sequence");
+    _enable_cmd->SetParameterName("qmcEnable", true);
+    _enable_cmd->SetDefaultValue(true);
+    _enable_cmd->SetToBeBroadcasted(false);
+    _enable_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+QuasiRandomMessenger::~QuasiRandomMessenger()
+{
+    delete _enable_cmd;
+
+    delete _qmc_directory;
+}
+
+void QuasiRandomMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _enable_cmd)
+    {
+        _qmc->set_enabled(_enable_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    return;
+}
@@ -0,0 +1,271 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4UIcommand.hh"
+#include "Randomize.hh"
+
+#include "ResultCache.hh"
+#include "ResultCacheMessenger.hh"
+#include "Checkpoint.hh"
+#include "PhysicsCache.hh"
+#include "Detector.hh"
+#include "Dij.hh"
+#include "ListMode.hh"
+#include "PhaseSpace.hh"
+#include "Denoise.hh"
+
+ResultCache* ResultCache::_instance = nullptr;
+
+ResultCache* ResultCache::Instance()
+{
+    return _instance;
+}
+
+ResultCache::ResultCache():
+    _messenger{nullptr},
+    _dir{},
+    _pending_entry{}
+{
+    _instance  = this;
+    _messenger = new ResultCacheMessenger(this);
+
+    // source settings live on workers only, master sees them in command history
+    G4UImanager::GetUIpointer()->SetMaxHistSize(1 << 20);
+}
+
+ResultCache::~ResultCache()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+static std::string read_file(const std::string& fname)
+{
+    std::ifstream is(fname, std::ios::in | std::ios::binary);
+    if (!is)
+        return std::string{"<missing " + fname + ">"};
+
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+// FNV-1a, 64 bit
+static std::string hash_hex(const std::string& s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for(unsigned char c: s)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+
+    std::ostringstream os;
+    os << std::hex << std::setw(16) << std::setfill('0') << h;
+    return os.str();
+}
+
+// last value of every sampling command applied so far: source settings,
+// variance reduction, quasi-random sampling, geometry and collimator
+static std::map<std::string, std::string> source_settings()
+{
+    static const std::string prefixes[] = {"/GP/source/", "/GP/vr/", "/GP/qmc/", "/GP/collimator/", "/GP/geometry/"};
+
+    std::map<std::string, std::string> settings;
+
+    auto* UImanager = G4UImanager::GetUIpointer();
+    for(int k = 0; k != UImanager->GetNumberOfHistory(); ++k)
+    {
+        std::string command = UImanager->GetPreviousCommand(k);
+        bool sampling = false;
+        for(const auto& prefix: prefixes)
+            sampling = sampling || command.compare(0, prefix.size(), prefix) == 0;
+        if (!sampling)
+            continue;
+
+        auto space = command.find(' ');
+        std::string name  = command.substr(0, space);
+        std::string value = (space == std::string::npos) ? std::string{} : command.substr(space + 1);
+        settings[name] = value;
+    }
+    return settings;
+}
+
+std::string ResultCache::make_key() const
+{
+    std::ostringstream os;
+
+    // any rebuild of ph may change results
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0)
+        os << "executable " << st.st_size << " " << st.st_mtime << "\n";
+
+    auto* physics_cache = PhysicsCache::Instance();
+    if (physics_cache != nullptr)
+        os << physics_cache->key();
+
+    // header and the materials file it names, the same way PhantomSetup reads them
+    std::string hed = read_file("phantom.hed");
+    os << "phantom\n" << hed << "\n";
+    {
+        std::istringstream is(hed);
+        for(std::string keyword; is >> keyword && keyword != "END-INPUT"; )
+        {
+            std::string bar, materials_name;
+            if (keyword == "MATERIALS" && is >> bar >> materials_name)
+                os << "materials\n" << read_file(materials_name) << "\n";
+        }
+    }
+
+    for(const auto& s: source_settings())
+    {
+        os << s.first << " " << s.second << "\n";
+
+        // file names are not enough, hash what is inside
+        if (s.first == "/GP/source/src_fname" || s.first == "/GP/source/plan_fname" || s.first == "/GP/source/spectrum")
+            os << read_file(s.second) << "\n";
+
+        // phase space is too big to read, its size and time stand for it
+        if (s.first == "/GP/source/collimator_phsp")
+        {
+            struct stat phsp;
+            if (stat(s.second.c_str(), &phsp) == 0)
+                os << phsp.st_size << " " << phsp.st_mtime << "\n";
+        }
+
+        // and spectra of single sources
+        if (s.first == "/GP/source/src_fname")
+        {
+            std::istringstream is(read_file(s.second));
+            for(std::string line; std::getline(is, line); )
+            {
+                std::istringstream ls(line);
+                std::string lat, lon, spectrum;
+                if (ls >> lat >> lon >> spectrum)
+                    os << spectrum << "\n" << read_file(spectrum) << "\n";
+            }
+        }
+    }
+
+    // seeds of the run are drawn from the master engine
+    auto* engine = G4Random::getTheEngine();
+    os << "engine " << engine->name();
+    for(auto v: engine->put())
+        os << " " << v;
+    os << "\n";
+
+    return os.str();
+}
+
+void ResultCache::beam_on(int nof_events)
+{
+    auto* run_manager = G4RunManager::GetRunManager();
+
+    if (!enabled())
+    {
+        run_manager->BeamOn(nof_events);
+        return;
+    }
+
+    // only dose.out is cached, anything else has to be simulated
+    std::string bypass;
+    auto* checkpoint  = Checkpoint::Instance();
+    auto* dij         = Dij::Instance();
+    auto* list_mode   = ListMode::Instance();
+    auto* phase_space = PhaseSpace::Instance();
+    auto  settings    = source_settings();
+    auto  shot_dose   = settings.find("/GP/source/shot_dose");
+    auto* detector    = static_cast<const Detector*>(run_manager->GetUserDetectorConstruction());
+    if (checkpoint == nullptr)
+        bypass = "no checkpoint support";
+    else if (checkpoint->base().nof_voxels() != 0)
+        bypass = "checkpoint is resumed";
+    else if (dij != nullptr && dij->enabled())
+        bypass = "dose influence matrix is scored";
+    else if (list_mode != nullptr && list_mode->enabled())
+        bypass = "list-mode output is written";
+    else if (phase_space != nullptr && (phase_space->capture() || phase_space->replay()))
+        bypass = "phase space is captured or replayed";
+    else if (shot_dose != settings.end() && (shot_dose->second.empty() || G4UIcommand::ConvertToBool(shot_dose->second.c_str())))
+        bypass = "dose per shot is scored";
+    else if (detector != nullptr && detector->phs().has_fine())
+        bypass = "phantom has fine box";
+
+    if (!bypass.empty())
+    {
+        G4cout << "ResultCache: bypassed, " << bypass << G4endl;
+        run_manager->BeamOn(nof_events);
+        return;
+    }
+
+    std::string hash = hash_hex(make_key());
+
+    // the largest entry not exceeding requested number of events
+    std::string prefix = hash + ".";
+    int64_t     cached = 0;
+    if (DIR* dir = opendir(_dir.c_str()))
+    {
+        while (dirent* e = readdir(dir))
+        {
+            std::string name = e->d_name;
+            if (name.size() <= prefix.size() + 4 || name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - 4, 4, ".chk") != 0)
+                continue;
+
+            int64_t events = std::atoll(name.substr(prefix.size(), name.size() - prefix.size() - 4).c_str());
+            if (events <= nof_events && events > cached)
+                cached = events;
+        }
+        closedir(dir);
+    }
+
+    std::string entry = _dir + "/" + prefix;
+    if (cached != 0)
+        checkpoint->resume(entry + std::to_string(cached) + ".chk");
+
+    if (cached == nof_events)
+    {
+        // nothing to simulate, resumed entry is the result
+        DoseGrid fine;
+        DoseGrid total = checkpoint->end_run(DoseGrid{}, fine);
+
+        std::ofstream fileout("dose.out");
+        total.write_dose_out(fileout, detector->nofv_z());
+
+        auto* denoise = Denoise::Instance();
+        if (denoise != nullptr && denoise->enabled())
+            denoise->write(total, detector, detector->nofv_z());
+
+        G4cout << "ResultCache: " << nof_events << " events of " << hash << " taken from cache" << G4endl;
+        return;
+    }
+
+    G4cout << "ResultCache: " << cached << " events of " << hash << " in cache, simulating "
+           << nof_events - cached << G4endl;
+
+    mkdir(_dir.c_str(), 0755);
+    _pending_entry = entry + std::to_string(nof_events) + ".chk";
+    run_manager->BeamOn(int(nof_events - cached));
+    _pending_entry.clear();
+}
+
+void ResultCache::end_run(const DoseGrid& total)
+{
+    if (_pending_entry.empty())
+        return;
+
+    // run is complete, master engine is past all used seeds, like in final checkpoint
+    auto* engine = G4Random::getTheEngine();
+    Checkpoint::Instance()->write(_pending_entry, total, DoseGrid{}, engine->name(), engine->put(), 0);
+
+    G4cout << "ResultCache: " << total.nof_events() << " histories stored to " << _pending_entry << G4endl;
+}
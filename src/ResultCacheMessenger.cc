@@ -0,0 +1,56 @@
+#include "ResultCacheMessenger.hh"
+#include "ResultCache.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+ResultCacheMessenger::ResultCacheMessenger(ResultCache* cache):
+    _cache{cache},
+    _cache_directory{nullptr},
+    _dir_cmd{nullptr},
+    _beam_on_cmd{nullptr}
+{
+    _cache_directory = new G4UIdirectory("/GP/cache/");
+    _cache_directory->SetGuidance("Content addressed cache of run results");
+
+    // cache lives on master, no need to send commands to workers
+    _dir_cmd = new G4UIcmdWithAString("/GP/cache/dir", this);
+    _dir_cmd->SetGuidance("Set result cache directory, empty string turns cache off");
+    _dir_cmd->SetParameterName("cacheDir", true);
+    _dir_cmd->SetDefaultValue("");
+    _dir_cmd->SetToBeBroadcasted(false);
+    _dir_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _beam_on_cmd = new G4UIcmdWithAnInteger("/GP/cache/beamOn", this);
+    _beam_on_cmd->SetGuidance("Start run of N events, reusing cached result of the same configuration");
+    _beam_on_cmd->SetParameterName("nofEvents", false);
+    _beam_on_cmd->SetRange("nofEvents>=0");
+    _beam_on_cmd->SetToBeBroadcasted(false);
+    _beam_on_cmd->AvailableForStates(G4State_Idle);
+}
+
+ResultCacheMessenger::~ResultCacheMessenger()
+{
+    delete _dir_cmd;
+    delete _beam_on_cmd;
+
+    delete _cache_directory;
+}
+
+void ResultCacheMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _dir_cmd)
+    {
+        _cache->set_dir(value);
+        return;
+    }
+
+    if (cmd == _beam_on_cmd)
+    {
+        _cache->beam_on(_beam_on_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    return;
+}
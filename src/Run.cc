@@ -25,22 +25,99 @@
 //=====================================================================
 
 #include "Run.hh"
+#include "Detector.hh"
+#include "Checkpoint.hh"
+#include "Monitor.hh"
+#include "Dij.hh"
+#include "ListMode.hh"
+#include "PhaseSpace.hh"
+#include "Source.hh"
+#include "Profiler.hh"
+
 #include "G4SDManager.hh"
+#include "G4RunManager.hh"
+#include "G4Threading.hh"
+#include "G4EventManager.hh"
 
 #include "G4MultiFunctionalDetector.hh"
 #include "G4VPrimitiveScorer.hh"
 
 Run::Run():
-    G4Run()
+    G4Run(),
+    _grid{},
+    _key_offset{0},
+    _dose_coll{-1},
+    _history{-1},
+    _event_histories{0},
+    _nof_recorded{0},
+    _dij{},
+    _source{0},
+    _fine_grid{},
+    _shot_grids{},
+    _shot{0},
+    _list_mode{},
+    _event_id{0},
+    _phase_space{},
+    _captured_event{-1},
+    _captured_history{-1},
+    _last_publish{std::chrono::steady_clock::now()},
+    _last_monitor{std::chrono::steady_clock::now()}
 {
+    init_grid();
 }
 
 Run::Run(const std::vector<std::string> mfdName):
-    G4Run()
+    G4Run(),
+    _grid{},
+    _key_offset{0},
+    _dose_coll{-1},
+    _history{-1},
+    _event_histories{0},
+    _nof_recorded{0},
+    _dij{},
+    _source{0},
+    _fine_grid{},
+    _shot_grids{},
+    _shot{0},
+    _list_mode{},
+    _event_id{0},
+    _phase_space{},
+    _captured_event{-1},
+    _captured_history{-1},
+    _last_publish{std::chrono::steady_clock::now()},
+    _last_monitor{std::chrono::steady_clock::now()}
 {
+    init_grid();
     ConstructMFD(mfdName);
 }
 
+void Run::init_grid()
+{
+    auto* detector = static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (detector == nullptr)
+        return;
+
+    _grid = DoseGrid{detector->phs()};
+
+    // G4PSDoseDeposit3D with default depths keys hits by
+    // world copy * nj*nk + container copy * nk + voxel copy,
+    // and phantom container copy number is 1
+    _key_offset = detector->nofv_z();
+
+    const auto& phs = detector->phs();
+    if (phs.has_fine())
+        _fine_grid = DoseGrid{phs.fine_nofv_x(), phs.fine_nofv_y(), phs.fine_nofv_z()};
+
+    // only workers have the source, master matrix is shaped by the first merge
+    auto* dij    = Dij::Instance();
+    auto* source = static_cast<const Source*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    if (dij != nullptr && dij->enabled() && source != nullptr && source->nof_srcs() != 0)
+        _dij = DoseMatrix{int(source->nof_srcs()), detector->nofv_x(), detector->nofv_y(), detector->nofv_z()};
+
+    if (source != nullptr && source->shot_dose())
+        _shot_grids.assign(source->nof_shots(), DoseGrid{detector->phs()});
+}
+
 // Destructor
 //    clear all data members.
 Run::~Run()
@@ -98,6 +175,9 @@ void Run::ConstructMFD(const std::vector<std::string>& mfdName)
                     _CollName.push_back(fullCollectionName);
                     _CollID.push_back(collectionID);
                     _runMap.push_back(new G4THitsMap<double>(detName, collectionName));
+
+                    if (collectionName == "DoseDeposit")
+                        _dose_coll = int(_runMap.size()) - 1;
                 }
                 else
                 {
@@ -113,7 +193,21 @@ void Run::ConstructMFD(const std::vector<std::string>& mfdName)
 //  is accumulated during a Run.
 void Run::RecordEvent(const G4Event* aEvent)
 {
+    PH_PROFILE_SCOPE(RECORD_EVENT);
+
     ++numberOfEvent;  // This is an original line.
+    ++_nof_recorded;
+
+    // the last (or the only) history of the event is scored below
+    add_history();
+    _history = -1;
+
+    // source histories with no primary tracked, like replayed ones which never
+    // reached the phantom, still count for dose per history
+    auto* source = static_cast<const Source*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    if (source != nullptr && source->event_histories() > _event_histories)
+        add_empty_histories(source->event_histories() - _event_histories);
+    _event_histories = 0;
 
     //=============================
     // HitsCollection of This Event
@@ -141,15 +235,145 @@ void Run::RecordEvent(const G4Event* aEvent)
         {
             //=== Sum up HitsMap of this event to HitsMap of RUN.===
             *_runMap[i] += *EvtMap;
+
+            if ( int(i) == _dose_coll )
+                score_event(*EvtMap);
         }
     }
 
+    publish_checkpoint();
+    publish_monitor();
+
     G4Run::RecordEvent(aEvent);
 }
 
+// event is still being tracked, its hits map so far holds only the finished history,
+// it goes to the run and is emptied for the next history of the event
+void Run::end_history()
+{
+    add_history();
+
+    if (_dose_coll < 0)
+        return;
+
+    const G4Event* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+    G4HCofThisEvent* HCE = (event != nullptr) ? event->GetHCofThisEvent() : nullptr;
+    if (!HCE)
+        return;
+
+    auto* EvtMap = static_cast<G4THitsMap<double>*>(HCE->GetHC(_CollID[_dose_coll]));
+    if (EvtMap)
+    {
+        *_runMap[_dose_coll] += *EvtMap;
+        score_event(*EvtMap);
+        EvtMap->clear();
+    }
+}
+
+void Run::add_history()
+{
+    ++_event_histories;
+
+    _grid.add_events(1);
+
+    if (_fine_grid.nof_voxels() != 0)
+        _fine_grid.add_events(1);
+
+    if (_shot >= 0 && _shot < int(_shot_grids.size()))
+        _shot_grids[_shot].add_events(1);
+}
+
+// no dose, so shot grids, whose histories are known only when tracked, are left as they are
+void Run::add_empty_histories(int64_t n)
+{
+    _grid.add_events(n);
+
+    if (_fine_grid.nof_voxels() != 0)
+        _fine_grid.add_events(n);
+}
+
+// per-history dose goes into dense grid, with its square for uncertainty
+void Run::score_event(const G4THitsMap<double>& evtMap)
+{
+    int nof_voxels = _grid.nof_voxels();
+
+    DoseGrid* shot_grid = (_shot >= 0 && _shot < int(_shot_grids.size())) ? &_shot_grids[_shot] : nullptr;
+
+    auto itr = evtMap.GetMap()->cbegin();
+    for(; itr != evtMap.GetMap()->cend(); ++itr)
+    {
+        int idx = itr->first - _key_offset;
+        if (idx >= 0 && idx < nof_voxels)
+        {
+            _grid.score(idx, *(itr->second));
+            if (shot_grid != nullptr)
+                shot_grid->score(idx, *(itr->second));
+        }
+        else if (idx >= nof_voxels && idx - nof_voxels < _fine_grid.nof_voxels())
+        {
+            _fine_grid.score(idx - nof_voxels, *(itr->second));
+        }
+    }
+}
+
+void Run::open_streams(int run_id)
+{
+    if (!G4Threading::IsWorkerThread())
+        return;
+
+    int thread_id = G4Threading::G4GetThreadId();
+
+    auto* list_mode = ListMode::Instance();
+    if (list_mode != nullptr && list_mode->enabled())
+        _list_mode.open(list_mode->stream_name(run_id, thread_id), run_id, thread_id, size_t(list_mode->buffer_size()));
+
+    auto* phase_space = PhaseSpace::Instance();
+    if (phase_space != nullptr && phase_space->capture())
+        _phase_space.open(phase_space->part_name(thread_id), 1 << 16);
+}
+
+int Run::current_event_id()
+{
+    const G4Event* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+    return (event != nullptr) ? event->GetEventID() : -1;
+}
+
+// worker hands over snapshot of its grid, checkpoint itself decides when to write
+void Run::publish_checkpoint()
+{
+    auto* checkpoint = Checkpoint::Instance();
+    if (checkpoint == nullptr || !checkpoint->enabled() || !G4Threading::IsWorkerThread())
+        return;
+
+    if (checkpoint->publish_due(_nof_recorded, _last_publish))
+    {
+        checkpoint->publish(G4Threading::G4GetThreadId(), _nof_recorded, _grid, _fine_grid);
+        _last_publish = std::chrono::steady_clock::now();
+    }
+}
+
+// worker event counter every event, grid snapshot every monitor period
+void Run::publish_monitor()
+{
+    auto* monitor = Monitor::Instance();
+    if (monitor == nullptr || !monitor->enabled() || !G4Threading::IsWorkerThread())
+        return;
+
+    int thread_id = G4Threading::G4GetThreadId();
+    monitor->count(thread_id, _nof_recorded);
+
+    if (monitor->publish_due(_last_monitor))
+    {
+        monitor->publish(thread_id, _grid);
+        _last_monitor = std::chrono::steady_clock::now();
+    }
+}
+
 // Merge hits map from threads
 void Run::Merge(const G4Run* aRun)
 {
+    PH_PROFILE_SCOPE(MERGE);
+
     const Run* localRun = static_cast<const Run*>(aRun);
     copy(_CollName, localRun->_CollName);
     copy(_CollID, localRun->_CollID);
@@ -170,6 +394,16 @@ void Run::Merge(const G4Run* aRun)
                 *prm += *lrm;
         }
     }
+    _grid.merge(localRun->_grid);
+    _fine_grid.merge(localRun->_fine_grid);
+    _dij.merge(localRun->_dij);
+
+    // master has no source, it takes the shot count from the first worker
+    if (_shot_grids.size() < localRun->_shot_grids.size())
+        _shot_grids.resize(localRun->_shot_grids.size());
+    for(size_t k = 0; k != localRun->_shot_grids.size(); ++k)
+        _shot_grids[k].merge(localRun->_shot_grids[k]);
+
     G4Run::Merge(aRun);
 }
 
@@ -4,6 +4,17 @@
 
 #include "RunAction.hh"
 #include "Run.hh"
+#include "Checkpoint.hh"
+#include "Monitor.hh"
+#include "Dij.hh"
+#include "PhysicsCache.hh"
+#include "ResultCache.hh"
+#include "QuasiRandom.hh"
+#include "PhaseSpace.hh"
+#include "Denoise.hh"
+#include "Detector.hh"
+#include "Source.hh"
+#include "Profiler.hh"
 
 #include "G4THitsMap.hh"
 
@@ -49,10 +60,58 @@ void RunAction::BeginOfRunAction(const G4Run* aRun)
 
     //inform the runManager to save random number seed
     G4RunManager::GetRunManager()->SetRandomNumberStore(false);
+
+    PH_PROFILE_CLEAR();
+    if (IsMaster())
+        PH_PROFILE_BEGIN_RUN();
+
+    // shift is drawn on master before workers start, resumed runs get their own;
+    // it comes before the checkpoint takes the engine state, so that state plus
+    // the event seeds is where the next run starts
+    auto* qmc = QuasiRandom::Instance();
+    if (IsMaster() && qmc != nullptr)
+        qmc->begin_run();
+
+    auto* checkpoint = Checkpoint::Instance();
+    if (IsMaster() && checkpoint != nullptr)
+        checkpoint->begin_run(aRun->GetNumberOfEventToBeProcessed());
+
+    // every worker writes its own list-mode and phase-space files
+    if (!IsMaster() && _run != nullptr)
+        _run->open_streams(aRun->GetRunID());
+
+    // replayed histories are indexed before workers start
+    auto* phase_space = PhaseSpace::Instance();
+    if (IsMaster() && phase_space != nullptr)
+        phase_space->begin_run(static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction()));
+
+    auto* monitor = Monitor::Instance();
+    if (monitor != nullptr && monitor->enabled())
+    {
+        if (IsMaster())
+        {
+            monitor->begin_run(aRun->GetRunID(), aRun->GetNumberOfEventToBeProcessed());
+        }
+        else
+        {
+            // only workers have the source, isocentre is where its shifts put it
+            auto* source = static_cast<const Source*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+            if (source != nullptr)
+                monitor->set_isocentre(source->shift_x(), source->shift_y(), source->shift_z());
+        }
+    }
 }
 
 void RunAction::EndOfRunAction(const G4Run* aRun)
 {
+    auto* monitor = Monitor::Instance();
+    if (IsMaster() && monitor != nullptr)
+        monitor->end_run();
+
+    // whole streams are on disk before master reports the run
+    if (!IsMaster() && _run != nullptr)
+        _run->close_streams();
+
     int nofEvents = aRun->GetNumberOfEvent();
 
     if (nofEvents == 0)
@@ -75,9 +134,15 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
 
         if( DoseDeposit && DoseDeposit->GetMap()->size() != 0 )
         {
+            // fine voxel keys of multi-resolution phantom repeat dose of their grid voxels
+            int last_key = run->key_offset() + run->grid().nof_voxels();
+
             auto itr = DoseDeposit->GetMap()->cbegin();
             for(; itr != DoseDeposit->GetMap()->cend(); ++itr)
             {
+                if (itr->first >= last_key)
+                    continue;
+
                 if(!IsMaster())
                 {
                     local_total_dose += *(itr->second);
@@ -106,7 +171,33 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
     {
         G4cout << " ###### EndOfRunAction ###### " << G4endl;
 
+        // tables are built by now, keep them for the next launches
+        auto* physics_cache = PhysicsCache::Instance();
+        if (physics_cache != nullptr && physics_cache->enabled())
+            physics_cache->store();
+
         const Run* re02Run = static_cast<const Run*>(aRun);
+
+        // add resumed checkpoint, if any, and write the final one
+        auto* checkpoint = Checkpoint::Instance();
+        DoseGrid fine_total{re02Run->fine_grid()};
+        DoseGrid total = (checkpoint != nullptr) ? checkpoint->end_run(re02Run->grid(), fine_total) : re02Run->grid();
+
+        auto* result_cache = ResultCache::Instance();
+        if (result_cache != nullptr)
+            result_cache->end_run(total);
+
+        // influence matrix is of this run only, normalized by its own histories
+        auto* dij = Dij::Instance();
+        if (dij != nullptr && dij->enabled())
+            dij->write(re02Run->dij(), re02Run->grid().nof_events());
+
+        // parts of the workers are closed by now
+        auto* phase_space = PhaseSpace::Instance();
+        if (phase_space != nullptr)
+            phase_space->end_run(static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction()),
+                                 re02Run->grid().nof_events());
+
         //--- Dump all scored quantities involved in the Run.
 
         for ( size_t i = 0; i != _SDName.size(); ++i )
@@ -116,10 +207,9 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
         //  (Display only central region of x-y plane)
         //      0       ConcreteSD/DoseDeposit
         //---------------------------------------------
-            G4THitsMap<G4double>* DoseDeposit = re02Run->GetHitsMap(_SDName[i]+"/DoseDeposit");
-
             G4cout << "=============================================================" << G4endl;
             G4cout << " Number of event processed : " << aRun->GetNumberOfEvent()     << G4endl;
+            G4cout << " Number of histories total : " << total.nof_events()           << G4endl;
             G4cout << "=============================================================" << G4endl;
 
             std::ofstream fileout;
@@ -128,20 +218,21 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
 
             G4cout << " opened file " << fname << " for dose output" << G4endl;
 
-            if( DoseDeposit && DoseDeposit->GetMap()->size() != 0 )
+            if( total.nof_voxels() != 0 && total.total_dose() != 0.0 )
             {
                 std::ostream *myout = &G4cout;
                 print_header(myout);
 
-                auto itr = DoseDeposit->GetMap()->cbegin();
-                for(; itr != DoseDeposit->GetMap()->cend(); ++itr)
+                total.write_dose_out(fileout, re02Run->key_offset());
+
+                for(int k = 0; k != total.nof_voxels(); ++k)
                 {
-                    fileout <<  itr->first
-                            << "     "  << *(itr->second)/CLHEP::gray
-                            << G4endl;
-                    G4cout << "    " << itr->first
+                    if (total.dose(k) == 0.0)
+                        continue;
+
+                    G4cout << "    " << k + re02Run->key_offset()
                               << "     " << std::setprecision(6)
-                              << *(itr->second)/CLHEP::gray << " Gy"
+                              << total.dose(k)/CLHEP::gray << " Gy"
                               << G4endl;
                 }
                 G4cout << "=============================================" << G4endl;
@@ -149,14 +240,48 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
             else
             {
                 G4Exception("RunAction", "000", JustWarning,
-                            "DoseDeposit HitsMap is either a null pointer of the HitsMap was empty");
+                            "DoseDeposit grid is either not allocated or empty");
             }
 
             fileout.close();
             G4cout << " closed file " << fname << " for dose output" << G4endl;
         }
+
+        // filtered dose next to the raw one
+        auto* denoise = Denoise::Instance();
+        if (denoise != nullptr && denoise->enabled())
+            denoise->write(total, static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction()),
+                           re02Run->key_offset());
+
+        // per-shot dose of the plan, the same format as dose.out
+        const auto& shot_grids = re02Run->shot_grids();
+        for(size_t k = 0; k != shot_grids.size(); ++k)
+        {
+            std::string fname = "dose_shot_" + std::to_string(k) + ".out";
+
+            std::ofstream fileout(fname);
+            shot_grids[k].write_dose_out(fileout, re02Run->key_offset());
+
+            G4cout << " shot " << k << ": " << shot_grids[k].nof_events() << " histories, dose written to " << fname << G4endl;
+        }
+
+        // fine voxels of FINEBOX, keys are fine voxel linear indices with no offset;
+        // their dose is also in dose.out, averaged over the grid voxels
+        if (fine_total.nof_voxels() != 0)
+        {
+            std::string fname = "dose_fine.out";
+
+            std::ofstream fileout(fname);
+            fine_total.write_dose_out(fileout, 0);
+
+            G4cout << " fine box " << fine_total.nofv_x() << " x " << fine_total.nofv_y() << " x " << fine_total.nofv_z()
+                   << ", dose written to " << fname << G4endl;
+        }
     }
 
+    if (IsMaster())
+        PH_PROFILE_REPORT("profile.json", aRun->GetRunID(), aRun->GetNumberOfEvent());
+
     G4cout << "Finished : End of Run Action " << aRun->GetRunID() << G4endl;
 }
 
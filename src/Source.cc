@@ -1,20 +1,33 @@
 #include <tuple>
 #include <limits>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
 
 #include "Source.hh"
 
 #include "G4Event.hh"
 #include "G4ParticleGun.hh"
+#include "G4PrimaryVertex.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
+#include "G4RunManager.hh"
+#include "G4Run.hh"
 #include "SourceMessenger.hh"
+#include "QuasiRandom.hh"
+#include "PhaseSpace.hh"
+#include "Detector.hh"
+#include "Profiler.hh"
 #include "globals.hh"
 
 #include "Randomize.hh"
 
 using nl = std::numeric_limits<float>;
 
+// collimator phase-space records read at once
+static constexpr int64_t col_block_records = 4096;
+
 static inline float degree_to_radian(float adegree)
 {
     return adegree * float(M_PI) / 180.0f;
@@ -33,6 +46,36 @@ Source::Source():
     _shift_y{nl::quiet_NaN()},
     _shift_z{nl::quiet_NaN()},
 
+    _histories_per_event{1},
+    _event_histories{1},
+
+    _bias_radius{0.0f},
+    _bias_fraction{0.9},
+
+    _spectrum{},
+    _spectra{},
+    _src_spectrum{},
+
+    _shots{},
+    _shot_cdf{},
+    _shot_dose{false},
+    _event_shots{},
+    _weights{},
+
+    _replay_is{},
+    _replay_run{-1},
+    _replay_records{},
+    _primary_history{},
+    _primary_source{},
+
+    _col_fname{},
+    _col_is{},
+    _col_nof_records{0},
+    _col_nof_histories{0},
+    _col_block{},
+    _col_block_first{0},
+    _col_channels{},
+
     _gamma{nullptr},
     _electron{nullptr},
     _positron{nullptr},
@@ -80,14 +123,172 @@ void Source::set_sources(const std::string& fname)
     }
 
     float lat, lon; // source latitude and longitude
+    std::string spectrum; // optional spectrum file of the source
     std::vector<angles> srcs;
+    std::vector<std::string> spectra;
     srcs.reserve(200);
     while (not is.eof()) {
         is >> lat >> lon;
+        if (is) {
+            std::string rest;
+            std::getline(is, rest);
+            std::istringstream rs(rest);
+            spectrum.clear();
+            rs >> spectrum;
+        }
         srcs.emplace_back(angles(lat, lon));
+        spectra.emplace_back(spectrum);
     }
 
     this->set_sources(srcs);
+    this->set_spectra(spectra);
+}
+
+void Source::set_spectrum(const std::string& fname)
+{
+    G4cout << "Source::set_spectrum " << fname << G4endl;
+
+    Spectrum spectrum;
+    if (spectrum.load(fname))
+        _spectrum = std::move(spectrum);
+}
+
+void Source::set_spectra(const std::vector<std::string>& fnames)
+{
+    std::vector<Spectrum>    spectra;
+    std::vector<std::string> loaded;
+    std::vector<int>         src_spectrum;
+
+    for(const auto& fname: fnames)
+    {
+        if (fname.empty())
+        {
+            src_spectrum.push_back(-1);
+            continue;
+        }
+
+        auto it = std::find(loaded.cbegin(), loaded.cend(), fname);
+        if (it != loaded.cend())
+        {
+            src_spectrum.push_back(int(it - loaded.cbegin()));
+            continue;
+        }
+
+        // source falls back to the assembly spectrum if its file is bad
+        Spectrum spectrum;
+        if (!spectrum.load(fname))
+        {
+            src_spectrum.push_back(-1);
+            continue;
+        }
+
+        src_spectrum.push_back(int(spectra.size()));
+        spectra.push_back(std::move(spectrum));
+        loaded.push_back(fname);
+    }
+
+    // no own spectra, nothing to look up per source
+    _spectra.swap(spectra);
+    if (_spectra.empty())
+        src_spectrum.clear();
+    _src_spectrum.swap(src_spectrum);
+}
+
+void Source::set_plan(const std::string& fname)
+{
+    G4cout << "Source::set_plan " << fname << G4endl;
+
+    std::ifstream is(fname);
+    if (!is.is_open())
+    {
+        G4Exception("Source", "001", JustWarning, ("Cannot open plan file " + fname + ", plan unchanged").c_str());
+        return;
+    }
+
+    std::vector<shot>   shots;
+    std::vector<double> cdf;
+    double              total = 0.0;
+
+    std::string line;
+    while (std::getline(is, line))
+    {
+        // skip blank lines and comments
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream ls(line);
+
+        float x, y, z, rstart, rstop, angle;
+        double weight;
+        ls >> x >> y >> z >> weight >> rstart >> rstop >> angle;
+        if (ls.fail() || weight < 0.0)
+        {
+            G4Exception("Source", "002", JustWarning, ("Bad plan line: " + line + ", plan unchanged").c_str());
+            return;
+        }
+
+        total += weight;
+        cdf.push_back(total);
+        shots.push_back(shot{x*float(mm), y*float(mm), z*float(mm),
+                             degree_to_radian(rstart), degree_to_radian(rstop),
+                             float(cos(degree_to_radian(angle))), 1.0f,
+                             weight});
+    }
+
+    if (shots.empty() || total <= 0.0)
+    {
+        G4Exception("Source", "003", JustWarning, ("No weighted shots in " + fname + ", plan unchanged").c_str());
+        return;
+    }
+
+    _shots.swap(shots);
+    _shot_cdf.swap(cdf);
+
+    G4cout << "Source::set_plan " << _shots.size() << " shots, total weight " << total << G4endl;
+}
+
+void Source::set_collimator_phsp(const std::string& fname)
+{
+    G4cout << "Source::set_collimator_phsp " << fname << G4endl;
+
+    _col_is.close();
+    _col_is.clear();
+    _col_fname.clear();
+    _col_nof_records   = 0;
+    _col_nof_histories = 0;
+    _col_block.clear();
+    _col_block_first   = 0;
+
+    if (fname == "none")
+        return;
+
+    _col_is.open(fname, std::ios::in | std::ios::binary);
+    if (!_col_is.is_open())
+    {
+        G4Exception("Source", "005", JustWarning, ("Cannot open collimator phase space " + fname + ", photons are sampled").c_str());
+        return;
+    }
+
+    PhaseSpaceStream::header h;
+    _col_is.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!_col_is || std::memcmp(h.magic, "PHPS0001", sizeof(h.magic)) != 0 ||
+        h.record_size != int32_t(sizeof(PhaseSpaceStream::record)) || h.nof_records <= 0)
+    {
+        G4Exception("Source", "006", JustWarning, (fname + " is not a collimator phase space with records, photons are sampled").c_str());
+        _col_is.close();
+        return;
+    }
+
+    _col_fname         = fname;
+    _col_nof_records   = h.nof_records;
+    _col_nof_histories = h.nof_histories;
+
+    // every history is one record, while the file holds the particles of
+    // nof_histories source photons; dose per source photon takes the factor
+    G4cout << "Source::set_collimator_phsp " << _col_nof_records << " particles of " << _col_nof_histories
+           << " channel histories, dose per channel history is dose per history times "
+           << double(_col_nof_records)/double(std::max(_col_nof_histories, int64_t(1))) << G4endl;
 }
 
 void Source::set_sources(const std::vector<angles>& srcs)
@@ -112,45 +313,66 @@ void Source::set_sources(const std::vector<angles>& srcs)
 // to be removed and replaced by phase space file
 
 // energy sampling, two monolines from Co60
-static double sample_energy()
+static double sample_energy(double u)
 {
-    if (G4UniformRand() < 0.5)
+    if (u < 0.5)
         return 1.33*MeV;
 
     return 1.17*MeV;
 }
 
 // sample source polar angle uniformly in the range
-static double sample_polar(float polar_start, float polar_stop)
+static double sample_polar(float polar_start, float polar_stop, double u)
 {
-    double mu = polar_start + (polar_stop - polar_start)*G4UniformRand();
+    double mu = polar_start + (polar_stop - polar_start)*u;
     return mu;
 }
 
+// sample source polar angle, with probability fraction uniformly inside the
+// cone of bias_mu cosine around the collimator axis, otherwise uniformly in
+// the whole range; returns cosine and its weight, uniform pdf over mixture pdf.
+// Single uniform picks both the branch and the cosine, so stratification
+// of the uniform carries over to the cosine
+static std::tuple<double,double> sample_polar(float polar_start, float polar_stop, double bias_mu, double fraction, double u)
+{
+    double inner_start = std::max(double(polar_start), bias_mu);
+    if (fraction <= 0.0 || inner_start >= polar_stop || inner_start <= polar_start)
+        return std::make_tuple(sample_polar(polar_start, polar_stop, u), 1.0);
+
+    double mu = (u < fraction) ? inner_start + (polar_stop - inner_start)*(u / fraction)
+                               : sample_polar(polar_start, polar_stop, (u - fraction) / (1.0 - fraction));
+
+    double ratio = (polar_stop - polar_start) / (polar_stop - inner_start);
+    double w     = (mu >= inner_start) ? 1.0 / (fraction*ratio + 1.0 - fraction) : 1.0 / (1.0 - fraction);
+    return std::make_tuple(mu, w);
+}
+
 // generate particle at (0,0,0)
-static std::tuple<double,double,double,double,double,double,double,double> generate_particle(double polar_start, double polar_stop)
+static std::tuple<double,double,double,double,double,double,double,double> generate_particle(double polar_start, double polar_stop,
+                                                                                              double bias_mu, double bias_fraction,
+                                                                                              const Spectrum& spectrum, const Source::uniforms& u)
 {
     double x = 0.0;
     double y = 0.0;
     double z = 0.0;
 
-    auto cos_theta = sample_polar(polar_start, polar_stop);
+    double cos_theta, w;
+    std::tie(cos_theta, w) = sample_polar(polar_start, polar_stop, bias_mu, bias_fraction, u[Source::u_polar]);
     auto sin_theta = sqrt((1.0 - cos_theta) * (1.0 + cos_theta));
-    auto phi       = 2.0 * M_PI * G4UniformRand();
+    auto phi       = 2.0 * M_PI * u[Source::u_phi];
 
     auto wx = cos_theta;
     auto wy = sin_theta*sin(phi);
     auto wz = sin_theta*cos(phi);
 
-    auto e = sample_energy();
-    auto w = 1.0;
+    auto e = spectrum.empty() ? sample_energy(u[Source::u_energy]) : spectrum.sample(u[Source::u_energy]);
 
     return std::make_tuple(w, e, x, y, z, wx, wy, wz);
 }
 
-static inline double sample_rotangle(double rstart, double rstop)
+static inline double sample_rotangle(double rstart, double rstop, double u)
 {
-    return rstart + (rstop - rstart) * G4UniformRand();
+    return rstart + (rstop - rstart) * u;
 }
 
 static inline std::tuple<double, double> rotate_2d(double a, double o, double sn, double cs)
@@ -158,22 +380,332 @@ static inline std::tuple<double, double> rotate_2d(double a, double o, double sn
     return std::make_tuple(cs*a - sn*o, sn*a + cs*o);
 }
 
-// source particle parameters, called per each source event
+// source particle parameters, called per each source event,
+// event holds histories_per_event independent samples of the assembly
 void Source::GeneratePrimaries(G4Event* anEvent)
 {
-    double x, y, z;
-    double wx, wy, wz;
-    double w, e;
+    PH_PROFILE_SCOPE(GENERATE);
+
+    _event_histories = _histories_per_event;
+
+    auto* phase_space = PhaseSpace::Instance();
+    if (phase_space != nullptr && phase_space->replay())
+    {
+        replay(anEvent, *phase_space);
+        return;
+    }
+
+    auto* detector = static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (detector != nullptr && detector->collimator())
+    {
+        generate_channel(anEvent);
+        return;
+    }
+
+    auto* qmc = QuasiRandom::Instance();
+
+    _event_shots.resize(_histories_per_event);
+    _weights.clear();
+    _primary_history.clear();
+    _primary_source.clear();
+
+    // channel records of all histories are read before any primary is made, so a read
+    // error leaves the event empty instead of shifting histories of the primaries after it
+    if (_col_nof_records != 0)
+    {
+        _col_channels.resize(_histories_per_event);
+        for(int h = 0; h != _histories_per_event; ++h)
+        {
+            int64_t history = int64_t(anEvent->GetEventID())*int64_t(_histories_per_event) + int64_t(h);
+            if (!collimator_particle(history, _col_channels[h]))
+            {
+                // histories of the event still count, see event_histories(), but records
+                // past a read error are not trusted, so the worker stops its run
+                G4RunManager::GetRunManager()->AbortRun(true);
+                return;
+            }
+        }
+    }
+
+    for(int h = 0; h != _histories_per_event; ++h)
+    {
+        // shot in proportion to its weight
+        int k = 0;
+        if (_shots.size() > 1)
+        {
+            double u = G4UniformRand() * _shot_cdf.back();
+            k = int(std::upper_bound(_shot_cdf.cbegin(), _shot_cdf.cend(), u) - _shot_cdf.cbegin());
+            k = std::min(k, int(_shots.size()) - 1);
+        }
+        _event_shots[h] = k;
+
+        const shot& s = _shots.empty() ? current_shot() : _shots[k];
+
+        // event IDs are unique over threads, so are the points and the records
+        uint64_t history = uint64_t(anEvent->GetEventID())*uint64_t(_histories_per_event) + uint64_t(h);
+        if (_col_nof_records != 0)
+        {
+            // rotation only, the record has the rest
+            uniforms u;
+            if (qmc != nullptr && qmc->enabled())
+                qmc->point(history, u.data());
+            else
+                u[u_rotation] = G4UniformRand();
+            place_assembly(s, _col_channels[h], u, false, _particles);
+        }
+        else if (qmc != nullptr && qmc->enabled())
+        {
+            uniforms u;
+            qmc->point(history, u.data());
+            sample_assembly(s, u, _particles);
+        }
+        else
+            sample_assembly(s, _particles);
+
+        for(const auto& p: _particles)
+        {
+            if (p.def != _particleGun->GetParticleDefinition())
+                _particleGun->SetParticleDefinition(p.def);
+
+            _particleGun->SetParticlePosition(G4ThreeVector(p.x, p.y, p.z));
+
+            // set particle direction
+            _particleGun->SetParticleMomentumDirection(G4ThreeVector(p.wx, p.wy, p.wz));
+
+            // and energy
+            _particleGun->SetParticleEnergy(p.e);
+
+            _particleGun->GeneratePrimaryVertex(anEvent);
+
+            _weights.push_back(p.w);
+        }
+    }
+
+    if (_particleGun->GetParticleDefinition() != _gamma)
+        _particleGun->SetParticleDefinition(_gamma);
+
+    set_weights(anEvent);
+}
+
+void Source::generate_channel(G4Event* anEvent)
+{
+    auto* qmc = QuasiRandom::Instance();
+
+    _event_shots.assign(_histories_per_event, 0);
+    _weights.clear();
+    _primary_history.clear();
+    _primary_source.clear();
+
+    // collimator sampling cone aims photons into the channel entrance,
+    // shot shift and assembly rotation are applied to the records later
+    const shot s = current_shot();
+
+    double bias_mu = 1.0;
+    if (_bias_radius > 0.0f && _bias_radius < _iso_radius)
+        bias_mu = sqrt(1.0 - double(_bias_radius/_iso_radius)*double(_bias_radius/_iso_radius));
+
+    for(int h = 0; h != _histories_per_event; ++h)
+    {
+        uniforms u;
+        if (qmc != nullptr && qmc->enabled())
+            qmc->point(uint64_t(anEvent->GetEventID())*uint64_t(_histories_per_event) + uint64_t(h), u.data());
+        else
+        {
+            u[u_polar]    = G4UniformRand();
+            u[u_phi]      = G4UniformRand();
+            u[u_energy]   = G4UniformRand();
+            u[u_rotation] = 0.0;
+        }
+
+        double x, y, z;
+        double wx, wy, wz;
+        double w, e;
+        std::tie(w, e, x, y, z, wx, wy, wz) = generate_particle(s.polar_start, s.polar_stop, bias_mu, _bias_fraction, _spectrum, u);
+
+        x -= this->_iso_radius;
+
+        _particleGun->SetParticlePosition(G4ThreeVector(x, y, z));
+        _particleGun->SetParticleMomentumDirection(G4ThreeVector(wx, wy, wz));
+        _particleGun->SetParticleEnergy(e);
+
+        _particleGun->GeneratePrimaryVertex(anEvent);
+
+        _weights.push_back(w);
+        _primary_history.push_back(h);
+        _primary_source.push_back(0);
+    }
+
+    set_weights(anEvent);
+}
+
+bool Source::collimator_particle(int64_t history, particle& p)
+{
+    // histories go over the records again and again
+    if (history == _col_nof_records)
+        G4Exception("Source", "009", JustWarning,
+                    ("Run has more histories than records of " + _col_fname + ", they are used again").c_str());
+
+    int64_t k = history % _col_nof_records;
+    if (k < _col_block_first || k >= _col_block_first + int64_t(_col_block.size()))
+    {
+        _col_block.resize(size_t(std::min(col_block_records, _col_nof_records - k)));
+        _col_is.clear();
+        _col_is.seekg(std::streamoff(sizeof(PhaseSpaceStream::header) + k*sizeof(PhaseSpaceStream::record)));
+        _col_is.read(reinterpret_cast<char*>(_col_block.data()), std::streamsize(_col_block.size()*sizeof(PhaseSpaceStream::record)));
+        if (!_col_is)
+        {
+            G4Exception("Source", "007", JustWarning, ("Failed reading " + _col_fname + ", run is aborted").c_str());
+            _col_block.clear();
+            return false;
+        }
+        _col_block_first = k;
+    }
+
+    const auto& r = _col_block[size_t(k - _col_block_first)];
+
+    p.w  = r.weight;
+    p.e  = r.e*MeV;
+    p.x  = r.x*mm;
+    p.y  = r.y*mm;
+    p.z  = r.z*mm;
+    p.wx = r.wx;
+    p.wy = r.wy;
+    p.wz = r.wz;
+
+    if (r.particle == PhaseSpaceStream::electron)
+        p.def = _electron;
+    else if (r.particle == PhaseSpaceStream::positron)
+        p.def = _positron;
+    else
+        p.def = _gamma;
+
+    return true;
+}
+
+void Source::replay(G4Event* anEvent, const PhaseSpace& phase_space)
+{
+    _event_shots.assign(_histories_per_event, 0);
+    _weights.clear();
+    _primary_history.clear();
+    _primary_source.clear();
+
+    if (phase_space.nof_histories() == 0)
+        return;
+
+    // file may be rewritten between runs
+    int run_id = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    if (_replay_run != run_id)
+    {
+        _replay_is.close();
+        _replay_is.clear();
+        _replay_is.open(phase_space.fname(), std::ios::in | std::ios::binary);
+        _replay_run = run_id;
+    }
+
+    // event IDs are unique over threads, so every worker reads its own histories
+    for(int h = 0; h != _histories_per_event; ++h)
+    {
+        int64_t history = int64_t(anEvent->GetEventID())*int64_t(_histories_per_event) + int64_t(h);
+        if (history == phase_space.nof_histories())
+            G4Exception("Source", "008", JustWarning,
+                        ("Run has more histories than " + phase_space.fname() + ", they are replayed again").c_str());
+
+        _event_histories += phase_space.empty_histories(history);
+
+        auto records = phase_space.history_records(history);
+
+        _replay_records.resize(size_t(records.second - records.first));
+        _replay_is.seekg(std::streamoff(sizeof(PhaseSpaceStream::header) + records.first*sizeof(PhaseSpaceStream::record)));
+        _replay_is.read(reinterpret_cast<char*>(_replay_records.data()), std::streamsize(_replay_records.size()*sizeof(PhaseSpaceStream::record)));
+        if (!_replay_is)
+        {
+            G4Exception("Source", "004", JustWarning, ("Failed reading " + phase_space.fname()).c_str());
+            _replay_is.clear();
+            continue;
+        }
+
+        for(const auto& r: _replay_records)
+        {
+            if (r.particle == PhaseSpaceStream::electron)
+                _particleGun->SetParticleDefinition(_electron);
+            else if (r.particle == PhaseSpaceStream::positron)
+                _particleGun->SetParticleDefinition(_positron);
+            else
+                _particleGun->SetParticleDefinition(_gamma);
+
+            _particleGun->SetParticlePosition(G4ThreeVector(r.x*mm, r.y*mm, r.z*mm));
+            _particleGun->SetParticleMomentumDirection(G4ThreeVector(r.wx, r.wy, r.wz));
+            _particleGun->SetParticleEnergy(r.e*MeV);
+
+            _particleGun->GeneratePrimaryVertex(anEvent);
+
+            _weights.push_back(r.weight);
+            _primary_history.push_back(h);
+            _primary_source.push_back(r.source);
+        }
+    }
+
+    _particleGun->SetParticleDefinition(_gamma);
+
+    set_weights(anEvent);
+}
+
+void Source::set_weights(G4Event* anEvent) const
+{
+    bool weighted = std::any_of(_weights.cbegin(), _weights.cend(), [](double w) { return w != 1.0; });
+    if (!weighted)
+        return;
+
+    // vertices are kept in generation order
+    size_t k = 0;
+    for(auto* v = anEvent->GetPrimaryVertex(0); v != nullptr && k != _weights.size(); v = v->GetNext())
+        v->SetWeight(_weights[k++]);
+}
+
+void Source::sample_assembly(std::vector<particle>& particles) const
+{
+    sample_assembly(current_shot(), particles);
+}
+
+void Source::sample_assembly(const shot& s, std::vector<particle>& particles) const
+{
+    // pseudo-random draws, in the order they were always made
+    uniforms u;
+    u[u_polar]    = G4UniformRand();
+    u[u_phi]      = G4UniformRand();
+    u[u_energy]   = G4UniformRand();
+    u[u_rotation] = G4UniformRand();
+
+    sample_assembly(s, u, particles);
+}
+
+void Source::sample_assembly(const shot& s, const uniforms& u, std::vector<particle>& particles) const
+{
+    particle p;
+
+    // every collimator points at the shot isocentre, so the sphere around it
+    // is the same cone around the collimator axis for all sources
+    double bias_mu = 1.0;
+    if (_bias_radius > 0.0f && _bias_radius < _iso_radius)
+        bias_mu = sqrt(1.0 - double(_bias_radius/_iso_radius)*double(_bias_radius/_iso_radius));
 
     // get generated at center but with proper direction
-    std::tie(w, e, x, y, z, wx, wy, wz) = generate_particle(this->_polar_start, this->_polar_stop);
+    std::tie(p.w, p.e, p.x, p.y, p.z, p.wx, p.wy, p.wz) = generate_particle(s.polar_start, s.polar_stop, bias_mu, _bias_fraction, _spectrum, u);
+    p.def = _gamma;
 
     // move source back in X, so it is proper
     // position
-    x -= this->_iso_radius;
+    p.x -= this->_iso_radius;
 
+    place_assembly(s, p, u, true, particles);
+}
+
+void Source::place_assembly(const shot& s, const particle& channel, const uniforms& u, bool source_spectra, std::vector<particle>& particles) const
+{
     // random collimator assembly rotation angle
-    auto rndphi = sample_rotangle(_rot_start, _rot_stop);
+    auto rndphi = sample_rotangle(s.rot_start, s.rot_stop, u[u_rotation]);
+
+    particles.resize(_srcs.size());
 
     // now making it all together for all sources in the system
     for(decltype(_srcs.size()) k = 0; k != _srcs.size(); ++k) // running over all source
@@ -182,13 +714,13 @@ void Source::GeneratePrimaries(G4Event* anEvent)
         double xx, yy, zz;
         double wxx, wyy, wzz;
 
-        xx = x;
-        yy = y;
-        zz = z;
+        xx = channel.x;
+        yy = channel.y;
+        zz = channel.z;
 
-        wxx = wx;
-        wyy = wy;
-        wzz = wz;
+        wxx = channel.wx;
+        wyy = channel.wy;
+        wzz = channel.wz;
 
         // polar rotation, getting matrix
         auto sn = _srcs[k].first.first;
@@ -212,16 +744,22 @@ void Source::GeneratePrimaries(G4Event* anEvent)
         std::tie(wxx, wyy) = rotate_2d(wxx, wyy, sn, cs);
 
         // now add shift between phantom center and source isocenter
-        _particleGun->SetParticlePosition(G4ThreeVector(xx + this->_shift_x,
-                                                        yy + this->_shift_y,
-                                                        zz + this->_shift_z));
+        auto& p = particles[k];
 
-        // set particle direction
-        _particleGun->SetParticleMomentumDirection(G4ThreeVector(wxx, wyy, wzz));
+        p.w   = channel.w;
+        p.e   = channel.e;
+        p.def = channel.def;
 
-        // and energy
-        _particleGun->SetParticleEnergy(e);
+        // source with its own spectrum, the same energy uniform
+        if (source_spectra && !_src_spectrum.empty() && _src_spectrum[k] >= 0)
+            p.e = _spectra[_src_spectrum[k]].sample(u[u_energy]);
 
-        _particleGun->GeneratePrimaryVertex(anEvent);
+        p.x  = xx + s.shift_x;
+        p.y  = yy + s.shift_y;
+        p.z  = zz + s.shift_z;
+
+        p.wx = wxx;
+        p.wy = wyy;
+        p.wz = wzz;
     }
 }
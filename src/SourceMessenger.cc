@@ -3,6 +3,7 @@
 
 #include "G4UIcmdWithAString.hh"
 #include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithABool.hh"
 #include "G4UIcmdWithADouble.hh"
 #include "G4UIcmdWithADoubleAndUnit.hh"
 
@@ -16,7 +17,14 @@ SourceMessenger::SourceMessenger(Source* source):
     _shift_x_cmd{nullptr},
     _shift_y_cmd{nullptr},
     _shift_z_cmd{nullptr},
-    _src_fname_cmd{nullptr}
+    _src_fname_cmd{nullptr},
+    _spectrum_cmd{nullptr},
+    _histories_cmd{nullptr},
+    _plan_fname_cmd{nullptr},
+    _shot_dose_cmd{nullptr},
+    _bias_radius_cmd{nullptr},
+    _bias_fraction_cmd{nullptr},
+    _col_phsp_cmd{nullptr}
 {
     _src_directory = new G4UIdirectory("/GP/source/");
     _src_directory->SetGuidance("Source construction control");
@@ -73,6 +81,52 @@ SourceMessenger::SourceMessenger(Source* source):
     _src_fname_cmd->SetGuidance("Set file name");
     _src_angle_cmd->SetParameterName("srcFname", false);
     _src_angle_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _spectrum_cmd = new G4UIcmdWithAString("/GP/source/spectrum", this);
+    _spectrum_cmd->SetGuidance("Set energy spectrum file, one line or bin per line, energies in MeV:");
+    _spectrum_cmd->SetGuidance("  energy weight, or energy_low energy_high weight");
+    _spectrum_cmd->SetGuidance("Sources with spectrum file in the third column of src_fname use their own");
+    _spectrum_cmd->SetParameterName("spectrumFname", false);
+    _spectrum_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _histories_cmd = new G4UIcmdWithAnInteger("/GP/source/histories_per_event", this);
+    _histories_cmd->SetGuidance("Set number of independent source samples per event");
+    _histories_cmd->SetParameterName("historiesPerEvent", false);
+    _histories_cmd->SetRange("historiesPerEvent>=1");
+    _histories_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _plan_fname_cmd = new G4UIcmdWithAString("/GP/source/plan_fname", this);
+    _plan_fname_cmd->SetGuidance("Set plan file, one shot per line:");
+    _plan_fname_cmd->SetGuidance("  shift_x shift_y shift_z (mm) weight rot_start rot_stop src_angle (degree)");
+    _plan_fname_cmd->SetParameterName("planFname", false);
+    _plan_fname_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _shot_dose_cmd = new G4UIcmdWithABool("/GP/source/shot_dose", this);
+    _shot_dose_cmd->SetGuidance("Score dose of every plan shot separately");
+    _shot_dose_cmd->SetParameterName("shotDose", true);
+    _shot_dose_cmd->SetDefaultValue(true);
+    _shot_dose_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _bias_radius_cmd = new G4UIcmdWithADoubleAndUnit("/GP/source/bias_radius", this);
+    _bias_radius_cmd->SetGuidance("Aim photons at the sphere of this radius around the isocentre, 0 turns biasing off");
+    _bias_radius_cmd->SetGuidance("Primary weights are corrected, so the mean dose is unchanged");
+    _bias_radius_cmd->SetParameterName("biasRadius", false);
+    _bias_radius_cmd->SetDefaultUnit("mm");
+    _bias_radius_cmd->SetUnitCandidates("mm cm m");
+    _bias_radius_cmd->SetRange("biasRadius>=0.0");
+    _bias_radius_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _bias_fraction_cmd = new G4UIcmdWithADouble("/GP/source/bias_fraction", this);
+    _bias_fraction_cmd->SetGuidance("Set fraction of photons aimed at the bias sphere, the rest cover the whole cone");
+    _bias_fraction_cmd->SetParameterName("biasFraction", false);
+    _bias_fraction_cmd->SetRange("biasFraction>=0.0 && biasFraction<1.0");
+    _bias_fraction_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _col_phsp_cmd = new G4UIcmdWithAString("/GP/source/collimator_phsp", this);
+    _col_phsp_cmd->SetGuidance("Set phase space of the collimator channel, written with /GP/collimator/enable and /GP/phsp/capture");
+    _col_phsp_cmd->SetGuidance("Every history puts one record through all sources instead of a sampled photon, none turns it off");
+    _col_phsp_cmd->SetParameterName("colPhspFname", false);
+    _col_phsp_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
 }
 
 SourceMessenger::~SourceMessenger()
@@ -88,6 +142,17 @@ SourceMessenger::~SourceMessenger()
     delete _shift_z_cmd;
 
 	delete _src_fname_cmd;
+	delete _spectrum_cmd;
+
+	delete _histories_cmd;
+
+	delete _plan_fname_cmd;
+	delete _shot_dose_cmd;
+
+	delete _bias_radius_cmd;
+	delete _bias_fraction_cmd;
+
+	delete _col_phsp_cmd;
 
 	delete _src_directory;
 }
@@ -142,5 +207,47 @@ void SourceMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
 		return;
     }
 
+	if (cmd == _spectrum_cmd)
+	{
+	    _source->set_spectrum(value);
+		return;
+	}
+
+	if (cmd == _histories_cmd)
+	{
+	    _source->set_histories_per_event(_histories_cmd->GetNewIntValue(value));
+		return;
+	}
+
+	if (cmd == _plan_fname_cmd)
+	{
+	    _source->set_plan(value);
+		return;
+	}
+
+	if (cmd == _shot_dose_cmd)
+	{
+	    _source->set_shot_dose(_shot_dose_cmd->GetNewBoolValue(value));
+		return;
+	}
+
+	if (cmd == _bias_radius_cmd)
+	{
+	    _source->set_bias_radius(_bias_radius_cmd->GetNewDoubleValue(value));
+		return;
+	}
+
+	if (cmd == _bias_fraction_cmd)
+	{
+	    _source->set_bias_fraction(_bias_fraction_cmd->GetNewDoubleValue(value));
+		return;
+	}
+
+	if (cmd == _col_phsp_cmd)
+	{
+	    _source->set_collimator_phsp(value);
+		return;
+	}
+
 	return;
 }
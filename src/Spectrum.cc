@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "Spectrum.hh"
+
+#include "G4SystemOfUnits.hh"
+
+double Spectrum::mean_energy() const
+{
+    double sum = 0.0;
+    double sw  = 0.0;
+    for(const auto& b: _bins)
+    {
+        sum += b.weight * 0.5*(b.e_lo + b.e_hi);
+        sw  += b.weight;
+    }
+    return (sw > 0.0) ? sum / sw : 0.0;
+}
+
+bool Spectrum::set_bins(const std::vector<bin>& bins)
+{
+    double total = 0.0;
+    for(const auto& b: bins)
+    {
+        if (b.weight < 0.0 || b.e_lo < 0.0 || b.e_hi < b.e_lo)
+            return false;
+        total += b.weight;
+    }
+    if (bins.empty() || total <= 0.0)
+        return false;
+
+    // Vose's method: columns scaled to mean 1, small ones are topped up by large ones
+    int n = int(bins.size());
+
+    std::vector<double> scaled(n);
+    std::vector<int>    small;
+    std::vector<int>    large;
+    for(int k = 0; k != n; ++k)
+    {
+        scaled[k] = bins[k].weight * double(n) / total;
+        if (scaled[k] < 1.0)
+            small.push_back(k);
+        else
+            large.push_back(k);
+    }
+
+    std::vector<cell> cells(n, cell{1.0, 0});
+    for(int k = 0; k != n; ++k)
+        cells[k].alias = k;
+
+    while (!small.empty() && !large.empty())
+    {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+
+        cells[s] = cell{scaled[s], l};
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // leftovers are full up to rounding
+    for(int k: small)
+        cells[k] = cell{1.0, k};
+    for(int k: large)
+        cells[k] = cell{1.0, k};
+
+    _bins  = bins;
+    _cells.swap(cells);
+
+    return true;
+}
+
+bool Spectrum::load(const std::string& fname)
+{
+    std::ifstream is(fname);
+    if (!is.is_open())
+    {
+        G4Exception("Spectrum", "001", JustWarning, ("Cannot open spectrum file " + fname + ", spectrum unchanged").c_str());
+        return false;
+    }
+
+    std::vector<bin> bins;
+
+    std::string line;
+    while (std::getline(is, line))
+    {
+        // skip blank lines and comments
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream ls(line);
+
+        std::vector<double> v;
+        for(double x; ls >> x; )
+            v.push_back(x);
+
+        if (v.size() == 2)
+            bins.push_back(bin{v[0]*MeV, v[0]*MeV, v[1]});
+        else if (v.size() == 3)
+            bins.push_back(bin{v[0]*MeV, v[1]*MeV, v[2]});
+        else
+        {
+            G4Exception("Spectrum", "002", JustWarning, ("Bad spectrum line: " + line + ", spectrum unchanged").c_str());
+            return false;
+        }
+    }
+
+    if (!set_bins(bins))
+    {
+        G4Exception("Spectrum", "003", JustWarning, ("No valid weighted bins in " + fname + ", spectrum unchanged").c_str());
+        return false;
+    }
+
+    G4cout << "Spectrum::load " << fname << ": " << bins.size() << " bins, mean energy " << mean_energy()/MeV << " MeV" << G4endl;
+    return true;
+}
@@ -0,0 +1,38 @@
+#include "StackingAction.hh"
+#include "VarianceReduction.hh"
+
+#include "G4Track.hh"
+
+#include "Randomize.hh"
+
+StackingAction::StackingAction(const Source* source):
+    G4UserStackingAction{},
+    _source{source},
+    _vr{VarianceReduction::Instance()}
+{
+}
+
+StackingAction::~StackingAction()
+{
+}
+
+G4ClassificationOfNewTrack StackingAction::ClassifyNewTrack(const G4Track* aTrack)
+{
+    // primaries are never rouletted
+    if (aTrack->GetParentID() == 0 || _vr == nullptr || !_vr->enabled() || _vr->survival() >= 1.0)
+        return fUrgent;
+
+    // nor split copies, they have no creator process
+    if (aTrack->GetCreatorProcess() == nullptr)
+        return fUrgent;
+
+    if (_vr->inside(_vr->centre(_source), aTrack->GetPosition()))
+        return fUrgent;
+
+    if (G4UniformRand() >= _vr->survival())
+        return fKill;
+
+    // track is not tracked yet, its weight is still ours to set
+    const_cast<G4Track*>(aTrack)->SetWeight(aTrack->GetWeight() / _vr->survival());
+    return fUrgent;
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SteppingAction.hh"
+#include "VarianceReduction.hh"
+#include "Detector.hh"
+#include "DoseScorer.hh"
+#include "PhaseSpace.hh"
+#include "Run.hh"
+#include "Profiler.hh"
+#include "ForcedCollision.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4StepPoint.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ParticleTable.hh"
+#include "G4SteppingManager.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VTouchable.hh"
+#include "G4RunManager.hh"
+#include "G4SDManager.hh"
+#include "G4MultiFunctionalDetector.hh"
+#include "G4LossTableManager.hh"
+#include "G4EmCalculator.hh"
+#include "G4Material.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include "Randomize.hh"
+
+// attenuation table of forced interaction, log spaced
+static constexpr int    mu_bins = 256;
+static const double     mu_emin = 1.0*keV;
+static const double     mu_emax = 20.0*MeV;
+
+SteppingAction::SteppingAction(const Source* source):
+    G4UserSteppingAction{},
+    _source{source},
+    _vr{VarianceReduction::Instance()},
+    _gamma{G4ParticleTable::GetParticleTable()->FindParticle("gamma")},
+    _electron{G4ParticleTable::GetParticleTable()->FindParticle("e-")},
+    _positron{G4ParticleTable::GetParticleTable()->FindParticle("e+")},
+    _detector{static_cast<const Detector*>(G4RunManager::GetRunManager()->GetUserDetectorConstruction())},
+    _scorer{nullptr},
+    _mu_table{},
+    _mu{}
+{
+}
+
+SteppingAction::~SteppingAction()
+{
+}
+
+void SteppingAction::UserSteppingAction(const G4Step* aStep)
+{
+    PH_PROFILE_STEP(aStep);
+
+    auto* phase_space = PhaseSpace::Instance();
+    if (phase_space != nullptr && phase_space->capture() && capture(aStep))
+        return;
+
+    if (_detector != nullptr && _detector->range_rejection())
+        reject_range(aStep);
+
+    if (_vr != nullptr && _vr->forced() && _detector != nullptr && !_detector->collimator())
+        force_interaction(aStep);
+
+    if (_vr == nullptr || !_vr->enabled() || _vr->split() < 2)
+        return;
+
+    G4Track* track = aStep->GetTrack();
+    if (track->GetDefinition() != _gamma || track->GetTrackStatus() != fAlive)
+        return;
+
+    auto centre = _vr->centre(_source);
+    bool was_in = _vr->inside(centre, aStep->GetPreStepPoint()->GetPosition());
+    bool is_in  = _vr->inside(centre, aStep->GetPostStepPoint()->GetPosition());
+    if (was_in == is_in)
+        return;
+
+    if (is_in)
+    {
+        split(track, _vr->split());
+        return;
+    }
+
+    // leaving, survivor gets its weight back
+    if (G4UniformRand() * double(_vr->split()) >= 1.0)
+    {
+        track->SetTrackStatus(fStopAndKill);
+        return;
+    }
+    track->SetWeight(track->GetWeight() * double(_vr->split()));
+}
+
+// n - 1 copies of the photon at its post step state go to the
+// secondaries of the step, and are tracked in the current history
+void SteppingAction::split(G4Track* track, int n)
+{
+    double w = track->GetWeight() / double(n);
+    track->SetWeight(w);
+
+    auto* secondaries = fpSteppingManager->GetfSecondary();
+    for(int k = 1; k != n; ++k)
+    {
+        auto* copy = new G4Track(new G4DynamicParticle(*track->GetDynamicParticle()), track->GetGlobalTime(), track->GetPosition());
+        copy->SetWeight(w);
+        copy->SetParentID(track->GetTrackID());
+        copy->SetTouchableHandle(track->GetTouchableHandle());
+        secondaries->push_back(copy);
+    }
+}
+
+void SteppingAction::reject_range(const G4Step* aStep)
+{
+    G4Track* track = aStep->GetTrack();
+    if (track->GetDefinition() != _electron || track->GetTrackStatus() != fAlive)
+        return;
+
+    // step ending on a boundary may be already in the next voxel
+    const G4StepPoint* post = aStep->GetPostStepPoint();
+    if (post->GetStepStatus() == fGeomBoundary || post->GetStepStatus() == fWorldBoundary)
+        return;
+
+    const G4VPhysicalVolume* volume = aStep->GetPreStepPoint()->GetPhysicalVolume();
+    if (volume == nullptr || !_detector->is_voxel(volume->GetLogicalVolume()))
+        return;
+
+    // range with the cuts is longer than CSDA one, so rejection is on the safe side
+    double ekin  = track->GetKineticEnergy();
+    double range = G4LossTableManager::Instance()->GetRange(_electron, ekin, track->GetMaterialCutsCouple());
+
+    const G4ThreeVector& p = post->GetPosition();
+    if (range >= _detector->voxel_safety(p.x(), p.y(), p.z()))
+        return;
+
+    if (_scorer == nullptr)
+    {
+        auto* mfd = static_cast<G4MultiFunctionalDetector*>(G4SDManager::GetSDMpointer()->FindSensitiveDetector("phantomSD", false));
+        if (mfd == nullptr)
+            return;
+        _scorer = static_cast<DoseScorer*>(mfd->GetPrimitive(0));
+    }
+
+    _scorer->deposit(aStep, ekin);
+    track->SetKineticEnergy(0.0);
+    track->SetTrackStatus(fStopAndKill);
+}
+
+bool SteppingAction::entering_container(const G4Step* aStep) const
+{
+    // crossing from the world into the container, which is its only daughter
+    const G4StepPoint* post = aStep->GetPostStepPoint();
+    if (post->GetStepStatus() != fGeomBoundary || aStep->GetPreStepPoint()->GetTouchable()->GetHistoryDepth() != 0)
+        return false;
+
+    const G4VTouchable* touchable = post->GetTouchable();
+    int depth = touchable->GetHistoryDepth();
+    return depth != 0 && touchable->GetVolume(depth - 1)->GetLogicalVolume() == _detector->container_logic();
+}
+
+// Forced first collision: the entering photon of weight w gives way to
+// an uncollided copy of weight w exp(-tau) at the exit of the phantom,
+// and a collided one of weight w (1 - exp(-tau)) at the distance from
+// the exponential truncated at tau, which interacts there at once, see
+// ForcedCollision. Scattered photons reach the low dose regions much
+// more often, and the mean dose is unchanged
+void SteppingAction::force_interaction(const G4Step* aStep)
+{
+    G4Track* track = aStep->GetTrack();
+    if (track->GetDefinition() != _gamma || track->GetTrackStatus() != fAlive || !entering_container(aStep))
+        return;
+
+    const auto& materials = _detector->materials();
+    if (_mu_table.size() != materials.size())
+    {
+        G4EmCalculator calculator;
+
+        _mu_table.assign(materials.size(), std::vector<double>(mu_bins, 0.0));
+        for(size_t m = 0; m != materials.size(); ++m)
+        {
+            for(int k = 0; k != mu_bins; ++k)
+            {
+                double e      = mu_emin * std::pow(mu_emax/mu_emin, double(k)/double(mu_bins - 1));
+                double length = calculator.ComputeGammaAttenuationLength(e, materials[m]);
+                _mu_table[m][k] = (length > 0.0 && std::isfinite(length)) ? 1.0/length : 0.0;
+            }
+        }
+    }
+
+    double e = track->GetKineticEnergy();
+    _mu.resize(_mu_table.size());
+    for(size_t m = 0; m != _mu_table.size(); ++m)
+        _mu[m] = attenuation(m, e);
+
+    const G4ThreeVector& pos = track->GetPosition();
+    const G4ThreeVector& dir = track->GetMomentumDirection();
+
+    double length;
+    double tau = _detector->optical_depth(pos, dir, _mu, &length);
+
+    // expm1 keeps thin paths exact
+    double p = -std::expm1(-tau);
+    if (!(p > 0.0))
+        return;
+
+    // depth of the collision from the exponential truncated at tau
+    double depth    = -std::log1p(-G4UniformRand()*p);
+    double distance = _detector->optical_distance(pos, dir, _mu, depth);
+
+    // copies have no touchable, the stepping manager locates them
+    double w        = track->GetWeight();
+    double t        = track->GetGlobalTime();
+    auto*  collided = new G4Track(new G4DynamicParticle(*track->GetDynamicParticle()), t + distance/c_light, pos + distance*dir);
+    collided->SetWeight(w*p);
+    collided->SetParentID(track->GetTrackID());
+    ForcedCollision::mark(collided);
+
+    auto* uncollided = new G4Track(new G4DynamicParticle(*track->GetDynamicParticle()), t + length/c_light, pos + length*dir);
+    uncollided->SetWeight(w*std::exp(-tau));
+    uncollided->SetParentID(track->GetTrackID());
+
+    auto* secondaries = fpSteppingManager->GetfSecondary();
+    secondaries->push_back(collided);
+    secondaries->push_back(uncollided);
+
+    track->SetTrackStatus(fStopAndKill);
+}
+
+double SteppingAction::attenuation(size_t material, double e) const
+{
+    double f = std::log(e/mu_emin) / std::log(mu_emax/mu_emin) * double(mu_bins - 1);
+    f = std::min(std::max(f, 0.0), double(mu_bins - 1));
+
+    int    k = std::min(int(f), mu_bins - 2);
+    double d = f - double(k);
+
+    const auto& table = _mu_table[material];
+    return table[k] + (table[k + 1] - table[k])*d;
+}
+
+bool SteppingAction::capture(const G4Step* aStep)
+{
+    if (!entering_container(aStep))
+        return false;
+
+    const G4StepPoint* post = aStep->GetPostStepPoint();
+    G4Track* track = aStep->GetTrack();
+
+    int8_t particle;
+    if (track->GetDefinition() == _gamma)
+        particle = PhaseSpaceStream::gamma;
+    else if (track->GetDefinition() == _electron)
+        particle = PhaseSpaceStream::electron;
+    else if (track->GetDefinition() == _positron)
+        particle = PhaseSpaceStream::positron;
+    else
+        return false;
+
+    auto* run = static_cast<Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
+    if (run == nullptr || !run->capture())
+        return false;
+
+    const G4ThreeVector& p = post->GetPosition();
+    const G4ThreeVector& w = post->GetMomentumDirection();
+
+    PhaseSpaceStream::record r;
+    r.x        = float(p.x()/mm);
+    r.y        = float(p.y()/mm);
+    r.z        = float(p.z()/mm);
+    r.wx       = float(w.x());
+    r.wy       = float(w.y());
+    r.wz       = float(w.z());
+    r.e        = float(post->GetKineticEnergy()/MeV);
+    r.weight   = float(post->GetWeight());
+    r.particle = particle;
+    run->capture(r);
+
+    // the phantom side is transported on replay
+    track->SetTrackStatus(fStopAndKill);
+    return true;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "G4UImanager.hh"
+
+#include "Sweep.hh"
+#include "Dij.hh"
+#include "ResultCache.hh"
+
+Sweep::Sweep(const std::string& fname):
+    _commands{},
+    _units{},
+    _events_column{-1},
+    _points{}
+{
+    std::ifstream is(fname);
+    if (!is)
+        throw std::logic_error("Cannot open sweep spec file: " + fname);
+
+    std::string line;
+    while (std::getline(is, line))
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream ls(line);
+        std::vector<std::string> tokens;
+        for(std::string t; ls >> t; )
+            tokens.push_back(t);
+
+        if (_commands.empty())
+        {
+            // header, column names with optional units
+            for(const auto& t: tokens)
+            {
+                auto colon = t.find(':');
+                std::string name = t.substr(0, colon);
+                std::string unit = (colon == std::string::npos) ? std::string{} : t.substr(colon + 1);
+
+                if (name == "events")
+                {
+                    _events_column = int(_commands.size());
+                    name.clear();
+                }
+                else if (name[0] != '/')
+                {
+                    name = "/GP/source/" + name;
+                }
+
+                _commands.push_back(name);
+                _units.push_back(unit);
+            }
+
+            if (_events_column < 0)
+                throw std::logic_error("Sweep spec " + fname + " has no events column");
+            continue;
+        }
+
+        if (tokens.size() != _commands.size())
+            throw std::logic_error("Sweep point has wrong number of values: " + line);
+        _points.push_back(tokens);
+    }
+
+    G4cout << "Sweep: " << _points.size() << " points of " << _commands.size() - 1
+           << " parameters from " << fname << G4endl;
+}
+
+void Sweep::run(G4UImanager* UImanager) const
+{
+    std::ofstream summary("sweep.out");
+    summary << "# point";
+    for(size_t c = 0; c != _commands.size(); ++c)
+        summary << "  " << ((int(c) == _events_column) ? std::string{"events"} : _commands[c]);
+    summary << "  seconds" << std::endl;
+
+    for(size_t p = 0; p != _points.size(); ++p)
+    {
+        const auto& values = _points[p];
+
+        G4cout << "Sweep: point " << p << " of " << _points.size() << G4endl;
+
+        for(size_t c = 0; c != _commands.size(); ++c)
+        {
+            if (int(c) == _events_column)
+                continue;
+
+            std::string command = _commands[c] + " " + values[c] + (_units[c].empty() ? "" : " " + _units[c]);
+            if (UImanager->ApplyCommand(command) != 0)
+                G4Exception("Sweep", "001", JustWarning, ("Command failed: " + command).c_str());
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        auto* cache = ResultCache::Instance();
+        bool cached = cache != nullptr && cache->enabled();
+        UImanager->ApplyCommand((cached ? "/GP/cache/beamOn " : "/run/beamOn ") + values[_events_column]);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+
+        // the next point would overwrite results, so they get point prefix
+        std::vector<std::string> results{"dose.out"};
+        auto* dij = Dij::Instance();
+        if (dij != nullptr && dij->enabled())
+            results.push_back(dij->fname());
+
+        for(const auto& r: results)
+        {
+            std::string name = "sweep_" + std::to_string(p) + "_" + r;
+            std::rename(r.c_str(), name.c_str());
+        }
+
+        summary << p;
+        for(const auto& v: values)
+            summary << "  " << v;
+        summary << "  " << std::setprecision(6) << elapsed.count() << std::endl;
+    }
+}
@@ -0,0 +1,32 @@
+#include "TrackingAction.hh"
+#include "Source.hh"
+#include "Run.hh"
+
+#include "G4Track.hh"
+#include "G4RunManager.hh"
+
+TrackingAction::TrackingAction(const Source* source):
+    G4UserTrackingAction{},
+    _source{source}
+{
+}
+
+TrackingAction::~TrackingAction()
+{
+}
+
+void TrackingAction::PreUserTrackingAction(const G4Track* aTrack)
+{
+    // only primaries start new history, secondaries belong to the current one
+    if (aTrack->GetParentID() != 0)
+        return;
+
+    auto* run = static_cast<Run*>(G4RunManager::GetRunManager()->GetNonConstCurrentRun());
+    if (run != nullptr)
+    {
+        int history = _source->history_of_primary(aTrack->GetTrackID());
+
+        run->begin_history(history, _source->shot_of_history(history));
+        run->set_source(_source->source_of_primary(aTrack->GetTrackID()));
+    }
+}
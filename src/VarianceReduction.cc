@@ -0,0 +1,38 @@
+#include "VarianceReduction.hh"
+#include "VarianceReductionMessenger.hh"
+#include "Source.hh"
+
+VarianceReduction* VarianceReduction::_instance = nullptr;
+
+VarianceReduction* VarianceReduction::Instance()
+{
+    return _instance;
+}
+
+VarianceReduction::VarianceReduction():
+    _messenger{nullptr},
+    _roi_radius{0.0},
+    _roi_centre{std::numeric_limits<double>::quiet_NaN(), 0.0, 0.0},
+    _split{1},
+    _survival{1.0},
+    _force{false}
+{
+    _instance  = this;
+    _messenger = new VarianceReductionMessenger(this);
+}
+
+VarianceReduction::~VarianceReduction()
+{
+    delete _messenger;
+    _instance = nullptr;
+}
+
+G4ThreeVector VarianceReduction::centre(const Source* source) const
+{
+    if (has_roi_centre() || source == nullptr)
+        return has_roi_centre() ? _roi_centre : G4ThreeVector{};
+
+    // source shifts are NaN until they are set
+    auto shift = [](float s) { return std::isnan(s) ? 0.0 : double(s); };
+    return G4ThreeVector{shift(source->shift_x()), shift(source->shift_y()), shift(source->shift_z())};
+}
@@ -0,0 +1,110 @@
+#include "VarianceReductionMessenger.hh"
+#include "VarianceReduction.hh"
+
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWith3VectorAndUnit.hh"
+
+VarianceReductionMessenger::VarianceReductionMessenger(VarianceReduction* vr):
+    _vr{vr},
+    _vr_directory{nullptr},
+    _roi_radius_cmd{nullptr},
+    _roi_centre_cmd{nullptr},
+    _split_cmd{nullptr},
+    _survival_cmd{nullptr},
+    _force_cmd{nullptr}
+{
+    _vr_directory = new G4UIdirectory("/GP/vr/");
+    _vr_directory->SetGuidance("Splitting and Russian roulette around the focus");
+
+    // settings are shared by all threads, no need to send commands to workers
+    _roi_radius_cmd = new G4UIcmdWithADoubleAndUnit("/GP/vr/roi_radius", this);
+    _roi_radius_cmd->SetGuidance("Set radius of the sphere of interest, 0 turns variance reduction off");
+    _roi_radius_cmd->SetParameterName("roiRadius", false);
+    _roi_radius_cmd->SetDefaultUnit("mm");
+    _roi_radius_cmd->SetUnitCandidates("mm cm m");
+    _roi_radius_cmd->SetRange("roiRadius>=0.0");
+    _roi_radius_cmd->SetToBeBroadcasted(false);
+    _roi_radius_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _roi_centre_cmd = new G4UIcmdWith3VectorAndUnit("/GP/vr/roi_centre", this);
+    _roi_centre_cmd->SetGuidance("Set centre of the sphere of interest, by default it is the source isocentre");
+    _roi_centre_cmd->SetGuidance("Set it explicitly for multi-shot plans");
+    _roi_centre_cmd->SetParameterName("roiX", "roiY", "roiZ", false);
+    _roi_centre_cmd->SetDefaultUnit("mm");
+    _roi_centre_cmd->SetUnitCandidates("mm cm m");
+    _roi_centre_cmd->SetToBeBroadcasted(false);
+    _roi_centre_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _split_cmd = new G4UIcmdWithAnInteger("/GP/vr/split", this);
+    _split_cmd->SetGuidance("Split photons entering the sphere into N copies, roulette them with 1/N survival on leaving");
+    _split_cmd->SetParameterName("split", false);
+    _split_cmd->SetRange("split>=1");
+    _split_cmd->SetToBeBroadcasted(false);
+    _split_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _survival_cmd = new G4UIcmdWithADouble("/GP/vr/survival", this);
+    _survival_cmd->SetGuidance("Set Russian roulette survival probability of secondaries born outside of the sphere");
+    _survival_cmd->SetParameterName("survival", false);
+    _survival_cmd->SetRange("survival>0.0 && survival<=1.0");
+    _survival_cmd->SetToBeBroadcasted(false);
+    _survival_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    _force_cmd = new G4UIcmdWithABool("/GP/vr/force", this);
+    _force_cmd->SetGuidance("Force the first collision of photons entering the phantom");
+    _force_cmd->SetGuidance("Collided copy carries the weight times p, p the probability to interact in the phantom,");
+    _force_cmd->SetGuidance("uncollided one the rest, works with or without the sphere of interest");
+    _force_cmd->SetParameterName("force", true);
+    _force_cmd->SetDefaultValue(true);
+    _force_cmd->SetToBeBroadcasted(false);
+    _force_cmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+VarianceReductionMessenger::~VarianceReductionMessenger()
+{
+    delete _roi_radius_cmd;
+    delete _roi_centre_cmd;
+    delete _split_cmd;
+    delete _survival_cmd;
+    delete _force_cmd;
+
+    delete _vr_directory;
+}
+
+void VarianceReductionMessenger::SetNewValue(G4UIcommand* cmd, G4String value)
+{
+    if (cmd == _roi_radius_cmd)
+    {
+        _vr->set_roi_radius(_roi_radius_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _roi_centre_cmd)
+    {
+        _vr->set_roi_centre(_roi_centre_cmd->GetNew3VectorValue(value));
+        return;
+    }
+
+    if (cmd == _split_cmd)
+    {
+        _vr->set_split(_split_cmd->GetNewIntValue(value));
+        return;
+    }
+
+    if (cmd == _survival_cmd)
+    {
+        _vr->set_survival(_survival_cmd->GetNewDoubleValue(value));
+        return;
+    }
+
+    if (cmd == _force_cmd)
+    {
+        _vr->set_force(_force_cmd->GetNewBoolValue(value));
+        return;
+    }
+
+    return;
+}